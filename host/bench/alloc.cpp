@@ -0,0 +1,56 @@
+#include "alloc.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Linked with -Wl,--wrap=malloc,--wrap=calloc so that direct allocations
+// from the firmware sources are counted alongside operator new.
+
+static std::atomic<size_t> allocations(0);
+
+extern "C" void* __real_malloc(size_t size);
+extern "C" void* __real_calloc(size_t count, size_t size);
+
+extern "C" void* __wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void* operator new(size_t size) {
+    allocations++;
+    void* pointer = __real_malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+size_t alloc_count() {
+    return allocations;
+}
@@ -0,0 +1,10 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <cstddef>
+
+// Number of heap allocations made through operator new, malloc and calloc
+// since the process started.
+size_t alloc_count();
+
+#endif
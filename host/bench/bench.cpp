@@ -0,0 +1,150 @@
+#include "alloc.hpp"
+#include "host.hpp"
+#include "commands.hpp"
+#include "config.hpp"
+#include "journal.hpp"
+#include "json.hpp"
+#include "json_reader.hpp"
+#include "nvstorage.hpp"
+#include "query.hpp"
+
+#include "esp_timer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Micro-benchmarks for the request-path modules. Each case reports the
+// mean wall time and heap allocations per operation.
+
+static volatile size_t sink;
+
+template <typename F>
+static void bench(const char* name, size_t iterations, F operation) {
+    for (size_t i = 0; i < iterations / 10 + 1; i++) {
+        operation();
+    }
+    size_t allocations = alloc_count();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        operation();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    allocations = alloc_count() - allocations;
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    printf("%-28s %12.1f ns/op %10.2f allocs/op\n", name, ns, (double)allocations / iterations);
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = (argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000);
+
+    bench("json/buffer/pretty", iterations, [] {
+        char buffer[256];
+        JSON json(buffer, sizeof(buffer));
+        json.add_bool("success", true)
+            .add_string("message", "Successfully read network from config,")
+            .begin_object("network")
+                .add_string("ssid", "Office \"5G\"")
+                .add_string("psk", "correct horse battery staple")
+                .add_int("security", 3)
+            .end_object()
+            .finalize();
+        sink = json.length();
+    });
+
+    bench("json/buffer/compact", iterations, [] {
+        char buffer[256];
+        JSON json(buffer, sizeof(buffer), false);
+        json.add_bool("success", true)
+            .add_string("message", "Successfully read network from config,")
+            .finalize();
+        sink = json.length();
+    });
+
+    httpd_req_t request = host_request("");
+    request.response.reserve(1024);
+    bench("json/stream", iterations, [&request] {
+        request.response.clear();
+        request.complete = false;
+        JSON::simple_response(&request, true, "Going down in 5 seconds...");
+        sink = request.response.length();
+    });
+
+    bench("query/parse+3get", iterations, [] {
+        Query query("type=network&ssid=My+Office%20Net&psk=correct%20horse&security=3");
+        sink = query.get("type").length() + query.get("ssid").length() + query.get("psk").length();
+    });
+
+    bench("json_reader/parse+3get", iterations, [] {
+        char body[] = "{\"type\": \"network\", \"ssid\": \"My Office\\u0020Net\", \"psk\": \"correct horse\", \"security\": 3}";
+        JSONReader reader(body, sizeof(body) - 1);
+        std::string_view ssid;
+        std::string_view psk;
+        uint32_t security = 0;
+        reader.get_string(JSON_READER_ROOT, "ssid", ssid);
+        reader.get_string(JSON_READER_ROOT, "psk", psk);
+        reader.get_uint(JSON_READER_ROOT, "security", security);
+        sink = ssid.length() + psk.length() + security;
+    });
+
+    static const command_t commands[] = {
+        { "boot", nullptr, COMMAND_GET, {} },
+        { "brew", nullptr, COMMAND_GET, { "cups" } },
+        { "descale", nullptr, COMMAND_GET, {} },
+        { "network", nullptr, COMMAND_GET, {} },
+        { "power", nullptr, COMMAND_GET, { "state" } },
+        { "reboot", nullptr, COMMAND_GET, {} },
+        { "reprovision", nullptr, COMMAND_GET, {} },
+        { "reset", nullptr, COMMAND_GET, {} },
+        { "status", nullptr, COMMAND_GET, {} },
+    };
+    Commands::add(commands, sizeof(commands) / sizeof(commands[0]));
+
+    bench("commands/find+check", iterations, [] {
+        Query query("type=power&state=on");
+        const command_t* command = Commands::find(query.get("type"));
+        const char* missing = nullptr;
+        sink = Commands::check(command, HTTP_GET, query, missing);
+    });
+
+    bench("commands/find-unknown", iterations, [] {
+        sink = (Commands::find("explode") == nullptr);
+    });
+
+    Journal::init();
+    bench("journal/record", iterations, [] {
+        JOURNAL_LOGD("bench", "Set: Setting value for key '%s'... (%d)", "ssid", 42);
+    });
+
+    bench("journal/snprintf-baseline", iterations, [] {
+        char line[JOURNAL_LINE_LENGTH];
+        sink = snprintf(line, sizeof(line), "D (%lld) bench: Set: Setting value for key '%s'... (%d)",
+            (long long)esp_timer_get_time(), "ssid", 42);
+    });
+
+    host_nvs_reset();
+    NVStorage::init();
+    Config().set_network("Office", "correct horse battery staple", WIFI_AUTH_WPA2_PSK);
+
+    bench("config/load", iterations / 10, [] {
+        sink = Config::load();
+    });
+
+    bench("config/snapshot", iterations, [] {
+        Config config;
+        sink = config.get_ssid().length();
+    });
+
+    bool toggle = false;
+    bench("config/save", iterations / 10, [&toggle] {
+        toggle = !toggle;
+        sink = Config().set_network(toggle ? "Office" : "Home", "secret", WIFI_AUTH_WPA2_PSK);
+    });
+
+    bench("config/save-unchanged", iterations / 10, [] {
+        sink = Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK);
+    });
+
+    return 0;
+}
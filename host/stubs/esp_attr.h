@@ -0,0 +1,8 @@
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+// Memory placement attributes have no meaning on the host.
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif
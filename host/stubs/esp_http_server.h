@@ -0,0 +1,61 @@
+#ifndef ESP_HTTP_SERVER_H
+#define ESP_HTTP_SERVER_H
+
+#include "esp_err.h"
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+#define HTTPD_SOCK_ERR_FAIL     -1
+#define HTTPD_SOCK_ERR_INVALID  -2
+#define HTTPD_SOCK_ERR_TIMEOUT  -3
+
+#define HTTPD_MAX_URI_LEN       512
+
+#define ESP_ERR_HTTPD_BASE          0xb000
+#define ESP_ERR_HTTPD_RESULT_TRUNC  (ESP_ERR_HTTPD_BASE + 6)
+
+// Subset of the http_parser method numbering used by the firmware.
+typedef enum {
+    HTTP_DELETE = 0,
+    HTTP_GET = 1,
+    HTTP_HEAD = 2,
+    HTTP_POST = 3,
+    HTTP_PUT = 4,
+} httpd_method_t;
+
+// Host stand-in for a request. The query and body are supplied by the
+// test, everything the firmware sends back is collected in response.
+typedef struct httpd_req {
+    int method;
+    char uri[HTTPD_MAX_URI_LEN + 1];
+    size_t content_len;
+    void* user_ctx;
+    std::map<std::string, std::string> headers;
+    std::map<std::string, std::string> response_headers;
+    std::string status;
+    std::string type;
+    std::string query;
+    std::string body;
+    size_t body_position;
+    size_t recv_limit;
+    std::string response;
+    size_t chunks;
+    bool complete;
+} httpd_req_t;
+
+size_t httpd_req_get_url_query_len(httpd_req_t* r);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t buf_len);
+int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len);
+size_t httpd_req_get_hdr_value_len(httpd_req_t* r, const char* field);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r, const char* field, char* val, size_t val_size);
+esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* status);
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field, const char* value);
+esp_err_t httpd_resp_send_404(httpd_req_t* r);
+esp_err_t httpd_resp_send_408(httpd_req_t* r);
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, long buf_len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf, long buf_len);
+
+#endif
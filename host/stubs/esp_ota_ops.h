@@ -0,0 +1,9 @@
+#ifndef ESP_OTA_OPS_H
+#define ESP_OTA_OPS_H
+
+#include <cstddef>
+
+// Writes the hex ELF hash of the running image, see host_set_image().
+int esp_ota_get_app_elf_sha256(char* dst, size_t size);
+
+#endif
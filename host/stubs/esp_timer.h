@@ -0,0 +1,9 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <cstdint>
+
+// Microseconds since the host process started.
+int64_t esp_timer_get_time();
+
+#endif
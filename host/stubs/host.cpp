@@ -0,0 +1,362 @@
+#include "host.hpp"
+#include "esp_crc.h"
+#include "nvs_flash.h"
+#include "esp_ota_ops.h"
+#include "esp_timer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <vector>
+
+enum entry_type_t { ENTRY_U8, ENTRY_U32, ENTRY_STR, ENTRY_BLOB };
+
+struct entry_t {
+    entry_type_t type;
+    std::vector<uint8_t> data;
+};
+
+typedef std::map<std::string, entry_t> nvs_namespace_t;
+
+static bool initialized = false;
+static std::map<std::string, nvs_namespace_t> partition;
+static std::vector<std::string> handles;
+static host_nvs_stats_t stats = {};
+
+void host_nvs_reset() {
+    partition.clear();
+    handles.clear();
+    stats = {};
+}
+
+const host_nvs_stats_t& host_nvs_stats() {
+    return stats;
+}
+
+static nvs_namespace_t* lookup(nvs_handle_t handle) {
+    if (handle == 0 || handle > handles.size()) {
+        return nullptr;
+    }
+    return &partition[handles[handle - 1]];
+}
+
+static esp_err_t get(nvs_handle_t handle, const char* key, entry_type_t type, const entry_t** out) {
+    nvs_namespace_t* ns = lookup(handle);
+    if (ns == nullptr) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    stats.reads++;
+    auto entry = ns->find(key);
+    if (entry == ns->end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (entry->second.type != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    *out = &entry->second;
+    return ESP_OK;
+}
+
+static esp_err_t set(nvs_handle_t handle, const char* key, entry_type_t type, const void* value, size_t length) {
+    nvs_namespace_t* ns = lookup(handle);
+    if (ns == nullptr) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    stats.writes++;
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    (*ns)[key] = { type, std::vector<uint8_t>(bytes, bytes + length) };
+    return ESP_OK;
+}
+
+static esp_err_t get_variable(nvs_handle_t handle, const char* key, entry_type_t type, void* out, size_t* length) {
+    const entry_t* entry;
+    esp_err_t result = get(handle, key, type, &entry);
+    if (result != ESP_OK) {
+        return result;
+    }
+    if (out == nullptr) {
+        *length = entry->data.size();
+        return ESP_OK;
+    }
+    if (*length < entry->data.size()) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out, entry->data.data(), entry->data.size());
+    *length = entry->data.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init(void) {
+    initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_deinit(void) {
+    initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    partition.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    if (!initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    // As on the device, only a read-write open creates a namespace.
+    if (open_mode == NVS_READONLY && partition.find(name) == partition.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    stats.opens++;
+    partition[name];
+    handles.push_back(name);
+    *out_handle = handles.size();
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    stats.commits++;
+    return lookup(handle) == nullptr ? ESP_ERR_NVS_INVALID_HANDLE : ESP_OK;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    const entry_t* entry;
+    esp_err_t result = get(handle, key, ENTRY_U8, &entry);
+    if (result == ESP_OK) {
+        *out_value = entry->data[0];
+    }
+    return result;
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return set(handle, key, ENTRY_U8, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char* key, uint32_t* out_value) {
+    const entry_t* entry;
+    esp_err_t result = get(handle, key, ENTRY_U32, &entry);
+    if (result == ESP_OK) {
+        memcpy(out_value, entry->data.data(), sizeof(uint32_t));
+    }
+    return result;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char* key, uint32_t value) {
+    return set(handle, key, ENTRY_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    return get_variable(handle, key, ENTRY_STR, out_value, length);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    return set(handle, key, ENTRY_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+    return get_variable(handle, key, ENTRY_BLOB, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    return set(handle, key, ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    nvs_namespace_t* ns = lookup(handle);
+    if (ns == nullptr) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    stats.writes++;
+    return ns->erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    nvs_namespace_t* ns = lookup(handle);
+    if (ns == nullptr) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    stats.writes++;
+    ns->clear();
+    return ESP_OK;
+}
+
+// Iterators hold a copy of the matching entries, type filtering aside.
+struct nvs_opaque_iterator_t {
+    std::vector<nvs_entry_info_t> entries;
+    size_t position;
+};
+
+nvs_iterator_t nvs_entry_find(const char* part_name, const char* namespace_name, nvs_type_t type) {
+    nvs_iterator_t iterator = new nvs_opaque_iterator_t{ {}, 0 };
+    for (const auto& ns : partition) {
+        if (namespace_name != nullptr && ns.first != namespace_name) {
+            continue;
+        }
+        for (const auto& entry : ns.second) {
+            nvs_entry_info_t info = {};
+            strncpy(info.namespace_name, ns.first.c_str(), NVS_KEY_NAME_MAX_SIZE - 1);
+            strncpy(info.key, entry.first.c_str(), NVS_KEY_NAME_MAX_SIZE - 1);
+            info.type = NVS_TYPE_ANY;
+            iterator->entries.push_back(info);
+        }
+    }
+    if (iterator->entries.empty()) {
+        delete iterator;
+        return nullptr;
+    }
+    return iterator;
+}
+
+nvs_iterator_t nvs_entry_next(nvs_iterator_t iterator) {
+    if (++iterator->position < iterator->entries.size()) {
+        return iterator;
+    }
+    delete iterator;
+    return nullptr;
+}
+
+void nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t* out_info) {
+    *out_info = iterator->entries[iterator->position];
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    delete iterator;
+}
+
+uint32_t esp_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+httpd_req_t host_request(std::string query, std::string body, size_t recv_limit) {
+    httpd_req_t request = {};
+    request.method = (body.empty() ? HTTP_GET : HTTP_POST);
+    request.query = std::move(query);
+    request.body = std::move(body);
+    request.content_len = request.body.length();
+    request.recv_limit = recv_limit;
+    return request;
+}
+
+httpd_req_t host_get(const char* uri) {
+    httpd_req_t request = {};
+    request.method = HTTP_GET;
+    strncpy(request.uri, uri, HTTPD_MAX_URI_LEN);
+    return request;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t* r) {
+    return r->query.length();
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* r, char* buf, size_t buf_len) {
+    if (buf_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t length = std::min(r->query.length(), buf_len - 1);
+    memcpy(buf, r->query.data(), length);
+    buf[length] = '\0';
+    return length < r->query.length() ? ESP_ERR_HTTPD_RESULT_TRUNC : ESP_OK;
+}
+
+int httpd_req_recv(httpd_req_t* r, char* buf, size_t buf_len) {
+    size_t length = std::min(buf_len, r->body.length() - r->body_position);
+    if (r->recv_limit > 0) {
+        length = std::min(length, r->recv_limit);
+    }
+    if (length == 0) {
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    memcpy(buf, r->body.data() + r->body_position, length);
+    r->body_position += length;
+    return length;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t* r, const char* field) {
+    auto header = r->headers.find(field);
+    return header == r->headers.end() ? 0 : header->second.length();
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* r, const char* field, char* val, size_t val_size) {
+    auto header = r->headers.find(field);
+    if (header == r->headers.end()) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (val_size <= header->second.length()) {
+        return ESP_ERR_HTTPD_RESULT_TRUNC;
+    }
+    memcpy(val, header->second.c_str(), header->second.length() + 1);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t* r, const char* status) {
+    r->status = status;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* r, const char* type) {
+    r->type = type;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* r, const char* field, const char* value) {
+    r->response_headers[field] = value;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_404(httpd_req_t* r) {
+    r->status = "404 Not Found";
+    r->complete = true;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_408(httpd_req_t* r) {
+    r->status = "408 Request Timeout";
+    r->complete = true;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* r, const char* buf, long buf_len) {
+    r->response.assign(buf == nullptr ? "" : buf, buf == nullptr ? 0 : buf_len);
+    r->complete = true;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* r, const char* buf, long buf_len) {
+    if (r->complete) {
+        return ESP_FAIL;
+    }
+    if (buf == nullptr || buf_len == 0) {
+        r->complete = true;
+        return ESP_OK;
+    }
+    r->response.append(buf, buf_len);
+    r->chunks++;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+    static const auto started = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+}
+
+static std::string image = "0123456789abcdef0123456789abcdef";
+
+void host_set_image(const char* sha256) {
+    image = sha256;
+}
+
+int esp_ota_get_app_elf_sha256(char* dst, size_t size) {
+    return snprintf(dst, size, "%s", image.c_str());
+}
@@ -0,0 +1,28 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include "esp_http_server.h"
+
+#include <cstddef>
+#include <string>
+
+typedef struct {
+    size_t opens;
+    size_t reads;
+    size_t writes;
+    size_t commits;
+} host_nvs_stats_t;
+
+// Clears every namespace and counter of the in-memory NVS.
+void host_nvs_reset();
+const host_nvs_stats_t& host_nvs_stats();
+
+// Builds a request carrying the given query and body. recv_limit caps the
+// bytes returned by a single httpd_req_recv call, 0 meaning unlimited.
+httpd_req_t host_request(std::string query, std::string body = {}, size_t recv_limit = 0);
+httpd_req_t host_get(const char* uri);
+
+// Changes the ELF hash reported for the running image, as after an update.
+void host_set_image(const char* sha256);
+
+#endif
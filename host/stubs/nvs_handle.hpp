@@ -0,0 +1,6 @@
+#ifndef NVS_HANDLE_HPP
+#define NVS_HANDLE_HPP
+
+#include "nvs.h"
+
+#endif
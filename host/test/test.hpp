@@ -0,0 +1,35 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// Minimal assertion helpers shared by the host unit tests. Each test file
+// is its own executable; main() returns the number of failed checks.
+
+static int test_failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+    auto check_actual = (actual); \
+    auto check_expected = (expected); \
+    if (!(check_actual == check_expected)) { \
+        fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed\n", __FILE__, __LINE__, #actual, #expected); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define RUN(test) do { \
+    int failures_before = test_failures; \
+    test(); \
+    fprintf(stderr, "%s %s\n", test_failures == failures_before ? "PASS" : "FAIL", #test); \
+} while (0)
+
+#endif
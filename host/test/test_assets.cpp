@@ -0,0 +1,52 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "assets.hpp"
+
+static void test_lookup() {
+    CHECK(Assets::find("/style.css") != nullptr);
+    CHECK(Assets::find("/index.html") == nullptr);
+    CHECK(Assets::find("/missing.js") == nullptr);
+    for (size_t i = 1; i < asset_count; i++) {
+        CHECK(std::string_view(assets[i - 1].path) < std::string_view(assets[i].path));
+    }
+}
+
+static void test_serve_gzip() {
+    httpd_req_t request = host_get("/style.css?from=test");
+    CHECK_EQ(Assets::handler(&request), ESP_OK);
+    const asset_t* asset = Assets::find("/style.css");
+    CHECK_EQ(request.type, "text/css");
+    CHECK_EQ(request.response_headers["Content-Encoding"], "gzip");
+    CHECK_EQ(request.response_headers["ETag"], asset->etag);
+    CHECK_EQ(request.response.size(), asset->length);
+    CHECK(request.complete);
+    CHECK((uint8_t)request.response[0] == 0x1f && (uint8_t)request.response[1] == 0x8b);
+}
+
+static void test_not_modified() {
+    const asset_t* asset = Assets::find("/style.css");
+    httpd_req_t request = host_get("/style.css");
+    request.headers["If-None-Match"] = asset->etag;
+    CHECK_EQ(Assets::handler(&request), ESP_OK);
+    CHECK_EQ(request.status, "304 Not Modified");
+    CHECK(request.response.empty());
+    httpd_req_t stale = host_get("/style.css");
+    stale.headers["If-None-Match"] = "\"0000\"";
+    Assets::handler(&stale);
+    CHECK(stale.status.empty());
+    CHECK_EQ(stale.response.size(), asset->length);
+}
+
+static void test_missing() {
+    httpd_req_t request = host_get("/missing.js");
+    Assets::handler(&request);
+    CHECK_EQ(request.status, "404 Not Found");
+}
+
+int main() {
+    RUN(test_lookup);
+    RUN(test_serve_gzip);
+    RUN(test_not_modified);
+    RUN(test_missing);
+    return test_failures;
+}
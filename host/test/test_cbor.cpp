@@ -0,0 +1,106 @@
+#include "test.hpp"
+#include "cbor.hpp"
+
+#include <cstring>
+
+static bool encodes(const uint8_t* actual, size_t length, const char* expected, size_t expected_length) {
+    return length == expected_length && memcmp(actual, expected, length) == 0;
+}
+
+#define CHECK_ENCODING(writer, buffer, expected) \
+    CHECK((writer).ok() && encodes(buffer, (writer).length(), expected, sizeof(expected) - 1))
+
+// Examples from RFC 8949, Appendix A.
+static void test_integers() {
+    uint8_t buffer[16];
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_uint(0), buffer, "\x00");
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_uint(23), buffer, "\x17");
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_uint(24), buffer, "\x18\x18");
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_uint(1000), buffer, "\x19\x03\xe8");
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_uint(1000000), buffer, "\x1a\x00\x0f\x42\x40");
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_uint(1000000000000ull), buffer,
+        "\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00");
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_int(-1), buffer, "\x20");
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_int(-1000), buffer, "\x39\x03\xe7");
+    CHECK_ENCODING(CBORWriter(buffer, sizeof(buffer)).add_bool(true), buffer, "\xf5");
+
+    int64_t value = 0;
+    CBORReader negative(reinterpret_cast<const uint8_t*>("\x39\x03\xe7"), 3);
+    CHECK(negative.read_int(value) && value == -1000 && negative.at_end());
+    uint64_t unsigned_value = 0;
+    CBORReader large(reinterpret_cast<const uint8_t*>("\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00"), 9);
+    CHECK(large.read_uint(unsigned_value) && unsigned_value == 1000000000000ull);
+}
+
+static void test_containers() {
+    uint8_t buffer[32];
+    CBORWriter writer(buffer, sizeof(buffer));
+    writer.begin_map(2)
+        .add_text("a").add_uint(1)
+        .add_text("b").begin_array(2).add_uint(2).add_uint(3);
+    CHECK_ENCODING(writer, buffer, "\xa2\x61\x61\x01\x61\x62\x82\x02\x03");
+
+    CBORReader reader(buffer, writer.length());
+    size_t count = 0;
+    std::string_view key;
+    uint64_t value = 0;
+    CHECK(reader.read_map(count) && count == 2);
+    CHECK(reader.read_text(key) && key == "a");
+    CHECK(reader.read_uint(value) && value == 1);
+    CHECK(reader.read_text(key) && key == "b");
+    CHECK(reader.skip());
+    CHECK(reader.at_end() && reader.ok());
+}
+
+static void test_overflow() {
+    uint8_t buffer[4];
+    CBORWriter writer(buffer, sizeof(buffer));
+    writer.add_text("IETF");
+    CHECK(!writer.ok());
+    CBORWriter exact(buffer, sizeof(buffer));
+    exact.add_text("IET");
+    CHECK(exact.ok() && exact.length() == 4);
+}
+
+static void test_rejections() {
+    std::string_view text;
+    uint64_t value = 0;
+    size_t count = 0;
+
+    // Length beyond the end of the input.
+    CBORReader truncated(reinterpret_cast<const uint8_t*>("\x64\x49\x45"), 3);
+    CHECK(!truncated.read_text(text));
+    CHECK(!truncated.ok());
+
+    // Wrong type, and the reader stays failed afterwards.
+    CBORReader mismatch(reinterpret_cast<const uint8_t*>("\x61\x61\x01"), 3);
+    CHECK(!mismatch.read_uint(value));
+    CHECK(!mismatch.read_text(text));
+
+    // Indefinite lengths and reserved additional information.
+    CBORReader indefinite(reinterpret_cast<const uint8_t*>("\x9f\x01\xff"), 3);
+    CHECK(!indefinite.read_array(count));
+    CBORReader reserved(reinterpret_cast<const uint8_t*>("\x1c"), 1);
+    CHECK(!reserved.read_uint(value));
+
+    // A huge element count cannot be larger than the input.
+    CBORReader huge(reinterpret_cast<const uint8_t*>("\x9a\xff\xff\xff\xff\x01"), 6);
+    CHECK(!huge.read_array(count));
+    CBORReader huge_skip(reinterpret_cast<const uint8_t*>("\xbb\x40\x00\x00\x00\x00\x00\x00\x00"), 9);
+    CHECK(!huge_skip.skip());
+
+    // Nesting beyond CBOR_MAX_DEPTH.
+    uint8_t nested[CBOR_MAX_DEPTH + 1];
+    memset(nested, 0x81, sizeof(nested));
+    nested[CBOR_MAX_DEPTH] = 0x00;
+    CBORReader deep(nested, sizeof(nested));
+    CHECK(!deep.skip());
+}
+
+int main() {
+    RUN(test_integers);
+    RUN(test_containers);
+    RUN(test_overflow);
+    RUN(test_rejections);
+    return test_failures;
+}
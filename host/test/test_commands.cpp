@@ -0,0 +1,184 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "commands.hpp"
+#include "json.hpp"
+#include "json_reader.hpp"
+
+#include <cstring>
+
+static int calls = 0;
+
+static esp_err_t counting_command(httpd_req_t* request, Query& query) {
+    calls++;
+    httpd_resp_send(request, query.get("type").data(), query.get("type").length());
+    return ESP_OK;
+}
+
+static const command_t first_commands[] = {
+    { "status", counting_command, COMMAND_GET, {} },
+    { "brew", counting_command, COMMAND_GET | COMMAND_POST, { "cups" } },
+};
+
+static const command_t second_commands[] = {
+    { "power", counting_command, COMMAND_POST, { "state" } },
+    { "boot", counting_command, COMMAND_GET, {} },
+};
+
+static const command_t duplicate_commands[] = {
+    { "status", counting_command, COMMAND_POST, {} },
+};
+
+static void test_registry() {
+    CHECK(Commands::add(first_commands, 2));
+    CHECK(Commands::add(second_commands, 2));
+    CHECK_EQ(Commands::size(), (size_t)4);
+    CHECK(Commands::add(first_commands, 2));
+    CHECK_EQ(Commands::size(), (size_t)4);
+    CHECK(!Commands::add(duplicate_commands, 1));
+    CHECK(Commands::find("status") == &first_commands[0]);
+    CHECK(Commands::find("boot") == &second_commands[1]);
+    CHECK(Commands::find("stat") == NULL);
+    CHECK(Commands::find("") == NULL);
+}
+
+static void test_dispatch() {
+    calls = 0;
+    httpd_req_t request = host_request("type=brew&cups=2");
+    CHECK_EQ(Commands::dispatch(&request), ESP_OK);
+    CHECK_EQ(calls, 1);
+    CHECK_EQ(request.response, "brew");
+}
+
+static void test_rejections() {
+    calls = 0;
+    httpd_req_t unknown = host_request("type=explode");
+    Commands::dispatch(&unknown);
+    CHECK(unknown.response.find("Invalid command: 'explode'") != std::string::npos);
+
+    httpd_req_t missing = host_request("cups=1");
+    Commands::dispatch(&missing);
+    CHECK(missing.response.find("Missing 'type'") != std::string::npos);
+
+    httpd_req_t parameter = host_request("type=brew");
+    Commands::dispatch(&parameter);
+    CHECK(parameter.response.find("Missing 'cups'") != std::string::npos);
+
+    httpd_req_t method = host_request("type=power&state=on");
+    Commands::dispatch(&method);
+    CHECK_EQ(method.status, "405 Method Not Allowed");
+
+    method.method = HTTP_POST;
+    method.response.clear();
+    Commands::dispatch(&method);
+    CHECK_EQ(method.response, "power");
+    CHECK_EQ(calls, 1);
+}
+
+static int reports = 0;
+
+static esp_err_t report_command(httpd_req_t* request, Query& query) {
+    reports++;
+    JSON(request, query)
+        .add_bool("success", query.get("fail").empty())
+        .add_string("command", query.get("type"))
+        .finalize();
+    return ESP_OK;
+}
+
+static const command_t batch_commands[] = {
+    { "report", report_command, COMMAND_GET, {} },
+    { "set", report_command, COMMAND_POST, { "value" } },
+};
+
+static httpd_req_t batch_request(const char* body) {
+    httpd_req_t request = host_request("", body);
+    request.headers["Content-Type"] = "application/json";
+    return request;
+}
+
+// The combined response is valid JSON with one element per command run.
+static size_t copy_response(const httpd_req_t& request, char* buffer, size_t size) {
+    CHECK(request.complete);
+    CHECK(request.response.length() < size);
+    size_t length = std::min(request.response.length(), size - 1);
+    memcpy(buffer, request.response.data(), length);
+    return length;
+}
+
+static void test_batch() {
+    CHECK(Commands::add(batch_commands, 2));
+    reports = 0;
+    httpd_req_t request = batch_request(
+        "{\"commands\": [{\"type\": \"report\"}, {\"type\": \"set\", \"value\": 3}, {\"type\": \"report\"}]}");
+    // A route's own context is neither read nor replaced.
+    int context = 0;
+    request.user_ctx = &context;
+    CHECK_EQ(Commands::batch(&request), ESP_OK);
+    CHECK_EQ(reports, 3);
+    CHECK(request.user_ctx == &context);
+    // Every result is streamed as its own chunk, followed by the totals.
+    CHECK_EQ(request.chunks, 4u);
+
+    char buffer[1024];
+    JSONReader reader(buffer, copy_response(request, buffer, sizeof(buffer)));
+    CHECK(reader.ok());
+    int results = reader.find(JSON_READER_ROOT, "results");
+    CHECK(results > 0 && reader.token(results).size == 3);
+    CHECK(reader.view(reader.find(results + 1, "command")) == "report");
+    uint32_t executed = 0;
+    bool success = false;
+    CHECK(reader.get_uint(JSON_READER_ROOT, "executed", executed) && executed == 3);
+    CHECK(reader.get_bool(JSON_READER_ROOT, "success", success) && success);
+}
+
+static void test_batch_errors() {
+    reports = 0;
+    httpd_req_t request = batch_request(
+        "{\"commands\": [{\"type\": \"report\", \"fail\": 1}, {\"type\": \"explode\"}, {\"type\": \"set\"}, 7]}");
+    CHECK_EQ(Commands::batch(&request), ESP_OK);
+    CHECK_EQ(reports, 1);
+    CHECK(request.response.find("Invalid command: 'explode'") != std::string::npos);
+    CHECK(request.response.find("Missing 'value' parameter!") != std::string::npos);
+    CHECK(request.response.find("Batch entries must be objects!") != std::string::npos);
+    char buffer[1024];
+    JSONReader errors(buffer, copy_response(request, buffer, sizeof(buffer)));
+    uint32_t failed = 0;
+    CHECK(errors.get_uint(JSON_READER_ROOT, "failed", failed) && failed == 4);
+
+    reports = 0;
+    httpd_req_t stopped = batch_request(
+        "{\"stop_on_error\": true, \"commands\": [{\"type\": \"report\"}, {\"type\": \"report\", \"fail\": 1}, {\"type\": \"report\"}]}");
+    Commands::batch(&stopped);
+    CHECK_EQ(reports, 2);
+    JSONReader partial(buffer, copy_response(stopped, buffer, sizeof(buffer)));
+    uint32_t skipped = 0;
+    CHECK(partial.get_uint(JSON_READER_ROOT, "skipped", skipped) && skipped == 1);
+
+    httpd_req_t empty = batch_request("{\"commands\": []}");
+    Commands::batch(&empty);
+    JSONReader nothing(buffer, copy_response(empty, buffer, sizeof(buffer)));
+    CHECK(nothing.ok());
+
+    httpd_req_t missing = batch_request("{\"type\": \"report\"}");
+    Commands::batch(&missing);
+    CHECK(missing.response.find("Missing 'commands' array!") != std::string::npos);
+
+    httpd_req_t form = host_request("", "commands=report");
+    Commands::batch(&form);
+    CHECK(form.response.find("\"success\": false") != std::string::npos);
+
+    // Outside a batch the same handler still ends its own response.
+    httpd_req_t single = host_request("type=report");
+    CHECK_EQ(Commands::dispatch(&single), ESP_OK);
+    CHECK(single.complete);
+    CHECK_EQ(single.chunks, 1u);
+}
+
+int main() {
+    RUN(test_registry);
+    RUN(test_dispatch);
+    RUN(test_rejections);
+    RUN(test_batch);
+    RUN(test_batch_errors);
+    return test_failures;
+}
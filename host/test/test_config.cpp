@@ -0,0 +1,222 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "config.hpp"
+#include "nvstorage.hpp"
+
+#include "esp_crc.h"
+
+#include <cstring>
+
+static void setup() {
+    host_nvs_reset();
+    NVStorage::init();
+}
+
+static void test_round_trip() {
+    setup();
+    CHECK(Config::load());
+    CHECK(Config().uninitialized());
+    CHECK(Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK));
+    Config snapshot;
+    CHECK(snapshot.get_ssid() == "Office");
+    CHECK(snapshot.get_psk() == "secret");
+    CHECK(Config::load());
+    CHECK(Config().get_ssid() == "Office");
+    CHECK_EQ(Config().get_security(), WIFI_AUTH_WPA2_PSK);
+}
+
+static void test_single_read() {
+    setup();
+    Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK);
+    size_t reads = host_nvs_stats().reads;
+    CHECK(Config::load());
+    CHECK_EQ(host_nvs_stats().reads - reads, 1u);
+}
+
+static void test_elided_commit() {
+    setup();
+    Config::load();
+    CHECK(Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK));
+    size_t writes = host_nvs_stats().writes;
+    size_t commits = host_nvs_stats().commits;
+    CHECK(Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK));
+    CHECK_EQ(host_nvs_stats().writes, writes);
+    CHECK_EQ(host_nvs_stats().commits, commits);
+}
+
+static void test_migration() {
+    setup();
+    {
+        NVStorage storage("config", true);
+        storage.set_str("ssid", "Legacy");
+        storage.set_str("psk", "password");
+        storage.set_uint8("security", WIFI_AUTH_WPA_PSK);
+    }
+    CHECK(Config::load());
+    CHECK(Config().get_ssid() == "Legacy");
+    CHECK_EQ(Config().get_security(), WIFI_AUTH_WPA_PSK);
+    NVStorage storage("config", true);
+    size_t length = 0;
+    CHECK(!storage.get_blob("ssid", nullptr, length));
+    CHECK(storage.get_str("ssid").empty());
+}
+
+static void test_corrupt_record() {
+    setup();
+    Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK);
+    {
+        NVStorage storage("config", true);
+        uint8_t record[256];
+        size_t length = sizeof(record);
+        CHECK(storage.get_blob("record", record, length));
+        record[length - 1] ^= 0xFF;
+        storage.set_blob("record", record, length);
+    }
+    CHECK(!Config::load());
+    CHECK(Config().uninitialized());
+}
+
+// A read error other than a missing record must not run the migration.
+static void test_read_error() {
+    setup();
+    {
+        NVStorage storage("config", true);
+        storage.set_str("record", "not a blob");
+        storage.set_str("ssid", "Legacy");
+    }
+    CHECK(!Config::load());
+    NVStorage storage("config", true);
+    CHECK(storage.get_str("ssid") == "Legacy");
+    CHECK(storage.get_str("record") == "not a blob");
+}
+
+static int notifications = 0;
+
+static void listener(const Config& config, void* context) {
+    notifications++;
+    CHECK(config.get_ssid() == static_cast<const char*>(context));
+}
+
+static void test_listener() {
+    setup();
+    Config::load();
+    CHECK(Config::subscribe(listener, (void*)"Office"));
+    Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK);
+    CHECK_EQ(notifications, 1);
+}
+
+static void test_profiles() {
+    setup();
+    Config::load();
+    CHECK(Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK));
+    CHECK(Config().set_network("Lab", "bench", WIFI_AUTH_WPA3_PSK, 3));
+    CHECK(Config().set_network("Home", "family", WIFI_AUTH_WPA_WPA2_PSK));
+    CHECK(!Config().set_network("", "secret", WIFI_AUTH_WPA2_PSK));
+    CHECK(!Config().set_network("Attic", "secret", WIFI_AUTH_WPA2_PSK, CONFIG_MAX_PRIORITY + 1));
+    CHECK(Config::load());
+    Config config;
+    CHECK_EQ(config.profile_count(), 3u);
+    CHECK(config.get_ssid() == "Home");
+    CHECK(config.find_profile("Office") != nullptr);
+    const config_profile_t* lab = config.find_profile("Lab");
+    CHECK(lab != nullptr && lab->priority == 3 && lab->security == WIFI_AUTH_WPA3_PSK);
+
+    // Updating a profile moves it to the front without duplicating it.
+    CHECK(Config().set_network("Office", "changed", WIFI_AUTH_WPA2_PSK));
+    CHECK(Config::load());
+    CHECK_EQ(Config().profile_count(), 3u);
+    CHECK(Config().get_psk() == "changed");
+
+    CHECK(Config().remove_network("Lab"));
+    CHECK(!Config().remove_network("Lab"));
+    CHECK(Config::load());
+    CHECK_EQ(Config().profile_count(), 2u);
+    CHECK(Config().get_profile(1).ssid == std::string_view("Home"));
+}
+
+static void test_profile_eviction() {
+    setup();
+    Config::load();
+    const char* names[] = { "A", "B", "C", "D", "E" };
+    for (const char* name : names) {
+        CHECK(Config().set_network(name, "secret", WIFI_AUTH_WPA2_PSK));
+    }
+    CHECK(Config::load());
+    Config config;
+    CHECK_EQ(config.profile_count(), (size_t)CONFIG_MAX_PROFILES);
+    CHECK(config.get_ssid() == "E");
+    CHECK(config.find_profile("A") == nullptr);
+    CHECK(config.find_profile("B") != nullptr);
+}
+
+// Version 1 records stop after the security byte of the only network.
+static void test_version_one_record() {
+    setup();
+    {
+        NVStorage storage("config", true);
+        uint8_t record[12 + 99] = {};
+        uint32_t magic = 0x47464353;
+        uint16_t version = 1;
+        uint16_t length = 99;
+        memcpy(record, &magic, 4);
+        memcpy(record + 4, &version, 2);
+        memcpy(record + 6, &length, 2);
+        memcpy(record + 12, "Legacy", 6);
+        memcpy(record + 12 + 33, "password", 8);
+        record[12 + 98] = WIFI_AUTH_WPA2_PSK;
+        uint32_t crc = esp_crc32_le(0, record + 12, length);
+        memcpy(record + 8, &crc, 4);
+        storage.set_blob("record", record, sizeof(record));
+    }
+    CHECK(Config::load());
+    Config config;
+    CHECK_EQ(config.profile_count(), 1u);
+    CHECK(config.get_ssid() == "Legacy");
+    CHECK(config.get_psk() == "password");
+    CHECK_EQ(config.get_profile(0).priority, 0);
+    CHECK_EQ(config.get_security(), WIFI_AUTH_WPA2_PSK);
+}
+
+static void test_transaction_stats() {
+    setup();
+    NVStorage storage("test", true);
+    storage.set_uint8("a", 1);
+    storage.begin();
+    storage.set_uint8("a", 1);
+    storage.set_uint8("b", 2);
+    storage.set_str("c", "value");
+    size_t commits = host_nvs_stats().commits;
+    CHECK(storage.commit());
+    CHECK_EQ(host_nvs_stats().commits - commits, 1u);
+    CHECK_EQ(storage.transaction_stats().staged, 3);
+    CHECK_EQ(storage.transaction_stats().written, 2);
+    CHECK_EQ(storage.transaction_stats().elided, 1);
+}
+
+static void test_erase_except() {
+    setup();
+    Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK);
+    NVStorage("ota", true).set_str("token", "0123456789abcdef");
+    NVStorage("other", true).set_str("a", "value");
+    CHECK(NVStorage::erase_except("ota"));
+    CHECK(Config::load());
+    CHECK(Config().uninitialized());
+    CHECK(NVStorage("other", false).get_str("a").empty());
+    CHECK(NVStorage("ota", false).get_str("token") == "0123456789abcdef");
+}
+
+int main() {
+    RUN(test_round_trip);
+    RUN(test_single_read);
+    RUN(test_elided_commit);
+    RUN(test_migration);
+    RUN(test_corrupt_record);
+    RUN(test_read_error);
+    RUN(test_profiles);
+    RUN(test_profile_eviction);
+    RUN(test_version_one_record);
+    RUN(test_listener);
+    RUN(test_transaction_stats);
+    RUN(test_erase_except);
+    return test_failures;
+}
@@ -0,0 +1,198 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "counterlog.hpp"
+#include "nvstorage.hpp"
+
+#include <cstring>
+
+#define SECOND_US 1000000LL
+
+static void setup() {
+    host_nvs_reset();
+    NVStorage::init();
+}
+
+static void test_round_trip() {
+    setup();
+    NVStorage storage(COUNTERLOG_NAMESPACE, true);
+    CounterLog log;
+    CHECK(!log.load(storage));
+    log.add(COUNTER_CUPS, 2);
+    log.add(COUNTER_REBOOTS, 1);
+    CHECK(log.flush(storage, 0));
+    CHECK(!log.dirty());
+    CounterLog loaded;
+    CHECK(loaded.load(storage));
+    CHECK_EQ(loaded.value(COUNTER_CUPS), 2u);
+    CHECK_EQ(loaded.value(COUNTER_REBOOTS), 1u);
+    CHECK_EQ(loaded.records(), 1u);
+}
+
+static void test_flush_policy() {
+    setup();
+    NVStorage storage(COUNTERLOG_NAMESPACE, true);
+    CounterLog log;
+    CHECK(!log.due(0));
+    for (uint32_t cup = 0; cup < CounterLog::max_loss(COUNTER_CUPS); cup++) {
+        log.add(COUNTER_CUPS, 1);
+    }
+    CHECK(!log.due(SECOND_US));
+    log.add(COUNTER_CUPS, 1);
+    CHECK(log.due(SECOND_US));
+    CHECK(log.flush(storage, SECOND_US));
+
+    log.add(COUNTER_UPTIME_SECONDS, 60);
+    CHECK(!log.due(2 * SECOND_US));
+    CHECK(log.due(SECOND_US + COUNTERLOG_FLUSH_INTERVAL_S * SECOND_US));
+
+    size_t writes = host_nvs_stats().writes;
+    CounterLog idle;
+    CHECK(idle.flush(storage, 0));
+    CHECK_EQ(host_nvs_stats().writes, writes);
+}
+
+static void test_rotation() {
+    setup();
+    NVStorage storage(COUNTERLOG_NAMESPACE, true);
+    CounterLog log;
+    for (int i = 0; i < 3 * COUNTERLOG_SLOTS + 1; i++) {
+        log.add(COUNTER_REBOOTS, 1);
+        CHECK(log.flush(storage, 0));
+    }
+    for (uint32_t slot = 0; slot < COUNTERLOG_SLOTS; slot++) {
+        char key[8];
+        snprintf(key, sizeof(key), "log%u", (unsigned)slot);
+        counter_record_t record;
+        size_t length = sizeof(record);
+        CHECK(storage.get_blob(key, &record, length));
+        CHECK_EQ(record.sequence % COUNTERLOG_SLOTS, slot);
+    }
+    CounterLog loaded;
+    loaded.load(storage);
+    CHECK_EQ(loaded.value(COUNTER_REBOOTS), 3u * COUNTERLOG_SLOTS + 1);
+}
+
+// A damaged newest record falls back to the one before it.
+static void test_damaged_record() {
+    setup();
+    NVStorage storage(COUNTERLOG_NAMESPACE, true);
+    CounterLog log;
+    log.add(COUNTER_CUPS, 5);
+    log.flush(storage, 0);
+    log.add(COUNTER_CUPS, 5);
+    log.flush(storage, 0);
+
+    counter_record_t record;
+    size_t length = sizeof(record);
+    CHECK(storage.get_blob("log2", &record, length));
+    record.values[COUNTER_CUPS] = 1000;
+    storage.set_blob("log2", &record, sizeof(record));
+
+    CounterLog loaded;
+    CHECK(loaded.load(storage));
+    CHECK_EQ(loaded.value(COUNTER_CUPS), 5u);
+    CHECK_EQ(loaded.records(), 1u);
+}
+
+static void test_retained() {
+    setup();
+    NVStorage storage(COUNTERLOG_NAMESPACE, true);
+    CounterLog log;
+    log.add(COUNTER_CUPS, 5);
+    log.flush(storage, 0);
+    log.add(COUNTER_CUPS, 3);
+    log.add(COUNTER_HEATER_SECONDS, 120);
+    counter_retained_t retained;
+    log.retain(retained);
+
+    // Software reset: the pending increments come back exactly once.
+    CounterLog restarted;
+    restarted.load(storage);
+    CHECK(restarted.restore(retained));
+    CHECK_EQ(restarted.value(COUNTER_CUPS), 8u);
+    CHECK_EQ(restarted.value(COUNTER_HEATER_SECONDS), 120u);
+    CHECK(restarted.flush(storage, 0));
+    CounterLog again;
+    again.load(storage);
+    CHECK(!again.restore(retained));
+    CHECK_EQ(again.value(COUNTER_CUPS), 8u);
+
+    // Power loss: RTC memory holds garbage.
+    counter_retained_t garbage;
+    memset(&garbage, 0xA5, sizeof(garbage));
+    CHECK(!again.restore(garbage));
+    CHECK_EQ(again.value(COUNTER_CUPS), 8u);
+}
+
+static void test_descale() {
+    setup();
+    NVStorage storage(COUNTERLOG_NAMESPACE, true);
+    CounterLog log;
+    log.add(COUNTER_CUPS, 40);
+    CHECK_EQ(log.cups_since_descale(), 40u);
+    log.add(COUNTER_DESCALES, 1);
+    CHECK(log.due(0));
+    log.add(COUNTER_CUPS, 2);
+    CHECK_EQ(log.cups_since_descale(), 2u);
+    log.flush(storage, 0);
+    CounterLog loaded;
+    loaded.load(storage);
+    CHECK_EQ(loaded.cups_since_descale(), 2u);
+    CHECK_EQ(loaded.value(COUNTER_DESCALES), 1u);
+}
+
+// Increments that arrive while a record is being written stay pending.
+static void test_split_flush() {
+    setup();
+    NVStorage storage(COUNTERLOG_NAMESPACE, true);
+    CounterLog log;
+    counter_record_t record;
+    CHECK(!log.prepare(record));
+    log.add(COUNTER_CUPS, 5);
+    CHECK(log.prepare(record));
+    log.add(COUNTER_CUPS, 2);
+    log.add(COUNTER_DESCALES, 1);
+    CHECK(CounterLog::write(storage, record));
+    log.committed(record, SECOND_US);
+    CHECK_EQ(log.records(), 1u);
+    CHECK_EQ(log.value(COUNTER_CUPS), 7u);
+    CHECK_EQ(log.cups_since_descale(), 0u);
+    CHECK(log.dirty());
+
+    CounterLog loaded;
+    loaded.load(storage);
+    CHECK_EQ(loaded.value(COUNTER_CUPS), 5u);
+    CHECK_EQ(loaded.value(COUNTER_DESCALES), 0u);
+    CHECK(log.flush(storage, 2 * SECOND_US));
+    CHECK(!log.dirty());
+    loaded.load(storage);
+    CHECK_EQ(loaded.value(COUNTER_CUPS), 7u);
+    CHECK_EQ(loaded.cups_since_descale(), 0u);
+}
+
+static void test_wear() {
+    CounterLog log;
+    CHECK_EQ(log.erase_cycles(), 0u);
+    CHECK_EQ(log.wear_ppm(), 0u);
+    setup();
+    NVStorage storage(COUNTERLOG_NAMESPACE, true);
+    for (int i = 0; i < 1000; i++) {
+        log.add(COUNTER_REBOOTS, 1);
+        log.flush(storage, 0);
+    }
+    CHECK(log.erase_cycles() > 0);
+    CHECK(log.wear_ppm() > 0);
+    CHECK(log.wear_ppm() < 1000);
+}
+
+int main() {
+    RUN(test_round_trip);
+    RUN(test_flush_policy);
+    RUN(test_rotation);
+    RUN(test_damaged_record);
+    RUN(test_retained);
+    RUN(test_descale);
+    RUN(test_split_flush);
+    RUN(test_wear);
+    return test_failures;
+}
@@ -0,0 +1,50 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "form.hpp"
+
+#include <map>
+
+typedef std::map<std::string, std::string> fields_t;
+
+static bool collect(std::string_view key, std::string_view value, void* context) {
+    (*static_cast<fields_t*>(context))[std::string(key)] = std::string(value);
+    return true;
+}
+
+static void test_split_body() {
+    fields_t fields;
+    httpd_req_t request = host_request("", "ssid=My+Net%21&psk=pa%26ss", 3);
+    CHECK_EQ(Form(collect, &fields).receive(&request), FORM_OK);
+    CHECK_EQ(fields["ssid"], "My Net!");
+    CHECK_EQ(fields["psk"], "pa&ss");
+}
+
+static void test_limits() {
+    fields_t fields;
+    httpd_req_t large = host_request("", std::string(FORM_MAX_BODY_LENGTH + 1, 'a'));
+    CHECK_EQ(Form(collect, &fields).receive(&large), FORM_ERR_BODY_TOO_LARGE);
+    httpd_req_t field = host_request("", "k=" + std::string(FORM_MAX_VALUE_LENGTH + 1, 'a'));
+    CHECK_EQ(Form(collect, &fields).receive(&field), FORM_ERR_FIELD_TOO_LONG);
+}
+
+static void test_malformed() {
+    fields_t fields;
+    Form form(collect, &fields);
+    CHECK_EQ(form.feed("a=%4", 4), FORM_OK);
+    CHECK_EQ(form.finish(), FORM_ERR_MALFORMED);
+}
+
+static void test_truncated() {
+    fields_t fields;
+    httpd_req_t request = host_request("", "a=b");
+    request.content_len = 10;
+    CHECK_EQ(Form(collect, &fields).receive(&request), FORM_ERR_RECV);
+}
+
+int main() {
+    RUN(test_split_body);
+    RUN(test_limits);
+    RUN(test_malformed);
+    RUN(test_truncated);
+    return test_failures;
+}
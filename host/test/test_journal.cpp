@@ -0,0 +1,95 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "journal.hpp"
+
+#define TAG "test"
+
+static std::string line(uint32_t sequence) {
+    journal_entry_t entry;
+    if (!Journal::read(sequence, entry)) {
+        return "<missing>";
+    }
+    char buffer[JOURNAL_LINE_LENGTH];
+    Journal::render(entry, buffer, sizeof(buffer));
+    std::string text(buffer);
+    return text.substr(text.find(' ', text.find(' ') + 1) + 1);
+}
+
+static void test_formatting() {
+    Journal::init();
+    uint32_t head = Journal::head();
+    int64_t big = -5000000000LL;
+    JOURNAL_LOGI(TAG, "int %d unsigned %u hex %04x", -42, 42u, 0xbeef);
+    JOURNAL_LOGW(TAG, "long %lld char %c 100%%", big, 'x');
+    JOURNAL_LOGD(TAG, "float %.2f pointer %s", 3.14159, "ok");
+    JOURNAL_LOGE(TAG, "missing %d %d", 1);
+    CHECK_EQ(Journal::head(), head + 4);
+    CHECK_EQ(line(head), "I test: int -42 unsigned 42 hex beef");
+    CHECK_EQ(line(head + 1), "W test: long -5000000000 char x 100%");
+    CHECK_EQ(line(head + 2), "D test: float 3.14 pointer ok");
+    CHECK_EQ(line(head + 3), "E test: missing 1 ?");
+}
+
+static void test_strings_copied() {
+    uint32_t head = Journal::head();
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "first");
+    JOURNAL_LOGI(TAG, "'%s' and '%s'", buffer, "second");
+    snprintf(buffer, sizeof(buffer), "changed");
+    CHECK_EQ(line(head), "I test: 'first' and 'second'");
+
+    std::string long_text(40, 'a');
+    JOURNAL_LOGI(TAG, "%s|%s", long_text.c_str(), "gone");
+    CHECK_EQ(line(head + 1), "I test: " + std::string(JOURNAL_TEXT_LENGTH - 1, 'a') + "|");
+}
+
+static void test_wraparound() {
+    uint32_t head = Journal::head();
+    for (int i = 0; i < JOURNAL_CAPACITY + 5; i++) {
+        JOURNAL_LOGD(TAG, "entry %d", i);
+    }
+    CHECK_EQ(line(head), "<missing>");
+    CHECK_EQ(line(head + 5), "D test: entry 5");
+    CHECK_EQ(line(head + JOURNAL_CAPACITY + 4), "D test: entry 52");
+}
+
+static void test_retention() {
+    JOURNAL_LOGI(TAG, "before reset");
+    uint32_t head = Journal::head();
+    Journal::init();
+    CHECK_EQ(line(head - 1), "I test: before reset");
+    CHECK_EQ(Journal::head(), head + 1);
+
+    host_set_image("fedcba9876543210fedcba9876543210");
+    Journal::init();
+    CHECK_EQ(Journal::head(), (uint32_t)1);
+    CHECK_EQ(line(head - 1), "<missing>");
+}
+
+static void test_export() {
+    host_set_image("00000000000000000000000000000000");
+    Journal::init();
+    for (int i = 0; i < 20; i++) {
+        JOURNAL_LOGI(TAG, "exported line number %d with some padding", i);
+    }
+    httpd_req_t request = host_request("");
+    CHECK_EQ(Journal::export_text(&request, 0), ESP_OK);
+    CHECK(request.complete);
+    CHECK(request.chunks > 2);
+    CHECK(request.response.find("Started with an empty journal.") != std::string::npos);
+    CHECK(request.response.find("exported line number 19 with some padding\n") != std::string::npos);
+
+    httpd_req_t recent = host_request("");
+    Journal::export_text(&recent, Journal::head() - 1);
+    CHECK(recent.response.find("number 19") != std::string::npos);
+    CHECK(recent.response.find("number 18") == std::string::npos);
+}
+
+int main() {
+    RUN(test_formatting);
+    RUN(test_strings_copied);
+    RUN(test_wraparound);
+    RUN(test_retention);
+    RUN(test_export);
+    return test_failures;
+}
@@ -0,0 +1,81 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "json.hpp"
+
+#include <cstring>
+
+static void test_pretty_nested() {
+    char buffer[256];
+    JSON json(buffer, sizeof(buffer));
+    json.add_bool("success", true)
+        .begin_object("network")
+            .add_string("ssid", "Office")
+            .add_int("security", 3)
+        .end_object()
+        .finalize();
+    CHECK(json.ok());
+    CHECK_EQ(std::string(json.c_str()),
+        std::string("{\n\t\"success\": true,\n\t\"network\": {\n\t\t\"ssid\": \"Office\",\n"
+                    "\t\t\"security\": 3\n\t}\n}"));
+    CHECK_EQ(json.length(), strlen(json.c_str()));
+}
+
+static void test_compact() {
+    char buffer[64];
+    JSON json(buffer, sizeof(buffer), false);
+    json.add_int("a", -1).begin_object("b").end_object().add_double("c", 0.5).finalize();
+    CHECK_EQ(std::string(json.c_str()), std::string("{\"a\":-1,\"b\":{},\"c\":0.500000}"));
+    JSON unsigned_json(buffer, sizeof(buffer), false);
+    unsigned_json.add_uint("u", 4000000000u).finalize();
+    CHECK_EQ(std::string(unsigned_json.c_str()), std::string("{\"u\":4000000000}"));
+}
+
+static void test_escape() {
+    char buffer[64];
+    JSON json(buffer, sizeof(buffer), false);
+    json.add_string("k\"", "a\\b\n\x01").finalize();
+    CHECK_EQ(std::string(json.c_str()), std::string("{\"k\\\"\":\"a\\\\b\\n\\u0001\"}"));
+}
+
+static void test_non_finite() {
+    char buffer[32];
+    JSON json(buffer, sizeof(buffer), false);
+    json.add_double("nan", 0.0 / 0.0).finalize();
+    CHECK_EQ(std::string(json.c_str()), std::string("{\"nan\":null}"));
+}
+
+static void test_overflow() {
+    char buffer[8];
+    JSON json(buffer, sizeof(buffer));
+    CHECK(!json.add_string("key", "value").finalize());
+    CHECK(json.c_str() == nullptr);
+}
+
+static void test_depth_limit() {
+    char buffer[512];
+    JSON json(buffer, sizeof(buffer), false);
+    for (int i = 0; i < JSON_MAX_DEPTH; i++) {
+        json.begin_object("o");
+    }
+    CHECK(!json.finalize());
+}
+
+static void test_streaming() {
+    httpd_req_t request = host_request("");
+    std::string message(3 * JSON_CHUNK_SIZE, 'x');
+    CHECK(JSON::simple_response(&request, true, message));
+    CHECK(request.complete);
+    CHECK(request.chunks >= 3);
+    CHECK_EQ(request.response, "{\n\t\"success\": true,\n\t\"message\": \"" + message + "\"\n}");
+}
+
+int main() {
+    RUN(test_pretty_nested);
+    RUN(test_compact);
+    RUN(test_escape);
+    RUN(test_non_finite);
+    RUN(test_overflow);
+    RUN(test_depth_limit);
+    RUN(test_streaming);
+    return test_failures;
+}
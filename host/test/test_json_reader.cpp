@@ -0,0 +1,136 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "json_reader.hpp"
+#include "commands.hpp"
+#include "query.hpp"
+
+#include <cstring>
+
+struct Parsed {
+    char buffer[JSON_READER_MAX_LENGTH];
+    JSONReader reader;
+    Parsed(const char* text) : reader((strcpy(buffer, text), buffer), strlen(text)) {}
+};
+
+static void test_tokens() {
+    Parsed parsed(" {\"ssid\": \"Office\", \"channel\": 6, \"fast\": true, \"ip\": null,"
+                  " \"nested\": {\"list\": [1, 2, [3]]}, \"last\": -12} ");
+    const JSONReader& reader = parsed.reader;
+    CHECK(reader.ok());
+    CHECK_EQ(reader.token(JSON_READER_ROOT).type, JSON_TOKEN_OBJECT);
+    CHECK_EQ(reader.token(JSON_READER_ROOT).size, 6);
+    CHECK_EQ(reader.token(JSON_READER_ROOT).next, reader.size());
+
+    std::string_view ssid;
+    int64_t last = 0;
+    uint32_t channel = 0;
+    bool fast = false;
+    CHECK(reader.get_string(JSON_READER_ROOT, "ssid", ssid) && ssid == "Office");
+    CHECK(reader.get_uint(JSON_READER_ROOT, "channel", channel) && channel == 6);
+    CHECK(reader.get_bool(JSON_READER_ROOT, "fast", fast) && fast);
+    CHECK(reader.get_int(JSON_READER_ROOT, "last", last) && last == -12);
+    CHECK(!reader.get_uint(JSON_READER_ROOT, "last", channel));
+    CHECK(!reader.get_string(JSON_READER_ROOT, "channel", ssid));
+    CHECK_EQ(reader.token(reader.find(JSON_READER_ROOT, "ip")).type, JSON_TOKEN_NULL);
+
+    int nested = reader.find(JSON_READER_ROOT, "nested");
+    int list = reader.find(nested, "list");
+    CHECK_EQ(reader.token(list).type, JSON_TOKEN_ARRAY);
+    CHECK_EQ(reader.token(list).size, 3);
+    CHECK_EQ(reader.view(list), "[1, 2, [3]]");
+    CHECK_EQ(reader.find(JSON_READER_ROOT, "list"), -1);
+}
+
+static void test_escapes_in_place() {
+    Parsed parsed("{\"psk\": \"a\\\"b\\\\c\\/d\\n\\u00e9\\u20ac\\ud83d\\ude00\"}");
+    std::string_view psk;
+    CHECK(parsed.reader.ok());
+    CHECK(parsed.reader.get_string(JSON_READER_ROOT, "psk", psk));
+    CHECK_EQ(psk, "a\"b\\c/d\n\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+}
+
+static void test_malformed() {
+    const char* inputs[] = {
+        "", "{", "{\"a\"}", "{\"a\":}", "{\"a\":1,}", "[1 2]", "{a:1}", "01", "1.", "-", "tru",
+        "\"open", "\"bad\\x\"", "\"\\ud800\"", "\"\\udc00\"", "\"tab\there\"", "{} {}", "1e",
+    };
+    for (const char* input : inputs) {
+        Parsed parsed(input);
+        if (parsed.reader.ok()) {
+            fprintf(stderr, "accepted: %s\n", input);
+        }
+        CHECK_EQ(parsed.reader.status(), JSON_READ_ERR_MALFORMED);
+        CHECK_EQ(parsed.reader.size(), (size_t)0);
+    }
+    Parsed number("-0.5e+3");
+    CHECK(number.reader.ok());
+}
+
+static void test_limits() {
+    std::string deep(JSON_READER_MAX_DEPTH, '[');
+    deep += std::string(JSON_READER_MAX_DEPTH, ']');
+    CHECK(Parsed(deep.c_str()).reader.ok());
+    std::string deeper = "[" + deep + "]";
+    CHECK_EQ(Parsed(deeper.c_str()).reader.status(), JSON_READ_ERR_TOO_DEEP);
+
+    std::string many = "[";
+    for (int i = 0; i < JSON_READER_MAX_TOKENS; i++) {
+        many += (i ? ",1" : "1");
+    }
+    many += "]";
+    CHECK_EQ(Parsed(many.c_str()).reader.status(), JSON_READ_ERR_TOO_MANY_TOKENS);
+}
+
+static void test_query_from_json() {
+    char body[] = "{\"type\": \"brew\", \"cups\": 2, \"loud\": false, \"extra\": {\"x\": 1}, \"note\": \"a&b\"}";
+    Query query("source=url");
+    CHECK(query.parse_json(body, strlen(body)));
+    CHECK_EQ(query.size(), (size_t)5);
+    CHECK_EQ(query.get("type"), "brew");
+    CHECK_EQ(query.get("cups"), "2");
+    CHECK_EQ(query.get("loud"), "false");
+    CHECK_EQ(query.get("note"), "a&b");
+    CHECK(!query.has("extra"));
+    CHECK_EQ(query.get("source"), "url");
+
+    char array[] = "[1, 2]";
+    CHECK(!Query("").parse_json(array, strlen(array)));
+}
+
+static esp_err_t echo_command(httpd_req_t* request, Query& query) {
+    std::string text = std::string(query.get("cups")) + "/" + std::string(query.get("state"));
+    httpd_resp_send(request, text.c_str(), text.length());
+    return ESP_OK;
+}
+
+static const command_t commands[] = {
+    { "echo", echo_command, COMMAND_POST, { "cups" } },
+};
+
+static void test_command_body() {
+    Commands::add(commands, 1);
+    httpd_req_t request = host_request("state=on", "{\"type\": \"echo\", \"cups\": 1}");
+    request.headers["Content-Type"] = "application/json";
+    CHECK_EQ(Commands::dispatch(&request), ESP_OK);
+    CHECK_EQ(request.response, "1/on");
+
+    httpd_req_t broken = host_request("", "{\"type\": \"echo\", ");
+    broken.headers["Content-Type"] = "application/json; charset=utf-8";
+    Commands::dispatch(&broken);
+    CHECK(broken.response.find("Malformed JSON!") != std::string::npos);
+
+    httpd_req_t large = host_request("", std::string(COMMANDS_BODY_SIZE + 1, ' '));
+    large.headers["Content-Type"] = "application/json";
+    Commands::dispatch(&large);
+    CHECK(large.response.find("too large") != std::string::npos);
+}
+
+int main() {
+    RUN(test_tokens);
+    RUN(test_escapes_in_place);
+    RUN(test_malformed);
+    RUN(test_limits);
+    RUN(test_query_from_json);
+    RUN(test_command_body);
+    return test_failures;
+}
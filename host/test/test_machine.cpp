@@ -0,0 +1,143 @@
+#include "test.hpp"
+#include "machine.hpp"
+
+#include <vector>
+
+// Simulated Senseo: records emulated presses and lets the test advance
+// time and toggle the sense lines.
+class SimHal : public IOHal {
+public:
+    int64_t time = 0;
+    int64_t busy_until = 0;
+    std::vector<uint8_t> presses;
+
+    int64_t now() override {
+        return this->time;
+    }
+
+    bool press(uint8_t buttons, uint32_t duration_us) override {
+        if (this->time < this->busy_until) {
+            return false;
+        }
+        this->presses.push_back(buttons);
+        this->busy_until = this->time + duration_us;
+        return true;
+    }
+
+    void advance(int64_t us) {
+        this->time += us;
+    }
+};
+
+static io_event_t sense(io_event_type_t type, bool level, int64_t timestamp) {
+    return { type, 0, level, timestamp };
+}
+
+static io_event_t button(io_button_t button, int64_t timestamp) {
+    return { IO_EVENT_BUTTON, (uint8_t)button, true, timestamp };
+}
+
+static void test_brew_cycle() {
+    SimHal hal;
+    Machine machine(hal);
+    CHECK(machine.command(MACHINE_POWER_ON));
+    CHECK_EQ(machine.get_state(), MACHINE_HEATING);
+    CHECK_EQ(hal.presses.back(), IO_BUTTON_MASK(IO_BUTTON_POWER));
+    machine.handle(sense(IO_EVENT_HEATER, true, hal.now()));
+    hal.advance(60 * 1000000LL);
+    machine.handle(sense(IO_EVENT_HEATER, false, hal.now()));
+    CHECK_EQ(machine.get_state(), MACHINE_READY);
+    CHECK(machine.command(MACHINE_BREW_TWO));
+    CHECK_EQ(machine.get_state(), MACHINE_BREWING_TWO);
+    CHECK_EQ(machine.deadline(), hal.now() + MACHINE_BREW_TWO_CUP_US);
+    hal.advance(MACHINE_BREW_TWO_CUP_US - 1);
+    CHECK(!machine.expire());
+    hal.advance(1);
+    CHECK(machine.expire());
+    CHECK_EQ(machine.get_state(), MACHINE_READY);
+}
+
+static void test_rejected_commands() {
+    SimHal hal;
+    Machine machine(hal);
+    CHECK(!machine.command(MACHINE_BREW_ONE));
+    CHECK(!machine.command(MACHINE_POWER_OFF));
+    CHECK(machine.command(MACHINE_POWER_ON));
+    CHECK(!machine.command(MACHINE_POWER_ON));
+    CHECK(!machine.command(MACHINE_DESCALE));
+    CHECK_EQ(hal.presses.size(), 1u);
+}
+
+static void test_press_in_progress() {
+    SimHal hal;
+    Machine machine(hal);
+    CHECK(machine.command(MACHINE_POWER_ON));
+    machine.handle(sense(IO_EVENT_HEATER, false, hal.now()));
+    CHECK_EQ(machine.get_state(), MACHINE_READY);
+    CHECK(!machine.command(MACHINE_BREW_ONE));
+    hal.advance(MACHINE_PRESS_US);
+    CHECK(machine.command(MACHINE_BREW_ONE));
+}
+
+static void test_front_panel() {
+    SimHal hal;
+    Machine machine(hal);
+    CHECK(machine.handle(button(IO_BUTTON_POWER, hal.now())));
+    CHECK_EQ(machine.get_state(), MACHINE_HEATING);
+    machine.handle(sense(IO_EVENT_HEATER, false, hal.now()));
+    CHECK(machine.handle(button(IO_BUTTON_ONE_CUP, hal.now())));
+    CHECK_EQ(machine.get_state(), MACHINE_BREWING_ONE);
+    CHECK(machine.handle(button(IO_BUTTON_POWER, hal.now())));
+    CHECK_EQ(machine.get_state(), MACHINE_IDLE);
+    CHECK(hal.presses.empty());
+}
+
+static void test_water_error() {
+    SimHal hal;
+    Machine machine(hal);
+    machine.command(MACHINE_POWER_ON);
+    machine.handle(sense(IO_EVENT_HEATER, false, hal.now()));
+    machine.handle(sense(IO_EVENT_WATER, false, hal.now()));
+    CHECK_EQ(machine.get_state(), MACHINE_ERROR);
+    hal.advance(MACHINE_PRESS_US);
+    CHECK(!machine.command(MACHINE_BREW_ONE));
+    machine.handle(sense(IO_EVENT_WATER, true, hal.now()));
+    CHECK_EQ(machine.get_state(), MACHINE_READY);
+}
+
+static void test_heat_timeout() {
+    SimHal hal;
+    Machine machine(hal);
+    machine.command(MACHINE_POWER_ON);
+    machine.handle(sense(IO_EVENT_HEATER, true, hal.now()));
+    hal.advance(MACHINE_HEAT_TIMEOUT_US);
+    CHECK(machine.expire());
+    CHECK_EQ(machine.get_state(), MACHINE_ERROR);
+    CHECK_EQ(machine.deadline(), 0);
+}
+
+static void test_descale() {
+    SimHal hal;
+    Machine machine(hal);
+    machine.command(MACHINE_POWER_ON);
+    machine.handle(sense(IO_EVENT_HEATER, false, hal.now()));
+    hal.advance(MACHINE_PRESS_US);
+    CHECK(machine.command(MACHINE_DESCALE));
+    CHECK_EQ(hal.presses.back(), IO_BUTTON_MASK(IO_BUTTON_ONE_CUP) | IO_BUTTON_MASK(IO_BUTTON_TWO_CUP));
+    CHECK_EQ(hal.busy_until, hal.now() + MACHINE_DESCALE_PRESS_US);
+    machine.handle(sense(IO_EVENT_HEATER, true, hal.now()));
+    hal.advance(MACHINE_DESCALE_US);
+    machine.expire();
+    CHECK_EQ(machine.get_state(), MACHINE_HEATING);
+}
+
+int main() {
+    RUN(test_brew_cycle);
+    RUN(test_rejected_commands);
+    RUN(test_press_in_progress);
+    RUN(test_front_panel);
+    RUN(test_water_error);
+    RUN(test_heat_timeout);
+    RUN(test_descale);
+    return test_failures;
+}
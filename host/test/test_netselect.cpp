@@ -0,0 +1,140 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "netselect.hpp"
+#include "nvstorage.hpp"
+
+#include <cstring>
+
+static wifi_ap_record_t ap(const char* ssid, uint8_t id, uint8_t channel, int8_t rssi,
+                           wifi_auth_mode_t authmode = WIFI_AUTH_WPA2_PSK) {
+    wifi_ap_record_t record = {};
+    memcpy(record.bssid, "\x24\x0a\xc4\x00\x00", 5);
+    record.bssid[5] = id;
+    strncpy(reinterpret_cast<char*>(record.ssid), ssid, sizeof(record.ssid) - 1);
+    record.primary = channel;
+    record.rssi = rssi;
+    record.authmode = authmode;
+    return record;
+}
+
+// Scans recorded on the second and third floor of the office, sorted by
+// RSSI like the driver returns them.
+static const wifi_ap_record_t floor_two[] = {
+    ap("Guest", 0x10, 1, -41, WIFI_AUTH_OPEN),
+    ap("Office", 0x21, 6, -48),
+    ap("Lab", 0x31, 11, -55, WIFI_AUTH_WPA2_WPA3_PSK),
+    ap("Office", 0x22, 1, -71),
+    ap("Neighbour", 0x40, 6, -80),
+    ap("Office", 0x23, 11, -92),
+};
+
+static const wifi_ap_record_t floor_three[] = {
+    ap("Office", 0x22, 1, -52),
+    ap("Lab", 0x32, 6, -64, WIFI_AUTH_WPA2_WPA3_PSK),
+    ap("Office", 0x21, 6, -79),
+};
+
+static void setup() {
+    host_nvs_reset();
+    NVStorage::init();
+    Config::load();
+}
+
+static void test_rssi_ranking() {
+    setup();
+    CHECK(Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK));
+    Config config;
+    netselect_candidate_t candidates[NETSELECT_MAX_CANDIDATES];
+    size_t count = NetSelect::rank(config, floor_two, 6, candidates, NETSELECT_MAX_CANDIDATES);
+    // The access point below NETSELECT_MIN_RSSI is not a candidate.
+    CHECK_EQ(count, 2u);
+    CHECK_EQ(candidates[0].record, 1);
+    CHECK_EQ(candidates[1].record, 3);
+    CHECK_EQ(candidates[0].score, -48);
+
+    count = NetSelect::rank(config, floor_three, 3, candidates, NETSELECT_MAX_CANDIDATES);
+    CHECK_EQ(count, 2u);
+    CHECK_EQ(floor_three[candidates[0].record].bssid[5], 0x22);
+}
+
+static void test_priority() {
+    setup();
+    CHECK(Config().set_network("Lab", "bench", WIFI_AUTH_WPA2_PSK, 0));
+    CHECK(Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK, 0));
+    Config config;
+    netselect_candidate_t candidates[NETSELECT_MAX_CANDIDATES];
+    size_t count = NetSelect::rank(config, floor_two, 6, candidates, NETSELECT_MAX_CANDIDATES);
+    CHECK_EQ(count, 3u);
+    CHECK_EQ(candidates[0].record, 1);
+    CHECK_EQ(candidates[1].record, 2);
+
+    // Two priority steps outweigh the 7 dB the lab access point is behind.
+    CHECK(Config().set_network("Lab", "bench", WIFI_AUTH_WPA2_PSK, 2));
+    config = Config();
+    count = NetSelect::rank(config, floor_two, 6, candidates, NETSELECT_MAX_CANDIDATES);
+    CHECK_EQ(candidates[0].record, 2);
+    CHECK_EQ(config.get_profile(candidates[0].profile).priority, 2);
+    CHECK_EQ(candidates[0].score, -55 + 2 * NETSELECT_PRIORITY_WEIGHT);
+}
+
+static void test_security() {
+    setup();
+    CHECK(Config().set_network("Guest", "secret", WIFI_AUTH_WPA_PSK));
+    CHECK(Config().set_network("Lab", "bench", WIFI_AUTH_WPA3_PSK));
+    Config config;
+    netselect_candidate_t candidates[NETSELECT_MAX_CANDIDATES];
+    // An open network never matches a profile with a PSK, and the WPA3
+    // profile accepts the transition-mode lab access point.
+    size_t count = NetSelect::rank(config, floor_two, 6, candidates, NETSELECT_MAX_CANDIDATES);
+    CHECK_EQ(count, 1u);
+    CHECK_EQ(candidates[0].record, 2);
+
+    config_profile_t profile = config.get_profile(0);
+    CHECK(!NetSelect::compatible(profile, WIFI_AUTH_WPA2_PSK));
+    CHECK(!NetSelect::compatible(profile, WIFI_AUTH_WPA2_ENTERPRISE));
+    profile.psk[0] = '\0';
+    CHECK(NetSelect::compatible(profile, WIFI_AUTH_OPEN));
+    CHECK(!NetSelect::compatible(profile, WIFI_AUTH_WPA3_PSK));
+}
+
+static void test_capacity() {
+    setup();
+    CHECK(Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK));
+    Config config;
+    netselect_candidate_t candidates[1];
+    CHECK_EQ(NetSelect::rank(config, floor_two, 6, candidates, 1), 1u);
+    CHECK_EQ(candidates[0].record, 1);
+    CHECK_EQ(NetSelect::rank(config, floor_two, 6, candidates, 0), 0u);
+    CHECK_EQ(NetSelect::rank(Config(), floor_two, 0, candidates, 1), 0u);
+}
+
+static void test_roaming() {
+    setup();
+    CHECK(Config().set_network("Office", "secret", WIFI_AUTH_WPA2_PSK));
+    Config config;
+    netselect_candidate_t candidates[NETSELECT_MAX_CANDIDATES];
+
+    // Walked upstairs while still associated to the second floor.
+    size_t count = NetSelect::rank(config, floor_three, 3, candidates, NETSELECT_MAX_CANDIDATES);
+    int target = NetSelect::roam_target(floor_two[1].bssid, -79, floor_three, candidates, count);
+    CHECK_EQ(target, 0);
+    CHECK_EQ(floor_three[candidates[target].record].bssid[5], 0x22);
+
+    // Already on the best access point.
+    CHECK_EQ(NetSelect::roam_target(floor_three[0].bssid, -52, floor_three, candidates, count), -1);
+
+    // Within the hysteresis the station stays put.
+    CHECK_EQ(NetSelect::roam_target(floor_two[1].bssid, -52 - NETSELECT_ROAM_HYSTERESIS + 1,
+        floor_three, candidates, count), -1);
+    CHECK_EQ(NetSelect::roam_target(floor_two[1].bssid, -52 - NETSELECT_ROAM_HYSTERESIS,
+        floor_three, candidates, count), 0);
+}
+
+int main() {
+    RUN(test_rssi_ranking);
+    RUN(test_priority);
+    RUN(test_security);
+    RUN(test_capacity);
+    RUN(test_roaming);
+    return test_failures;
+}
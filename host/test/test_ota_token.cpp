@@ -0,0 +1,79 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "ota_token.hpp"
+#include "commands.hpp"
+#include "nvstorage.hpp"
+
+#include <string>
+
+#define TOKEN       "0123456789abcdef"
+#define NEW_TOKEN   "fedcba9876543210"
+
+static void setup() {
+    host_nvs_reset();
+    NVStorage::init();
+}
+
+static httpd_req_t post(std::string query) {
+    httpd_req_t request = host_request(std::move(query));
+    request.method = HTTP_POST;
+    return request;
+}
+
+static bool upload_allowed(const char* token) {
+    httpd_req_t request = host_request("");
+    if (token != nullptr) {
+        request.headers[OTA_TOKEN_HEADER] = token;
+    }
+    return OtaToken::authorized(&request);
+}
+
+// A new or reset unit has no "ota" namespace yet.
+static void test_no_token() {
+    setup();
+    CHECK(!upload_allowed(nullptr));
+    CHECK(!upload_allowed(""));
+    CHECK(!upload_allowed(TOKEN));
+
+    httpd_req_t first = post("type=ota_token&token=" TOKEN);
+    CHECK_EQ(Commands::dispatch(&first), ESP_OK);
+    CHECK(first.response.find("Update token set.") != std::string::npos);
+    CHECK(upload_allowed(TOKEN));
+    CHECK(!upload_allowed(NEW_TOKEN));
+}
+
+static void test_change_token() {
+    setup();
+    httpd_req_t first = post("type=ota_token&token=" TOKEN);
+    Commands::dispatch(&first);
+
+    httpd_req_t anonymous = post("type=ota_token&token=" NEW_TOKEN);
+    Commands::dispatch(&anonymous);
+    CHECK_EQ(anonymous.status, "401 Unauthorized");
+    httpd_req_t wrong = post("type=ota_token&token=" NEW_TOKEN "&current=" NEW_TOKEN);
+    Commands::dispatch(&wrong);
+    CHECK_EQ(wrong.status, "401 Unauthorized");
+    CHECK(upload_allowed(TOKEN));
+
+    httpd_req_t changed = post("type=ota_token&token=" NEW_TOKEN "&current=" TOKEN);
+    Commands::dispatch(&changed);
+    CHECK(changed.response.find("Update token set.") != std::string::npos);
+    CHECK(upload_allowed(NEW_TOKEN));
+    CHECK(!upload_allowed(TOKEN));
+}
+
+static void test_length() {
+    setup();
+    httpd_req_t short_token = post("type=ota_token&token=short");
+    Commands::dispatch(&short_token);
+    CHECK(short_token.response.find("16 to 64 characters") != std::string::npos);
+    CHECK(!upload_allowed("short"));
+}
+
+int main() {
+    CHECK(OtaToken::init());
+    RUN(test_no_token);
+    RUN(test_change_token);
+    RUN(test_length);
+    return test_failures;
+}
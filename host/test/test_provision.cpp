@@ -0,0 +1,223 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "provision.hpp"
+#include "cbor.hpp"
+#include "nvstorage.hpp"
+
+#include <cstring>
+
+static void setup() {
+    host_nvs_reset();
+    NVStorage::init();
+    Config::load();
+}
+
+static scheduler_table_t sample_table() {
+    scheduler_table_t table = {};
+    table.auto_off_minutes = 30;
+    table.entries[0] = { SCHEDULE_BREW_ONE, SCHEDULE_WEEKDAYS, 6, 45 };
+    table.entries[3] = { SCHEDULE_POWER_OFF, SCHEDULE_DAILY, 22, 0 };
+    return table;
+}
+
+static void test_round_trip() {
+    setup();
+    CHECK(Config().set_network("Lab", "bench", WIFI_AUTH_WPA3_PSK, 4));
+    CHECK(Config().set_network("Office", "correct horse battery staple", WIFI_AUTH_WPA2_PSK));
+    scheduler_table_t table = sample_table();
+
+    uint8_t buffer[PROVISION_MAX_LENGTH];
+    size_t length = Provision::write(Config(), table, buffer, sizeof(buffer));
+    CHECK(length > 0);
+    // Two profiles and two schedules fit in well under a hundred bytes.
+    CHECK(length < 100);
+
+    provision_document_t document;
+    CHECK_EQ(Provision::read(buffer, length, document), PROVISION_OK);
+    CHECK_EQ(document.sections, (uint32_t)(PROVISION_NETWORKS | PROVISION_SCHEDULES | PROVISION_MACHINE));
+    CHECK_EQ(document.network_count, 2u);
+    CHECK(strcmp(document.networks[0].ssid, "Office") == 0);
+    CHECK(strcmp(document.networks[0].psk, "correct horse battery staple") == 0);
+    CHECK_EQ(document.networks[1].security, WIFI_AUTH_WPA3_PSK);
+    CHECK_EQ(document.networks[1].priority, 4);
+    CHECK(memcmp(&document.table, &table, sizeof(table)) == 0);
+
+    // Importing on a blank unit reproduces the exported configuration.
+    setup();
+    CHECK(Config().set_networks(document.networks, document.network_count));
+    CHECK(Config::load());
+    uint8_t copy[PROVISION_MAX_LENGTH];
+    CHECK_EQ(Provision::write(Config(), document.table, copy, sizeof(copy)), length);
+    CHECK(memcmp(copy, buffer, length) == 0);
+}
+
+static void test_maximum_size() {
+    setup();
+    char ssid[CONFIG_SSID_LENGTH + 1];
+    char psk[CONFIG_PSK_LENGTH + 1];
+    memset(psk, 'p', CONFIG_PSK_LENGTH);
+    psk[CONFIG_PSK_LENGTH] = '\0';
+    for (int i = 0; i < CONFIG_MAX_PROFILES; i++) {
+        memset(ssid, 'a' + i, CONFIG_SSID_LENGTH);
+        ssid[CONFIG_SSID_LENGTH] = '\0';
+        CHECK(Config().set_network(ssid, psk, WIFI_AUTH_WPA2_WPA3_PSK, CONFIG_MAX_PRIORITY));
+    }
+    scheduler_table_t table = {};
+    table.auto_off_minutes = SCHEDULER_MAX_AUTO_OFF;
+    for (int id = 0; id < SCHEDULER_MAX; id++) {
+        table.entries[id] = { SCHEDULE_BREW_TWO, SCHEDULE_DAILY, 23, 59 };
+    }
+    uint8_t buffer[PROVISION_MAX_LENGTH];
+    size_t length = Provision::write(Config(), table, buffer, sizeof(buffer));
+    CHECK(length > 0);
+    provision_document_t document;
+    CHECK_EQ(Provision::read(buffer, length, document), PROVISION_OK);
+    CHECK_EQ(document.network_count, (size_t)CONFIG_MAX_PROFILES);
+    CHECK_EQ(Provision::write(Config(), table, buffer, length - 1), 0u);
+}
+
+// Partial documents only carry the sections to change; unknown keys from
+// newer tools are skipped.
+static void test_partial() {
+    uint8_t buffer[64];
+    CBORWriter writer(buffer, sizeof(buffer));
+    writer.begin_map(3)
+        .add_uint(PROVISION_KEY_VERSION).add_uint(PROVISION_VERSION)
+        .add_uint(17).begin_array(2).add_text("future").add_bool(true)
+        .add_uint(PROVISION_KEY_MACHINE).begin_map(2)
+            .add_uint(PROVISION_MACHINE_AUTO_OFF).add_uint(15)
+            .add_uint(9).add_int(-3);
+    CHECK(writer.ok());
+    provision_document_t document;
+    CHECK_EQ(Provision::read(buffer, writer.length(), document), PROVISION_OK);
+    CHECK_EQ(document.sections, (uint32_t)PROVISION_MACHINE);
+    CHECK_EQ(document.table.auto_off_minutes, 15);
+}
+
+static provision_result_t read_networks(const char* ssid, const char* psk, uint64_t security, uint64_t priority, int copies = 1) {
+    uint8_t buffer[256];
+    CBORWriter writer(buffer, sizeof(buffer));
+    writer.begin_map(2)
+        .add_uint(PROVISION_KEY_VERSION).add_uint(PROVISION_VERSION)
+        .add_uint(PROVISION_KEY_NETWORKS).begin_array(copies);
+    for (int i = 0; i < copies; i++) {
+        writer.begin_array(4).add_text(ssid).add_text(psk).add_uint(security).add_uint(priority);
+    }
+    provision_document_t document;
+    return Provision::read(buffer, writer.length(), document);
+}
+
+static void test_validation() {
+    CHECK_EQ(read_networks("Office", "secret", WIFI_AUTH_WPA2_PSK, 0), PROVISION_OK);
+    CHECK_EQ(read_networks("", "secret", WIFI_AUTH_WPA2_PSK, 0), PROVISION_ERR_NETWORK);
+    CHECK_EQ(read_networks("0123456789012345678901234567890123", "secret", WIFI_AUTH_WPA2_PSK, 0), PROVISION_ERR_NETWORK);
+    CHECK_EQ(read_networks("Office", "secret", WIFI_AUTH_MAX, 0), PROVISION_ERR_NETWORK);
+    CHECK_EQ(read_networks("Office", "secret", WIFI_AUTH_WPA2_PSK, CONFIG_MAX_PRIORITY + 1), PROVISION_ERR_NETWORK);
+    CHECK_EQ(read_networks("Office", "secret", WIFI_AUTH_WPA2_PSK, 0, 2), PROVISION_ERR_NETWORK);
+    CHECK_EQ(read_networks("Office", "secret", WIFI_AUTH_WPA2_PSK, 0, 0), PROVISION_ERR_NETWORK);
+
+    uint8_t buffer[64];
+    CBORWriter schedule(buffer, sizeof(buffer));
+    schedule.begin_map(2)
+        .add_uint(PROVISION_KEY_VERSION).add_uint(PROVISION_VERSION)
+        .add_uint(PROVISION_KEY_SCHEDULES).begin_array(1)
+            .begin_array(5).add_uint(0).add_uint(SCHEDULE_BREW_ONE).add_uint(SCHEDULE_DAILY).add_uint(24).add_uint(0);
+    provision_document_t document;
+    CHECK_EQ(Provision::read(buffer, schedule.length(), document), PROVISION_ERR_SCHEDULE);
+
+    CBORWriter future(buffer, sizeof(buffer));
+    future.begin_map(1).add_uint(PROVISION_KEY_VERSION).add_uint(PROVISION_VERSION + 1);
+    CHECK_EQ(Provision::read(buffer, future.length(), document), PROVISION_ERR_VERSION);
+
+    CBORWriter unversioned(buffer, sizeof(buffer));
+    unversioned.begin_map(0);
+    CHECK_EQ(Provision::read(buffer, unversioned.length(), document), PROVISION_ERR_VERSION);
+
+    // Truncated documents and trailing garbage are malformed.
+    uint8_t exported[PROVISION_MAX_LENGTH];
+    size_t length = Provision::write(Config(), sample_table(), exported, sizeof(exported));
+    CHECK_EQ(Provision::read(exported, length - 1, document), PROVISION_ERR_MALFORMED);
+    exported[length] = 0x00;
+    CHECK_EQ(Provision::read(exported, length + 1, document), PROVISION_ERR_MALFORMED);
+    CHECK_EQ(Provision::read(reinterpret_cast<const uint8_t*>("{}"), 2, document), PROVISION_ERR_MALFORMED);
+}
+
+static void test_set_networks() {
+    setup();
+    CHECK(Config().set_network("Old", "secret", WIFI_AUTH_WPA2_PSK));
+    config_profile_t profiles[2] = {};
+    strcpy(profiles[0].ssid, "Office");
+    strcpy(profiles[0].psk, "secret");
+    profiles[0].security = WIFI_AUTH_WPA2_PSK;
+    strcpy(profiles[1].ssid, "Office");
+    CHECK(!Config().set_networks(profiles, 2));
+    CHECK(!Config().set_networks(profiles, 0));
+    strcpy(profiles[1].ssid, "Lab");
+    size_t writes = host_nvs_stats().writes;
+    CHECK(Config().set_networks(profiles, 2));
+    CHECK_EQ(host_nvs_stats().writes - writes, 1u);
+    CHECK(Config::load());
+    CHECK_EQ(Config().profile_count(), 2u);
+    CHECK(Config().find_profile("Old") == nullptr);
+}
+
+// An import cut short after staging is finished from the staged copy,
+// which boot reads once and hands to Config and the scheduler.
+static void test_staged_import() {
+    setup();
+    CHECK(Config().set_network("Old", "secret", WIFI_AUTH_WPA2_PSK));
+    provision_document_t document;
+    CHECK(!Provision::staged(document));
+    // Looking for a staged import does not create its namespace.
+    bool created = true;
+    try {
+        NVStorage storage(PROVISION_NAMESPACE, false);
+    } catch (int error) {
+        created = false;
+    }
+    CHECK(!created);
+
+    CHECK(Config().set_network("Office", "correct horse battery staple", WIFI_AUTH_WPA2_PSK));
+    uint8_t buffer[PROVISION_MAX_LENGTH];
+    size_t length = Provision::write(Config(), sample_table(), buffer, sizeof(buffer));
+    setup();
+    CHECK(Config().set_network("Old", "secret", WIFI_AUTH_WPA2_PSK));
+    CHECK(Provision::stage(buffer, length));
+    CHECK(Config::load());
+    CHECK(Config().get_ssid() == "Old");
+
+    CHECK(Provision::staged(document));
+    CHECK(Config().set_networks(document.networks, document.network_count));
+    scheduler_table_t table = {};
+    Provision::merge(document, table);
+    CHECK(memcmp(&table, &document.table, sizeof(table)) == 0);
+    CHECK(Provision::clear());
+    CHECK(!Provision::staged(document));
+    CHECK(Config::load());
+    CHECK_EQ(Config().profile_count(), 2u);
+    CHECK(Config().get_ssid() == "Office");
+}
+
+// Sections missing from the document leave the table alone.
+static void test_merge() {
+    provision_document_t document = {};
+    document.sections = PROVISION_MACHINE;
+    document.table = sample_table();
+    scheduler_table_t table = {};
+    table.entries[1] = { SCHEDULE_POWER_ON, SCHEDULE_DAILY, 7, 0 };
+    Provision::merge(document, table);
+    CHECK_EQ(table.auto_off_minutes, 30);
+    CHECK_EQ(table.entries[0].days, 0);
+    CHECK_EQ(table.entries[1].hour, 7);
+}
+
+int main() {
+    RUN(test_round_trip);
+    RUN(test_maximum_size);
+    RUN(test_partial);
+    RUN(test_validation);
+    RUN(test_set_networks);
+    RUN(test_staged_import);
+    RUN(test_merge);
+    return test_failures;
+}
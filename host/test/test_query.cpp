@@ -0,0 +1,76 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "query.hpp"
+
+static void test_lookup() {
+    Query query("type=network&ssid=Office&psk=secret");
+    CHECK_EQ(query.size(), 3u);
+    CHECK(query.get("type") == "network");
+    CHECK(query.get("ssid") == "Office");
+    CHECK(query.get("psk") == "secret");
+    CHECK(query.get("missing").empty());
+}
+
+static void test_exact_keys() {
+    Query query("ssid=Office");
+    CHECK(!query.has("sid"));
+    CHECK(query.get("sid").empty());
+}
+
+static void test_decode() {
+    Query query("ssid=My+Net%21&psk=a%26b%3Dc");
+    CHECK(query.get("ssid") == "My Net!");
+    CHECK(query.get("psk") == "a&b=c");
+}
+
+static void test_malformed_escape() {
+    Query query("a=%zz&b=%4&c=ok");
+    CHECK(!query.has("a"));
+    CHECK(!query.has("b"));
+    CHECK(query.get("c") == "ok");
+}
+
+static void test_flags_and_empty() {
+    Query query("&flag&=x&empty=");
+    CHECK(query.has("flag"));
+    CHECK(query.has("empty"));
+    CHECK(query.get("empty").empty());
+}
+
+static void test_hex() {
+    char out;
+    CHECK(Query::decode_hex('4', 'f', out) && out == 'O');
+    CHECK(Query::decode_hex('F', 'F', out) && out == '\xff');
+    CHECK(!Query::decode_hex('g', '0', out));
+}
+
+static void test_uint() {
+    Query query("a=42&b=4294967295&c=4294967296&d=-1&e=");
+    uint32_t value = 0;
+    CHECK(query.get_uint("a", value) && value == 42);
+    CHECK(query.get_uint("b", value) && value == UINT32_MAX);
+    CHECK(!query.get_uint("c", value));
+    CHECK(!query.get_uint("d", value));
+    CHECK(!query.get_uint("e", value));
+    CHECK(!query.get_uint("f", value));
+}
+
+static void test_request() {
+    httpd_req_t request = host_request("type=reboot");
+    Query query(&request);
+    CHECK(query.get("type") == "reboot");
+    httpd_req_t oversized = host_request("type=" + std::string(QUERY_MAX_LENGTH, 'x'));
+    CHECK_EQ(Query(&oversized).size(), 0u);
+}
+
+int main() {
+    RUN(test_lookup);
+    RUN(test_exact_keys);
+    RUN(test_decode);
+    RUN(test_malformed_escape);
+    RUN(test_flags_and_empty);
+    RUN(test_hex);
+    RUN(test_uint);
+    RUN(test_request);
+    return test_failures;
+}
@@ -0,0 +1,68 @@
+#include "test.hpp"
+#include "ring.hpp"
+
+#include <thread>
+
+static void test_fifo_and_overrun() {
+    Ring<int, 4> ring;
+    for (int i = 0; i < 4; i++) {
+        CHECK(ring.push(i));
+    }
+    CHECK(!ring.push(4));
+    CHECK_EQ(ring.overrun_count(), 1u);
+    CHECK_EQ(ring.size(), 4u);
+    CHECK_EQ(ring.at(0), 0);
+    CHECK_EQ(ring.at(3), 3);
+    ring.pop(2);
+    CHECK(ring.push(5));
+    CHECK_EQ(ring.at(0), 2);
+    CHECK_EQ(ring.at(2), 5);
+}
+
+static void test_span_wraps() {
+    Ring<int, 4> ring;
+    for (int i = 0; i < 3; i++) {
+        ring.push(i);
+    }
+    ring.pop(3);
+    for (int i = 0; i < 4; i++) {
+        ring.push(10 + i);
+    }
+    CHECK_EQ(ring.span(0, 4), 1u);
+    CHECK_EQ(ring.span(1, 3), 3u);
+    CHECK_EQ((&ring.at(1))[2], 13);
+}
+
+static void test_concurrent() {
+    Ring<uint32_t, 64> ring;
+    const uint32_t total = 200000;
+    std::thread producer([&ring, total] {
+        for (uint32_t i = 0; i < total; i++) {
+            while (!ring.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t expected = 0;
+    bool ordered = true;
+    while (expected < total) {
+        size_t available = ring.size();
+        if (available == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < available; i++) {
+            ordered &= (ring.at(i) == expected++);
+        }
+        ring.pop(available);
+    }
+    producer.join();
+    CHECK(ordered);
+}
+
+int main() {
+    RUN(test_fifo_and_overrun);
+    RUN(test_span_wraps);
+    RUN(test_concurrent);
+    return test_failures;
+}
@@ -0,0 +1,95 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "schedule.hpp"
+#include "nvstorage.hpp"
+
+#include <cstring>
+
+static struct tm at(int wday, int hour, int minute, int second = 0) {
+    struct tm time = {};
+    time.tm_wday = wday;
+    time.tm_hour = hour;
+    time.tm_min = minute;
+    time.tm_sec = second;
+    return time;
+}
+
+static void test_parsing() {
+    uint8_t days = 0;
+    CHECK(Schedule::parse_days("weekdays", days) && days == SCHEDULE_WEEKDAYS);
+    CHECK(Schedule::parse_days("sat,sun", days) && days == SCHEDULE_WEEKENDS);
+    CHECK(Schedule::parse_days("mon", days) && days == 0x02);
+    CHECK(!Schedule::parse_days("mon,funday", days));
+    CHECK(!Schedule::parse_days("", days));
+
+    uint8_t hour = 0, minute = 0;
+    CHECK(Schedule::parse_time("06:45", hour, minute) && hour == 6 && minute == 45);
+    CHECK(!Schedule::parse_time("24:00", hour, minute));
+    CHECK(!Schedule::parse_time("6:45", hour, minute));
+    CHECK(!Schedule::parse_time("06:4x", hour, minute));
+
+    schedule_action_t action;
+    CHECK(Schedule::parse_action("brew2", action) && action == SCHEDULE_BREW_TWO);
+    CHECK(!Schedule::parse_action("espresso", action));
+    CHECK_EQ(Schedule::command(SCHEDULE_BREW_ONE), MACHINE_BREW_ONE);
+}
+
+static void test_next_occurrence() {
+    schedule_t weekdays = { SCHEDULE_BREW_ONE, SCHEDULE_WEEKDAYS, 6, 45 };
+    // Monday 06:00 -> same morning.
+    CHECK_EQ(Schedule::seconds_until(weekdays, at(1, 6, 0)), 45u * 60);
+    // Monday 06:45 exactly -> Tuesday.
+    CHECK_EQ(Schedule::seconds_until(weekdays, at(1, 6, 45)), 86400u);
+    // Friday 07:00 -> Monday.
+    CHECK_EQ(Schedule::seconds_until(weekdays, at(5, 7, 0)), 3u * 86400 - 15 * 60);
+    // Saturday 23:59:30 -> Monday.
+    CHECK_EQ(Schedule::seconds_until(weekdays, at(6, 23, 59, 30)), 30u + 86400 + 6 * 3600 + 45 * 60);
+
+    schedule_t weekly = { SCHEDULE_POWER_ON, 0x08, 12, 0 };
+    // Wednesday 12:00 -> next Wednesday.
+    CHECK_EQ(Schedule::seconds_until(weekly, at(3, 12, 0)), 7u * 86400);
+}
+
+static void test_rearm_after_fire() {
+    schedule_t weekdays = { SCHEDULE_BREW_ONE, SCHEDULE_WEEKDAYS, 6, 45 };
+    // A timer that fires at 06:44:59 would match the same minute again.
+    CHECK_EQ(Schedule::seconds_until(weekdays, at(1, 6, 44, 59)), 1u);
+    // Skipping the fired occurrence -> Tuesday, early or late.
+    CHECK_EQ(Schedule::seconds_until(weekdays, at(1, 6, 44, 59), SCHEDULE_REARM_SKIP), 86400u + 1);
+    CHECK_EQ(Schedule::seconds_until(weekdays, at(1, 6, 45, 1), SCHEDULE_REARM_SKIP), 86400u - 1);
+    // Friday 06:44:59 -> Monday.
+    CHECK_EQ(Schedule::seconds_until(weekdays, at(5, 6, 44, 59), SCHEDULE_REARM_SKIP), 3u * 86400 + 1);
+
+    schedule_t weekly = { SCHEDULE_POWER_ON, 0x08, 12, 0 };
+    // Wednesday 11:59:59 -> next Wednesday.
+    CHECK_EQ(Schedule::seconds_until(weekly, at(3, 11, 59, 59), SCHEDULE_REARM_SKIP), 7u * 86400 + 1);
+    // Saturday 23:59:59 with a Sunday 00:00 schedule -> the Sunday after.
+    schedule_t midnight = { SCHEDULE_POWER_ON, 0x01, 0, 0 };
+    CHECK_EQ(Schedule::seconds_until(midnight, at(6, 23, 59, 59), SCHEDULE_REARM_SKIP), 7u * 86400 + 1);
+}
+
+// A new or erased unit has no scheduler namespace yet.
+static void test_storage() {
+    host_nvs_reset();
+    NVStorage::init();
+    scheduler_table_t table;
+    memset(&table, 0xA5, sizeof(table));
+    CHECK(!Schedule::load(table));
+    CHECK_EQ(table.auto_off_minutes, 0);
+    CHECK_EQ(table.entries[0].days, 0);
+
+    table.auto_off_minutes = 30;
+    table.entries[2] = { SCHEDULE_POWER_ON, SCHEDULE_WEEKENDS, 9, 30 };
+    CHECK(Schedule::save(table));
+    scheduler_table_t loaded;
+    CHECK(Schedule::load(loaded));
+    CHECK(memcmp(&loaded, &table, sizeof(table)) == 0);
+}
+
+int main() {
+    RUN(test_parsing);
+    RUN(test_next_occurrence);
+    RUN(test_rearm_after_fire);
+    RUN(test_storage);
+    return test_failures;
+}
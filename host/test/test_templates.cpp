@@ -0,0 +1,73 @@
+#include "test.hpp"
+#include "host.hpp"
+#include "templates.hpp"
+
+#include <string>
+
+static void fill(template_slot_t slot, TemplateWriter& writer, void* context) {
+    switch (slot) {
+        case TEMPLATE_SLOT_SSID:
+            writer.add_text((const char*)context);
+            break;
+        case TEMPLATE_SLOT_PROFILES:
+            writer.add_int(3);
+            break;
+        case TEMPLATE_SLOT_STATE:
+            writer.add_text("idle");
+            break;
+        default:
+            break;
+    }
+}
+
+static void test_lookup() {
+    CHECK(Templates::find("/index.html") != nullptr);
+    CHECK(Templates::find("/style.css") == nullptr);
+    for (size_t i = 1; i < template_count; i++) {
+        CHECK(std::string_view(templates[i - 1].path) < std::string_view(templates[i].path));
+    }
+    const template_t* page = Templates::find("/index.html");
+    CHECK(page->count > 1);
+    CHECK_EQ(page->segments[page->count - 1].slot, TEMPLATE_NO_SLOT);
+}
+
+static void test_render() {
+    const template_t* page = Templates::find("/index.html");
+    httpd_req_t request = host_get("/");
+    CHECK_EQ(Templates::render(&request, page, fill, (void*)"Home"), ESP_OK);
+    CHECK(request.complete);
+    CHECK_EQ(request.type, "text/html");
+    CHECK_EQ(request.response_headers["Cache-Control"], "no-store");
+    CHECK(request.response.find("<strong>idle</strong>") != std::string::npos);
+    CHECK(request.response.find("value=\"Home\"") != std::string::npos);
+    CHECK(request.response.find("(3 stored)") != std::string::npos);
+    CHECK(request.response.find("{{") == std::string::npos);
+    CHECK(request.response.find("</html>") != std::string::npos);
+    // Slots are coalesced with the literals around them.
+    CHECK(request.chunks < page->count);
+}
+
+static void test_escape() {
+    const template_t* page = Templates::find("/index.html");
+    httpd_req_t request = host_get("/");
+    Templates::render(&request, page, fill, (void*)"\"><script>&'");
+    CHECK(request.response.find("<script>") == std::string::npos);
+    CHECK(request.response.find("value=\"&quot;&gt;&lt;script&gt;&amp;&#39;\"") != std::string::npos);
+}
+
+static void test_long_value() {
+    const template_t* page = Templates::find("/index.html");
+    std::string ssid(3 * TEMPLATES_CHUNK_SIZE, 'x');
+    httpd_req_t request = host_get("/");
+    CHECK_EQ(Templates::render(&request, page, fill, (void*)ssid.c_str()), ESP_OK);
+    CHECK(request.response.find("value=\"" + ssid + "\"") != std::string::npos);
+    CHECK(request.complete);
+}
+
+int main() {
+    RUN(test_lookup);
+    RUN(test_render);
+    RUN(test_escape);
+    RUN(test_long_value);
+    return test_failures;
+}
@@ -0,0 +1,117 @@
+#include "test.hpp"
+#include "wheel.hpp"
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+typedef TimerWheel<4, 6> Wheel;
+
+static void test_fires_at_expiry() {
+    Wheel wheel;
+    WheelTimer near, mid, far;
+    wheel.schedule(&near, 10);
+    wheel.schedule(&mid, 1000);
+    wheel.schedule(&far, 300000);
+    CHECK_EQ(wheel.size(), (size_t)3);
+
+    std::vector<std::pair<WheelTimer*, uint32_t>> fired;
+    auto record = [&](WheelTimer* timer) { fired.push_back({ timer, wheel.now() }); };
+
+    wheel.advance(9, record);
+    CHECK(fired.empty());
+    wheel.advance(10, record);
+    CHECK_EQ(fired.size(), (size_t)1);
+    CHECK(fired[0].first == &near && fired[0].second == 10u);
+    wheel.advance(400000, record);
+    CHECK_EQ(fired.size(), (size_t)3);
+    CHECK(fired[1].first == &mid && fired[1].second == 1000u);
+    CHECK(fired[2].first == &far && fired[2].second == 300000u);
+    CHECK_EQ(wheel.size(), (size_t)0);
+    CHECK_EQ(wheel.next_event(), UINT32_MAX);
+}
+
+static void test_cancel_and_reschedule() {
+    Wheel wheel;
+    WheelTimer timer;
+    wheel.schedule(&timer, 5000);
+    wheel.cancel(&timer);
+    CHECK(!timer.pending());
+    CHECK_EQ(wheel.next_event(), UINT32_MAX);
+    wheel.schedule(&timer, 70);
+    wheel.schedule(&timer, 20);
+    CHECK_EQ(wheel.size(), (size_t)1);
+    int count = 0;
+    wheel.advance(100, [&](WheelTimer* fired) {
+        CHECK_EQ(wheel.now(), 20u);
+        count++;
+    });
+    CHECK_EQ(count, 1);
+}
+
+// Work is only done at ticks where something fires or cascades, never
+// more than once per level for a single timer.
+static void test_coalesced_wakeups() {
+    Wheel wheel;
+    WheelTimer timer;
+    wheel.schedule(&timer, 604800);
+    int wakeups = 0;
+    while (wheel.next_event() != UINT32_MAX) {
+        wheel.advance(wheel.next_event(), [](WheelTimer* fired) {});
+        wakeups++;
+    }
+    CHECK(wakeups <= 4);
+    CHECK_EQ(wheel.now(), 604800u);
+}
+
+static void test_recurring() {
+    Wheel wheel;
+    WheelTimer timer;
+    wheel.schedule(&timer, 3600);
+    std::vector<uint32_t> ticks;
+    wheel.advance(4 * 86400, [&](WheelTimer* fired) {
+        ticks.push_back(wheel.now());
+        wheel.schedule(fired, wheel.now() + 86400);
+    });
+    CHECK_EQ(ticks.size(), (size_t)4);
+    CHECK_EQ(ticks[3], 3600u + 3 * 86400);
+}
+
+static void test_randomized() {
+    Wheel wheel;
+    static WheelTimer timers[200];
+    std::multimap<uint32_t, WheelTimer*> expected;
+    srand(7);
+    uint32_t now = 0;
+    for (int round = 0; round < 20; round++) {
+        for (WheelTimer& timer : timers) {
+            if (!timer.pending() && rand() % 3 == 0) {
+                uint32_t expires = now + 1 + rand() % (rand() % 2 ? 100 : 2000000);
+                wheel.schedule(&timer, expires);
+                expected.insert({ expires, &timer });
+            }
+        }
+        now += 1 + rand() % 200000;
+        size_t fired = 0;
+        wheel.advance(now, [&](WheelTimer* timer) {
+            CHECK_EQ(timer->expires, wheel.now());
+            fired++;
+        });
+        size_t due = 0;
+        while (!expected.empty() && expected.begin()->first <= now) {
+            expected.erase(expected.begin());
+            due++;
+        }
+        CHECK_EQ(fired, due);
+        CHECK_EQ(wheel.size(), expected.size());
+    }
+}
+
+int main() {
+    RUN(test_fires_at_expiry);
+    RUN(test_cancel_and_reschedule);
+    RUN(test_coalesced_wakeups);
+    RUN(test_recurring);
+    RUN(test_randomized);
+    return test_failures;
+}
@@ -0,0 +1,143 @@
+#include "actions.hpp"
+#include "netconfig.hpp"
+#include "nvstorage.hpp"
+#include "counters.hpp"
+#include "ota.hpp"
+#include "commands.hpp"
+#include "json.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_system.h"
+#include "esp_log.h"
+
+#include <cstdio>
+
+#define LOG_TAG "actions.cpp"
+
+typedef struct {
+    action_type_t type;
+    uint32_t delay_ms;
+} action_t;
+
+static QueueHandle_t queue = NULL;
+static Interface* server = NULL;
+
+static void shutdown(action_type_t type) {
+    ESP_LOGW(LOG_TAG, "Shutdown: Running '%s'...", Actions::describe(type));
+    if (server != NULL && !server->stop_server()) {
+        ESP_LOGW(LOG_TAG, "Shutdown: Could not stop HTTP server cleanly.");
+    }
+    if (type == ACTION_REPROVISION) {
+        try {
+            NVStorage storage("config", true);
+            if (!storage.reset()) {
+                ESP_LOGE(LOG_TAG, "Shutdown: Could not clear config!");
+            }
+        } catch (int error) {
+            ESP_LOGE(LOG_TAG, "Shutdown: Unable to access NVS.");
+        }
+    }
+    if (type != ACTION_RESET && !Counters::flush()) {
+        ESP_LOGW(LOG_TAG, "Shutdown: Could not flush usage counters.");
+    }
+    // The update token survives a reset, otherwise anyone able to trigger
+    // one could set their own and flash the device.
+    if (type == ACTION_RESET && !NVStorage::erase_except(OTA_NAMESPACE)) {
+        ESP_LOGE(LOG_TAG, "Shutdown: Could not erase NVS!");
+    }
+    if (!NVStorage::deinit()) {
+        ESP_LOGW(LOG_TAG, "Shutdown: Could not deinitialize NVS.");
+    }
+    NetConfig::shutdown();
+    ESP_LOGW(LOG_TAG, "Shutdown: Restarting...");
+    esp_restart();
+}
+
+static void action_task(void* parameters) {
+    action_t action;
+    while (true) {
+        if (xQueueReceive(queue, &action, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        ESP_LOGI(LOG_TAG, "Task: '%s' due in %u ms.", Actions::describe(action.type), (unsigned)action.delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(action.delay_ms));
+        shutdown(action.type);
+    }
+}
+
+static esp_err_t action_command(httpd_req_t* request, Query& query) {
+    std::string_view type = query.get("type");
+    action_type_t action = (type == "reboot" ? ACTION_REBOOT :
+                            type == "reset" ? ACTION_RESET : ACTION_REPROVISION);
+    uint32_t delay = Actions::default_delay(action);
+    bool success = Actions::schedule(action, delay);
+    char message[64];
+    if (success) {
+        snprintf(message, sizeof(message), "Scheduled %s, going down in %u ms...",
+            Actions::describe(action), (unsigned)delay);
+    } else {
+        snprintf(message, sizeof(message), "Failed to schedule %s!", Actions::describe(action));
+    }
+    JSON::simple_response(request, query, success, message);
+    return ESP_OK;
+}
+
+static const command_t action_commands[] = {
+    { "reboot", action_command, COMMAND_GET | COMMAND_POST, {} },
+    { "reprovision", action_command, COMMAND_GET | COMMAND_POST, {} },
+    { "reset", action_command, COMMAND_GET | COMMAND_POST, {} },
+};
+
+bool Actions::init(Interface* interface) {
+    if (queue != NULL) {
+        return true;
+    }
+    server = interface;
+    queue = xQueueCreate(ACTIONS_QUEUE_LENGTH, sizeof(action_t));
+    if (queue == NULL) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create action queue!");
+        return false;
+    }
+    if (xTaskCreate(action_task, "actions", ACTIONS_TASK_STACK_SIZE, NULL, ACTIONS_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create action task!");
+        vQueueDelete(queue);
+        queue = NULL;
+        return false;
+    }
+    Commands::add(action_commands, sizeof(action_commands) / sizeof(action_commands[0]));
+    return true;
+}
+
+bool Actions::schedule(action_type_t type, uint32_t delay_ms) {
+    if (queue == NULL) {
+        ESP_LOGE(LOG_TAG, "Schedule: Action service not running!");
+        return false;
+    }
+    action_t action = { type, delay_ms };
+    return xQueueSend(queue, &action, 0) == pdTRUE;
+}
+
+bool Actions::schedule(action_type_t type) {
+    return Actions::schedule(type, Actions::default_delay(type));
+}
+
+uint32_t Actions::default_delay(action_type_t type) {
+    switch (type) {
+        case ACTION_REBOOT:         return ACTIONS_REBOOT_DELAY_MS;
+        case ACTION_RESET:          return ACTIONS_RESET_DELAY_MS;
+        case ACTION_REPROVISION:    return ACTIONS_REPROVISION_DELAY_MS;
+    }
+    return 0;
+}
+
+const char* Actions::describe(action_type_t type) {
+    switch (type) {
+        case ACTION_REBOOT:         return "reboot";
+        case ACTION_RESET:          return "reset";
+        case ACTION_REPROVISION:    return "reprovision";
+    }
+    return "unknown";
+}
@@ -0,0 +1,35 @@
+#ifndef ACTIONS_H
+#define ACTIONS_H
+
+#include "interface.hpp"
+
+#include <cstdint>
+
+#define ACTIONS_QUEUE_LENGTH            4
+#define ACTIONS_TASK_STACK_SIZE         4096
+#define ACTIONS_TASK_PRIORITY           5
+
+#define ACTIONS_REBOOT_DELAY_MS         2000
+#define ACTIONS_RESET_DELAY_MS          2000
+#define ACTIONS_REPROVISION_DELAY_MS    2000
+
+typedef enum {
+    ACTION_REBOOT,
+    ACTION_RESET,
+    ACTION_REPROVISION,
+} action_type_t;
+
+// System actions that end in a restart. They are queued to a dedicated
+// task so the HTTP handler that requested them can return immediately;
+// the task waits out the delay, stops the server, settles NVS, shuts
+// Wi-Fi down and restarts.
+class Actions {
+public:
+    static bool init(Interface* interface);
+    static bool schedule(action_type_t action, uint32_t delay_ms);
+    static bool schedule(action_type_t action);
+    static uint32_t default_delay(action_type_t action);
+    static const char* describe(action_type_t action);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "assets.hpp"
+
+#include "esp_log.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define LOG_TAG "assets.cpp"
+
+const asset_t* Assets::find(std::string_view path) {
+    size_t low = 0;
+    size_t high = asset_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        int order = path.compare(assets[middle].path);
+        if (order == 0) {
+            return &assets[middle];
+        }
+        if (order < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t Assets::serve(httpd_req_t* request, const asset_t* asset) {
+
+    httpd_resp_set_hdr(request, "ETag", asset->etag);
+    httpd_resp_set_hdr(request, "Cache-Control", ASSETS_CACHE_CONTROL);
+
+    char etag[ASSETS_ETAG_LENGTH + 1];
+    size_t length = httpd_req_get_hdr_value_len(request, "If-None-Match");
+    if (length > 0 && length < sizeof(etag) &&
+        httpd_req_get_hdr_value_str(request, "If-None-Match", etag, sizeof(etag)) == ESP_OK &&
+        strcmp(etag, asset->etag) == 0) {
+        httpd_resp_set_status(request, "304 Not Modified");
+        return httpd_resp_send(request, NULL, 0);
+    }
+
+    httpd_resp_set_type(request, asset->type);
+    httpd_resp_set_hdr(request, "Content-Encoding", "gzip");
+    for (size_t offset = 0; offset < asset->length; offset += ASSETS_CHUNK_SIZE) {
+        size_t chunk = std::min<size_t>(ASSETS_CHUNK_SIZE, asset->length - offset);
+        if (httpd_resp_send_chunk(request, (const char*)asset->data + offset, chunk) != ESP_OK) {
+            ESP_LOGW(LOG_TAG, "Serve: Sending '%s' aborted.", asset->path);
+            return ESP_FAIL;
+        }
+    }
+    return httpd_resp_send_chunk(request, NULL, 0);
+
+}
+
+// Generic GET handler for every embedded asset; '/' maps to index.html
+// and any query string is ignored.
+esp_err_t Assets::handler(httpd_req_t* request) {
+    std::string_view path(request->uri);
+    path = path.substr(0, path.find('?'));
+    if (path == "/") {
+        path = "/index.html";
+    }
+    const asset_t* asset = Assets::find(path);
+    if (asset == NULL) {
+        return httpd_resp_send_404(request);
+    }
+    return Assets::serve(request, asset);
+}
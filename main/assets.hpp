@@ -0,0 +1,34 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include "esp_http_server.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#define ASSETS_CHUNK_SIZE       1024
+#define ASSETS_ETAG_LENGTH      32
+#define ASSETS_CACHE_CONTROL    "no-cache"
+
+// Web asset compiled into flash by tools/embed_assets.py. data holds the
+// gzip-compressed content, etag is quoted and derived from its hash.
+typedef struct {
+    const char* path;
+    const char* type;
+    const uint8_t* data;
+    size_t length;
+    const char* etag;
+} asset_t;
+
+extern const asset_t assets[];
+extern const size_t asset_count;
+
+class Assets {
+public:
+    static const asset_t* find(std::string_view path);
+    static esp_err_t serve(httpd_req_t* request, const asset_t* asset);
+    static esp_err_t handler(httpd_req_t* request);
+};
+
+#endif
@@ -1,42 +1,195 @@
+#include "boot.hpp"
 #include "config.hpp"
 #include "netconfig.hpp"
 #include "interface.hpp"
 #include "nvstorage.hpp"
+#include "actions.hpp"
+#include "io.hpp"
+#include "telemetry.hpp"
+#include "commands.hpp"
+#include "journal.hpp"
+#include "scheduler.hpp"
+#include "provision.hpp"
+#include "counters.hpp"
+#include "ota.hpp"
+#include "json.hpp"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 #include "esp_spi_flash.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 
 #include "nvs_flash.h"
 
 #define LOG_TAG "boot.cpp"
 
+static int64_t timeline[BOOT_PHASE_COUNT] = {};
+
+void Boot::mark(boot_phase_t phase) {
+    timeline[phase] = esp_timer_get_time();
+    ESP_LOGI(LOG_TAG, "Boot phase '%s' reached after %lld ms.", Boot::describe(phase), timeline[phase] / 1000);
+}
+
+int64_t Boot::timestamp(boot_phase_t phase) {
+    return timeline[phase];
+}
+
+const char* Boot::describe(boot_phase_t phase) {
+    switch (phase) {
+        case BOOT_PHASE_STORAGE:        return "storage";
+        case BOOT_PHASE_NETWORK:        return "network";
+        case BOOT_PHASE_PERIPHERALS:    return "peripherals";
+        case BOOT_PHASE_ADDRESS:        return "address";
+        case BOOT_PHASE_FALLBACK:       return "fallback";
+        case BOOT_PHASE_SERVING:        return "serving";
+        case BOOT_PHASE_COUNT:          break;
+    }
+    return "unknown";
+}
+
+static esp_err_t boot_command(httpd_req_t* request, Query& query) {
+    JSON json(request, query);
+    json.add_bool("success", true)
+        .add_string("message", "Boot timeline in milliseconds since power-on.")
+        .begin_object("timeline");
+    for (int phase = 0; phase < BOOT_PHASE_COUNT; phase++) {
+        int64_t timestamp = Boot::timestamp(static_cast<boot_phase_t>(phase));
+        if (timestamp > 0) {
+            json.add_int(Boot::describe(static_cast<boot_phase_t>(phase)), timestamp / 1000);
+        }
+    }
+    json.end_object().finalize();
+    return ESP_OK;
+}
+
+static const command_t boot_commands[] = {
+    { "boot", boot_command, COMMAND_GET, {} },
+};
+
+// Boot runs as a small state machine. Wi-Fi bring-up only gets kicked
+// off, peripherals are initialized while the driver associates, and the
+// HTTP server starts as soon as either the station or the fallback AP
+// has an address.
 extern "C" void app_main(void) {
 
+    Journal::init();
     ESP_LOGW(LOG_TAG, "Controller is up!");
-    NVStorage::init();
-
-    Config config;
-    NetConfig netconfig;
-
-    if (config.uninitialized()) {
-        ESP_LOGW(LOG_TAG, "Controller needs to be configured.");
-        netconfig.publish_ap();
-    } else {
-        std::string ssid = config.get_ssid();
-        std::string psk = config.get_psk();
-        wifi_auth_mode_t security = config.get_security();
-        netconfig.connect_station(ssid, psk, security);
-    }
-    
-    Interface interface;
-    if (interface.start_server()) {
-        while (true) {
-            vTaskDelay(10000 / portTICK_PERIOD_MS);
+
+    static NetConfig netconfig;
+    static Interface interface;
+    static IO io;
+
+    Commands::add(boot_commands, sizeof(boot_commands) / sizeof(boot_commands[0]));
+
+    boot_phase_t state = BOOT_PHASE_STORAGE;
+    bool station = false;
+    // An import cut short between its writes, finished from its staged
+    // copy once Config and Scheduler have loaded their own state.
+    provision_document_t staged;
+    bool resume = false;
+
+    while (state != BOOT_PHASE_COUNT) {
+        switch (state) {
+
+            case BOOT_PHASE_STORAGE:
+                NVStorage::init();
+                for (int attempt = 1; !Config::load(); attempt++) {
+                    if (attempt == BOOT_STORAGE_ATTEMPTS) {
+                        ESP_LOGE(LOG_TAG, "Config could not be read, starting unconfigured!");
+                        break;
+                    }
+                    vTaskDelay(pdMS_TO_TICKS(BOOT_STORAGE_RETRY_MS));
+                }
+                resume = Provision::staged(staged);
+                if (resume && (staged.sections & PROVISION_NETWORKS)) {
+                    ESP_LOGW(LOG_TAG, "Applying networks of an interrupted import.");
+                    resume = Config().set_networks(staged.networks, staged.network_count);
+                }
+                Boot::mark(BOOT_PHASE_STORAGE);
+                state = BOOT_PHASE_NETWORK;
+                break;
+
+            case BOOT_PHASE_NETWORK: {
+                Config config;
+                if (config.uninitialized()) {
+                    ESP_LOGW(LOG_TAG, "Controller needs to be configured.");
+                    netconfig.publish_ap();
+                } else {
+                    station = netconfig.start_station(config);
+                    if (!station) {
+                        netconfig.publish_ap();
+                    }
+                }
+                Boot::mark(BOOT_PHASE_NETWORK);
+                state = BOOT_PHASE_PERIPHERALS;
+                break;
+            }
+
+            case BOOT_PHASE_PERIPHERALS:
+                io.init();
+                Scheduler::init();
+                if (resume && (staged.sections & (PROVISION_SCHEDULES | PROVISION_MACHINE))) {
+                    ESP_LOGW(LOG_TAG, "Applying schedules of an interrupted import.");
+                    scheduler_table_t table = Scheduler::table();
+                    Provision::merge(staged, table);
+                    resume = Scheduler::set_table(table);
+                }
+                if (resume) {
+                    Provision::clear();
+                }
+                Counters::init();
+                Telemetry::init();
+                Boot::mark(BOOT_PHASE_PERIPHERALS);
+                state = BOOT_PHASE_ADDRESS;
+                break;
+
+            case BOOT_PHASE_ADDRESS: {
+                // WIFI_FAIL_BIT stays set once the station gave up, so after
+                // falling back only an address or the started AP ends the wait.
+                uint32_t timeout = (station ? BOOT_STATION_TIMEOUT_MS : UINT32_MAX);
+                EventBits_t waited = WIFI_CONNECTED_BIT | WIFI_AP_STARTED_BIT | (station ? WIFI_FAIL_BIT : 0);
+                EventBits_t bits = NetConfig::wait(waited, timeout);
+                if (bits & (WIFI_CONNECTED_BIT | WIFI_AP_STARTED_BIT)) {
+                    Boot::mark(BOOT_PHASE_ADDRESS);
+                    state = BOOT_PHASE_SERVING;
+                } else {
+                    state = BOOT_PHASE_FALLBACK;
+                }
+                break;
+            }
+
+            case BOOT_PHASE_FALLBACK:
+                ESP_LOGW(LOG_TAG, "Station did not come up, publishing AP alongside...");
+                station = false;
+                netconfig.publish_ap();
+                Boot::mark(BOOT_PHASE_FALLBACK);
+                state = BOOT_PHASE_ADDRESS;
+                break;
+
+            case BOOT_PHASE_SERVING:
+                Ota::init();
+                if (interface.start_server()) {
+                    Actions::init(&interface);
+                    Boot::mark(BOOT_PHASE_SERVING);
+                    Ota::confirm(true);
+                } else {
+                    ESP_LOGE(LOG_TAG, "Could not start HTTP server!");
+                    Ota::confirm(false);
+                }
+                state = BOOT_PHASE_COUNT;
+                break;
+
+            case BOOT_PHASE_COUNT:
+                break;
+
         }
     }
 
-}
\ No newline at end of file
+    while (true) {
+        vTaskDelay(10000 / portTICK_PERIOD_MS);
+    }
+
+}
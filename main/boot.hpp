@@ -0,0 +1,29 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <cstdint>
+
+#define BOOT_STATION_TIMEOUT_MS 15000
+#define BOOT_STORAGE_ATTEMPTS   3
+#define BOOT_STORAGE_RETRY_MS   100
+
+typedef enum {
+    BOOT_PHASE_STORAGE,
+    BOOT_PHASE_NETWORK,
+    BOOT_PHASE_PERIPHERALS,
+    BOOT_PHASE_ADDRESS,
+    BOOT_PHASE_FALLBACK,
+    BOOT_PHASE_SERVING,
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+// Timeline of the boot sequence. Each phase records the esp_timer time
+// (microseconds since power-on) at which it was reached, 0 if it was not.
+class Boot {
+public:
+    static void mark(boot_phase_t phase);
+    static int64_t timestamp(boot_phase_t phase);
+    static const char* describe(boot_phase_t phase);
+};
+
+#endif
@@ -0,0 +1,299 @@
+#include "cbor.hpp"
+
+#include <cstring>
+
+#define CBOR_INFO_UINT8         24
+#define CBOR_INFO_UINT16        25
+#define CBOR_INFO_UINT32        26
+#define CBOR_INFO_UINT64        27
+#define CBOR_INFO_INDEFINITE    31
+#define CBOR_SIMPLE_FALSE       20
+#define CBOR_SIMPLE_TRUE        21
+
+CBORWriter::CBORWriter(uint8_t* buffer, size_t size) {
+    this->buffer = buffer;
+    this->capacity = size;
+    this->position = 0;
+    this->failed = (buffer == nullptr);
+}
+
+void CBORWriter::put(const void* data, size_t length) {
+    if (this->failed || length > this->capacity - this->position) {
+        this->failed = true;
+        return;
+    }
+    memcpy(this->buffer + this->position, data, length);
+    this->position += length;
+}
+
+// Initial byte plus the big-endian argument in the fewest bytes.
+void CBORWriter::head(uint8_t major, uint64_t value) {
+    uint8_t encoded[9];
+    size_t size;
+    if (value < CBOR_INFO_UINT8) {
+        encoded[0] = (major << 5) | value;
+        size = 0;
+    } else if (value <= UINT8_MAX) {
+        encoded[0] = (major << 5) | CBOR_INFO_UINT8;
+        size = 1;
+    } else if (value <= UINT16_MAX) {
+        encoded[0] = (major << 5) | CBOR_INFO_UINT16;
+        size = 2;
+    } else if (value <= UINT32_MAX) {
+        encoded[0] = (major << 5) | CBOR_INFO_UINT32;
+        size = 4;
+    } else {
+        encoded[0] = (major << 5) | CBOR_INFO_UINT64;
+        size = 8;
+    }
+    for (size_t i = 0; i < size; i++) {
+        encoded[size - i] = (uint8_t)(value >> (8 * i));
+    }
+    this->put(encoded, size + 1);
+}
+
+CBORWriter& CBORWriter::add_uint(uint64_t value) {
+    this->head(CBOR_MAJOR_UINT, value);
+    return *this;
+}
+
+CBORWriter& CBORWriter::add_int(int64_t value) {
+    if (value < 0) {
+        this->head(CBOR_MAJOR_NEGATIVE, (uint64_t)(-(value + 1)));
+    } else {
+        this->head(CBOR_MAJOR_UINT, (uint64_t)value);
+    }
+    return *this;
+}
+
+CBORWriter& CBORWriter::add_bool(bool value) {
+    this->head(CBOR_MAJOR_SIMPLE, value ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE);
+    return *this;
+}
+
+CBORWriter& CBORWriter::add_text(std::string_view value) {
+    this->head(CBOR_MAJOR_TEXT, value.length());
+    this->put(value.data(), value.length());
+    return *this;
+}
+
+CBORWriter& CBORWriter::add_bytes(const void* data, size_t length) {
+    this->head(CBOR_MAJOR_BYTES, length);
+    this->put(data, length);
+    return *this;
+}
+
+CBORWriter& CBORWriter::begin_array(size_t count) {
+    this->head(CBOR_MAJOR_ARRAY, count);
+    return *this;
+}
+
+CBORWriter& CBORWriter::begin_map(size_t count) {
+    this->head(CBOR_MAJOR_MAP, count);
+    return *this;
+}
+
+size_t CBORWriter::length() const {
+    return this->position;
+}
+
+bool CBORWriter::ok() const {
+    return !this->failed;
+}
+
+CBORReader::CBORReader(const uint8_t* data, size_t length) {
+    this->data = data;
+    this->length = length;
+    this->position = 0;
+    this->failed = (data == nullptr && length > 0);
+}
+
+bool CBORReader::head(uint8_t& major, uint8_t& info, uint64_t& value) {
+    if (this->failed || this->position >= this->length) {
+        this->failed = true;
+        return false;
+    }
+    uint8_t initial = this->data[this->position++];
+    major = initial >> 5;
+    info = initial & 0x1F;
+    size_t size;
+    switch (info) {
+        case CBOR_INFO_UINT8:  size = 1; break;
+        case CBOR_INFO_UINT16: size = 2; break;
+        case CBOR_INFO_UINT32: size = 4; break;
+        case CBOR_INFO_UINT64: size = 8; break;
+        default:
+            if (info > CBOR_INFO_UINT64) {
+                this->failed = true;
+                return false;
+            }
+            value = info;
+            return true;
+    }
+    if (size > this->length - this->position) {
+        this->failed = true;
+        return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < size; i++) {
+        value = (value << 8) | this->data[this->position++];
+    }
+    return true;
+}
+
+bool CBORReader::expect(uint8_t major, uint64_t& value) {
+    uint8_t actual;
+    uint8_t info;
+    if (!this->head(actual, info, value)) {
+        return false;
+    }
+    if (actual != major) {
+        this->failed = true;
+        return false;
+    }
+    return true;
+}
+
+bool CBORReader::read_uint(uint64_t& value) {
+    return this->expect(CBOR_MAJOR_UINT, value);
+}
+
+bool CBORReader::read_int(int64_t& value) {
+    uint8_t major;
+    uint8_t info;
+    uint64_t argument;
+    if (!this->head(major, info, argument)) {
+        return false;
+    }
+    if ((major != CBOR_MAJOR_UINT && major != CBOR_MAJOR_NEGATIVE) || argument > INT64_MAX) {
+        this->failed = true;
+        return false;
+    }
+    value = (major == CBOR_MAJOR_UINT ? (int64_t)argument : -1 - (int64_t)argument);
+    return true;
+}
+
+bool CBORReader::read_bool(bool& value) {
+    uint64_t simple;
+    if (!this->expect(CBOR_MAJOR_SIMPLE, simple)) {
+        return false;
+    }
+    if (simple != CBOR_SIMPLE_FALSE && simple != CBOR_SIMPLE_TRUE) {
+        this->failed = true;
+        return false;
+    }
+    value = (simple == CBOR_SIMPLE_TRUE);
+    return true;
+}
+
+bool CBORReader::read_text(std::string_view& value) {
+    uint64_t argument;
+    if (!this->expect(CBOR_MAJOR_TEXT, argument)) {
+        return false;
+    }
+    if (argument > this->length - this->position) {
+        this->failed = true;
+        return false;
+    }
+    value = std::string_view(reinterpret_cast<const char*>(this->data + this->position), argument);
+    this->position += argument;
+    return true;
+}
+
+bool CBORReader::read_bytes(const uint8_t*& data, size_t& length) {
+    uint64_t argument;
+    if (!this->expect(CBOR_MAJOR_BYTES, argument)) {
+        return false;
+    }
+    if (argument > this->length - this->position) {
+        this->failed = true;
+        return false;
+    }
+    data = this->data + this->position;
+    length = argument;
+    this->position += argument;
+    return true;
+}
+
+// Counts are bounded by the remaining input, since every element takes
+// at least one byte; callers can loop over them without further checks.
+bool CBORReader::read_array(size_t& count) {
+    uint64_t argument;
+    if (!this->expect(CBOR_MAJOR_ARRAY, argument)) {
+        return false;
+    }
+    if (argument > this->length - this->position) {
+        this->failed = true;
+        return false;
+    }
+    count = argument;
+    return true;
+}
+
+bool CBORReader::read_map(size_t& count) {
+    uint64_t argument;
+    if (!this->expect(CBOR_MAJOR_MAP, argument)) {
+        return false;
+    }
+    if (argument > (this->length - this->position) / 2) {
+        this->failed = true;
+        return false;
+    }
+    count = argument;
+    return true;
+}
+
+bool CBORReader::skip(size_t depth) {
+    uint8_t major;
+    uint8_t info;
+    uint64_t argument;
+    if (depth == CBOR_MAX_DEPTH) {
+        this->failed = true;
+        return false;
+    }
+    if (!this->head(major, info, argument)) {
+        return false;
+    }
+    switch (major) {
+        case CBOR_MAJOR_BYTES:
+        case CBOR_MAJOR_TEXT:
+            if (argument > this->length - this->position) {
+                this->failed = true;
+                return false;
+            }
+            this->position += argument;
+            return true;
+        case CBOR_MAJOR_ARRAY:
+        case CBOR_MAJOR_MAP: {
+            uint64_t items = (major == CBOR_MAJOR_MAP ? argument * 2 : argument);
+            if (argument > this->length - this->position || items > this->length - this->position) {
+                this->failed = true;
+                return false;
+            }
+            for (uint64_t i = 0; i < items; i++) {
+                if (!this->skip(depth + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case CBOR_MAJOR_TAG:
+            return this->skip(depth + 1);
+        default:
+            return true;
+    }
+}
+
+// Skips one complete item, e.g. the value of a map key this firmware
+// does not know yet.
+bool CBORReader::skip() {
+    return this->skip(0);
+}
+
+bool CBORReader::ok() const {
+    return !this->failed;
+}
+
+bool CBORReader::at_end() const {
+    return this->position == this->length;
+}
@@ -0,0 +1,69 @@
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#define CBOR_MAX_DEPTH  8
+
+typedef enum {
+    CBOR_MAJOR_UINT = 0,
+    CBOR_MAJOR_NEGATIVE,
+    CBOR_MAJOR_BYTES,
+    CBOR_MAJOR_TEXT,
+    CBOR_MAJOR_ARRAY,
+    CBOR_MAJOR_MAP,
+    CBOR_MAJOR_TAG,
+    CBOR_MAJOR_SIMPLE,
+} cbor_major_t;
+
+// Writer for CBOR (RFC 8949) into a caller-supplied buffer. Containers
+// have definite lengths, so the number of elements or pairs is passed
+// up front; every integer uses its shortest encoding.
+class CBORWriter {
+    uint8_t* buffer;
+    size_t capacity;
+    size_t position;
+    bool failed;
+    void head(uint8_t major, uint64_t value);
+    void put(const void* data, size_t length);
+public:
+    CBORWriter(uint8_t* buffer, size_t size);
+    CBORWriter& add_uint(uint64_t value);
+    CBORWriter& add_int(int64_t value);
+    CBORWriter& add_bool(bool value);
+    CBORWriter& add_text(std::string_view value);
+    CBORWriter& add_bytes(const void* data, size_t length);
+    CBORWriter& begin_array(size_t count);
+    CBORWriter& begin_map(size_t count);
+    size_t length() const;
+    bool ok() const;
+};
+
+// Pull reader over a CBOR buffer. Each read consumes one item of the
+// expected type; on a mismatch or truncation it returns false and the
+// reader stays failed. Indefinite-length items are not supported.
+class CBORReader {
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+    bool failed;
+    bool head(uint8_t& major, uint8_t& info, uint64_t& value);
+    bool expect(uint8_t major, uint64_t& value);
+    bool skip(size_t depth);
+public:
+    CBORReader(const uint8_t* data, size_t length);
+    bool read_uint(uint64_t& value);
+    bool read_int(int64_t& value);
+    bool read_bool(bool& value);
+    bool read_text(std::string_view& value);
+    bool read_bytes(const uint8_t*& data, size_t& length);
+    bool read_array(size_t& count);
+    bool read_map(size_t& count);
+    bool skip();
+    bool ok() const;
+    bool at_end() const;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "commands.hpp"
+#include "json.hpp"
+#include "json_reader.hpp"
+
+#include "esp_log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+#define LOG_TAG "commands.cpp"
+
+static std::mutex registry_mutex;
+static const command_t* registry[COMMANDS_MAX];
+static size_t registry_count = 0;
+
+// Position of the first entry not ordered before name. Callers hold
+// registry_mutex.
+static size_t lower_bound(std::string_view name) {
+    return std::lower_bound(registry, registry + registry_count, name,
+        [](const command_t* entry, std::string_view key) {
+            return std::string_view(entry->name) < key;
+        }) - registry;
+}
+
+bool Commands::add(const command_t* table, size_t count) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (size_t i = 0; i < count; i++) {
+        const command_t* command = &table[i];
+        size_t position = lower_bound(command->name);
+        if (position < registry_count && std::string_view(registry[position]->name) == command->name) {
+            if (registry[position] == command) {
+                continue;
+            }
+            ESP_LOGE(LOG_TAG, "Add: Command '%s' is already registered!", command->name);
+            return false;
+        }
+        if (registry_count == COMMANDS_MAX) {
+            ESP_LOGE(LOG_TAG, "Add: Registry full, dropping '%s'!", command->name);
+            return false;
+        }
+        std::copy_backward(registry + position, registry + registry_count, registry + registry_count + 1);
+        registry[position] = command;
+        registry_count++;
+    }
+    return true;
+}
+
+const command_t* Commands::find(std::string_view name) {
+    if (name.empty() || name.length() > COMMANDS_NAME_LENGTH) {
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    size_t position = lower_bound(name);
+    if (position < registry_count && std::string_view(registry[position]->name) == name) {
+        return registry[position];
+    }
+    return NULL;
+}
+
+command_result_t Commands::check(const command_t* command, int method, Query& query, const char*& missing) {
+    if (!(command->methods & (1 << method))) {
+        return COMMAND_ERR_METHOD;
+    }
+    for (int i = 0; i < COMMANDS_MAX_REQUIRED && command->required[i] != NULL; i++) {
+        if (!query.has(command->required[i])) {
+            missing = command->required[i];
+            return COMMAND_ERR_PARAMETER;
+        }
+    }
+    return COMMAND_OK;
+}
+
+// Looks up and runs the command named by 'type'. Lookup and parameter
+// errors are answered like any other command result.
+static esp_err_t execute(httpd_req_t* request, int method, Query& query) {
+
+    std::string_view name = query.get("type");
+
+    if (name.empty()) {
+        JSON::simple_response(request, query, false, "Missing 'type' parameter!");
+        return ESP_OK;
+    }
+
+    char message[96];
+    const command_t* command = Commands::find(name);
+    if (command == NULL) {
+        snprintf(message, sizeof(message), "Invalid command: '%.*s'.",
+            (int)std::min<size_t>(name.length(), 64), name.data());
+        JSON::simple_response(request, query, false, message);
+        return ESP_OK;
+    }
+
+    // Batch entries carry no method of their own. Batches are POSTed as
+    // JSON, which a browser cannot send cross-site without a preflight,
+    // so entries may name GET-only commands as well.
+    if (method < 0) {
+        method = (command->methods & COMMAND_POST) ? HTTP_POST : HTTP_GET;
+    }
+
+    const char* missing = NULL;
+    command_result_t result = Commands::check(command, method, query, missing);
+    if (result == COMMAND_OK) {
+        return command->handler(request, query);
+    }
+    if (result == COMMAND_ERR_METHOD) {
+        httpd_resp_set_status(request, "405 Method Not Allowed");
+        snprintf(message, sizeof(message), "Command '%s' does not accept this method!", command->name);
+    } else {
+        snprintf(message, sizeof(message), "Missing '%s' parameter!", missing);
+    }
+    JSON::simple_response(request, query, false, message);
+    return ESP_OK;
+
+}
+
+esp_err_t Commands::dispatch(httpd_req_t* request) {
+
+    Query query(request);
+    httpd_resp_set_type(request, "text/plain");
+
+    char body[COMMANDS_BODY_SIZE];
+    if (request->method == HTTP_POST && request->content_len > 0 && JSONReader::is_json(request)) {
+        size_t length = 0;
+        json_read_result_t result = JSONReader::receive(request, body, sizeof(body), length);
+        if (result == JSON_READ_OK && !query.parse_json(body, length)) {
+            result = JSON_READ_ERR_MALFORMED;
+        }
+        if (result != JSON_READ_OK) {
+            JSON::simple_response(request, false, JSONReader::describe(result));
+            return (result == JSON_READ_ERR_RECV ? ESP_FAIL : ESP_OK);
+        }
+    }
+
+    return execute(request, request->method, query);
+
+}
+
+// Runs {"stop_on_error": bool, "commands": [{"type": ..., ...}, ...]} in
+// order. Each command writes its usual response, embedded as the next
+// element of "results" and streamed as soon as it is finalized; totals
+// follow once the batch is done.
+esp_err_t Commands::batch(httpd_req_t* request) {
+
+    httpd_resp_set_type(request, "text/plain");
+
+    char body[COMMANDS_BODY_SIZE];
+    size_t length = 0;
+    json_read_result_t result = JSON_READ_ERR_MALFORMED;
+    if (JSONReader::is_json(request)) {
+        result = JSONReader::receive(request, body, sizeof(body), length);
+    }
+    if (result == JSON_READ_ERR_TIMEOUT) {
+        httpd_resp_send_408(request);
+        return ESP_FAIL;
+    }
+    if (result == JSON_READ_ERR_RECV) {
+        return ESP_FAIL;
+    }
+    if (result != JSON_READ_OK) {
+        JSON::simple_response(request, false, JSONReader::describe(result));
+        return ESP_OK;
+    }
+
+    JSONReader reader(body, length);
+    int commands = reader.ok() ? reader.find(JSON_READER_ROOT, "commands") : -1;
+    if (!reader.ok()) {
+        JSON::simple_response(request, false, JSONReader::describe(reader.status()));
+        return ESP_OK;
+    }
+    if (commands < 0 || reader.token(commands).type != JSON_TOKEN_ARRAY) {
+        JSON::simple_response(request, false, "Missing 'commands' array!");
+        return ESP_OK;
+    }
+    uint16_t total = reader.token(commands).size;
+    if (total > COMMANDS_BATCH_MAX) {
+        JSON::simple_response(request, false, "Too many commands in batch!");
+        return ESP_OK;
+    }
+    bool stop_on_error = false;
+    reader.get_bool(JSON_READER_ROOT, "stop_on_error", stop_on_error);
+
+    json_embed_t embed = { "{\"results\": [", false, true };
+    bool opened = false;
+    unsigned executed = 0;
+    unsigned failed = 0;
+    int index = commands + 1;
+    for (uint16_t i = 0; i < total; i++) {
+        embed.written = false;
+        embed.success = true;
+        esp_err_t status = ESP_OK;
+        Query query("");
+        query.embed(&embed);
+        if (!query.add_json(reader, index)) {
+            JSON::simple_response(request, query, false, "Batch entries must be objects!");
+        } else {
+            status = execute(request, -1, query);
+        }
+        if (!embed.written) {
+            JSON::simple_response(request, query, false, "Command sent no response!");
+        }
+        if (status != ESP_OK) {
+            return status;
+        }
+        opened = true;
+        embed.prefix = ",";
+        executed++;
+        if (!embed.success) {
+            failed++;
+            if (stop_on_error) {
+                break;
+            }
+        }
+        index = reader.token(index).next;
+    }
+
+    char trailer[128];
+    int trailer_length = snprintf(trailer, sizeof(trailer),
+        "%s\n], \"executed\": %u, \"failed\": %u, \"skipped\": %u, \"success\": %s}",
+        opened ? "" : "{\"results\": [", executed, failed, (unsigned)total - executed, failed == 0 ? "true" : "false");
+    if (httpd_resp_send_chunk(request, trailer, trailer_length) != ESP_OK ||
+        httpd_resp_send_chunk(request, NULL, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+
+}
+
+size_t Commands::size() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return registry_count;
+}
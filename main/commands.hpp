@@ -0,0 +1,55 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include "query.hpp"
+
+#include "esp_http_server.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#define COMMANDS_MAX            32
+#define COMMANDS_MAX_REQUIRED   2
+#define COMMANDS_NAME_LENGTH    32
+#define COMMANDS_BODY_SIZE      512
+#define COMMANDS_BATCH_MAX      8
+
+#define COMMAND_GET             (1 << HTTP_GET)
+#define COMMAND_POST            (1 << HTTP_POST)
+
+// Handler of a /command request. The registry has already checked the
+// method and that every required parameter is present. Handlers answer
+// through JSON(request, query), so a batch can embed their result.
+typedef esp_err_t (*command_handler_t)(httpd_req_t* request, Query& query);
+
+typedef struct {
+    const char* name;
+    command_handler_t handler;
+    uint32_t methods;
+    const char* required[COMMANDS_MAX_REQUIRED];
+} command_t;
+
+typedef enum {
+    COMMAND_OK,
+    COMMAND_ERR_METHOD,
+    COMMAND_ERR_PARAMETER,
+} command_result_t;
+
+// Registry behind /command. Subsystems add static tables of commands
+// during init; entries are kept sorted by name so dispatch is a binary
+// search over pointers, independent of how many commands exist. POST
+// requests may carry their parameters as a flat JSON object instead of,
+// or in addition to, the query string. batch() runs several commands in
+// one request and streams their results as one response.
+class Commands {
+public:
+    static bool add(const command_t* table, size_t count);
+    static const command_t* find(std::string_view name);
+    static command_result_t check(const command_t* command, int method, Query& query, const char*& missing);
+    static esp_err_t dispatch(httpd_req_t* request);
+    static esp_err_t batch(httpd_req_t* request);
+    static size_t size();
+};
+
+#endif
@@ -2,35 +2,238 @@
 #include "nvstorage.hpp"
 
 #include "esp_log.h"
+#include "esp_crc.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
 
 #define LOG_TAG "config.cpp"
 
+#define CONFIG_RECORD_KEY       "record"
+#define CONFIG_RECORD_MAGIC     0x47464353
+#define CONFIG_RECORD_VERSION   2
+#define CONFIG_RECORD_CAPACITY  512
+
+// On-flash layout of the config record. New fields are only ever appended
+// to config_payload_t together with a version bump; the header records how
+// many payload bytes were written so older and newer records both load.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t crc;
+} config_header_t;
+
+typedef struct __attribute__((packed)) {
+    char ssid[CONFIG_SSID_LENGTH + 1];
+    char psk[CONFIG_PSK_LENGTH + 1];
+    uint8_t security;
+    uint8_t priority;
+} config_stored_profile_t;
+
+// Version 1 ends after primary.security. Version 2 appends the primary
+// priority and the remaining profiles, of which only the used ones are
+// written.
+typedef struct __attribute__((packed)) {
+    config_stored_profile_t primary;
+    uint8_t additional;
+    config_stored_profile_t profiles[CONFIG_MAX_PROFILES - 1];
+} config_payload_t;
+
+typedef struct __attribute__((packed)) {
+    config_header_t header;
+    union {
+        config_payload_t payload;
+        uint8_t reserved[CONFIG_RECORD_CAPACITY - sizeof(config_header_t)];
+    };
+} config_record_t;
+
+static_assert(sizeof(config_payload_t) <= CONFIG_RECORD_CAPACITY - sizeof(config_header_t),
+    "Config payload exceeds record capacity");
+
+struct config_subscriber_t {
+    config_listener_t listener;
+    void* context;
+};
+
+static std::mutex store_mutex;
+static std::mutex commit_mutex;
+static Config* store = nullptr;
+static config_subscriber_t subscribers[CONFIG_MAX_LISTENERS];
+static size_t subscriber_count = 0;
+
+static void copy_field(char* destination, size_t capacity, std::string_view value) {
+    size_t length = std::min(value.length(), capacity);
+    memcpy(destination, value.data(), length);
+    destination[length] = '\0';
+}
+
+static void load_profile(config_profile_t& profile, const config_stored_profile_t& stored) {
+    copy_field(profile.ssid, CONFIG_SSID_LENGTH, std::string_view(stored.ssid, strnlen(stored.ssid, sizeof(stored.ssid))));
+    copy_field(profile.psk, CONFIG_PSK_LENGTH, std::string_view(stored.psk, strnlen(stored.psk, sizeof(stored.psk))));
+    profile.security = static_cast<wifi_auth_mode_t>(stored.security);
+    profile.priority = std::min<uint8_t>(stored.priority, CONFIG_MAX_PRIORITY);
+}
+
+static void store_profile(config_stored_profile_t& stored, const config_profile_t& profile) {
+    memcpy(stored.ssid, profile.ssid, sizeof(stored.ssid));
+    memcpy(stored.psk, profile.psk, sizeof(stored.psk));
+    stored.security = profile.security;
+    stored.priority = profile.priority;
+}
+
 Config::Config() {
-    this->reload();
+    std::lock_guard<std::mutex> lock(store_mutex);
+    if (store != nullptr) {
+        *this = *store;
+    } else {
+        this->count = 0;
+    }
 }
 
-bool Config::reload() {
-    ESP_LOGD(LOG_TAG, "Reload: Reloading config...");
+bool Config::load() {
+    static Config instance;
+    Config loaded;
+    bool success = loaded.read();
+    std::lock_guard<std::mutex> lock(store_mutex);
+    instance = loaded;
+    store = &instance;
+    return success;
+}
+
+bool Config::subscribe(config_listener_t listener, void* context) {
+    std::lock_guard<std::mutex> lock(store_mutex);
+    if (subscriber_count == CONFIG_MAX_LISTENERS) {
+        ESP_LOGE(LOG_TAG, "Subscribe: Too many config listeners!");
+        return false;
+    }
+    subscribers[subscriber_count++] = { listener, context };
+    return true;
+}
+
+void Config::publish(const Config& config) {
+    config_subscriber_t current[CONFIG_MAX_LISTENERS];
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(store_mutex);
+        if (store != nullptr) {
+            *store = config;
+        }
+        count = subscriber_count;
+        memcpy(current, subscribers, sizeof(config_subscriber_t) * count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        current[i].listener(config, current[i].context);
+    }
+}
+
+static uint32_t record_crc(const config_record_t& record) {
+    return esp_crc32_le(0, reinterpret_cast<const uint8_t*>(&record.payload), record.header.length);
+}
+
+bool Config::read() {
+    ESP_LOGD(LOG_TAG, "Read: Reading config from NVS...");
+    this->count = 0;
     try {
         NVStorage storage("config", true);
-        this->ssid = storage.get_str("ssid");
-        this->psk = storage.get_str("psk");
-        this->security = static_cast<wifi_auth_mode_t>(storage.get_uint8("security"));
-        ESP_LOGD(LOG_TAG, "Reload: Config reloaded successful!");
-        return true;
+        config_record_t record = {};
+        size_t length = sizeof(record);
+        esp_err_t result = storage.read_blob(CONFIG_RECORD_KEY, &record, length);
+        if (result == ESP_OK) {
+            if (length < sizeof(config_header_t) ||
+                record.header.magic != CONFIG_RECORD_MAGIC ||
+                record.header.length > length - sizeof(config_header_t) ||
+                record.header.crc != record_crc(record)) {
+                ESP_LOGE(LOG_TAG, "Read: Config record is corrupt, ignoring.");
+                return false;
+            }
+            // Fields appended by newer schema versions are ignored, fields
+            // missing from older records keep their zero defaults.
+            config_payload_t payload = {};
+            memcpy(&payload, &record.payload, std::min<size_t>(record.header.length, sizeof(payload)));
+            if (payload.primary.ssid[0] != '\0') {
+                load_profile(this->profiles[this->count++], payload.primary);
+            }
+            size_t stored = offsetof(config_payload_t, profiles);
+            size_t additional = record.header.length > stored ? (record.header.length - stored) / sizeof(config_stored_profile_t) : 0;
+            additional = std::min<size_t>({ additional, payload.additional, CONFIG_MAX_PROFILES - 1 });
+            for (size_t i = 0; i < additional && this->count > 0; i++) {
+                load_profile(this->profiles[this->count++], payload.profiles[i]);
+            }
+            ESP_LOGD(LOG_TAG, "Read: Config record version %u read successful!", record.header.version);
+            return true;
+        }
+        // Only a missing record means legacy keys or a fresh unit; any
+        // other error must not be mistaken for an empty config.
+        if (result != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGE(LOG_TAG, "Read: Could not read config record! (%d)", result);
+            return false;
+        }
+        return this->migrate(storage);
     } catch (int error) {
-        ESP_LOGE(LOG_TAG, "Reload: Unable to access NVS.");
+        ESP_LOGE(LOG_TAG, "Read: Unable to access NVS.");
         return false;
     }
 }
 
+bool Config::migrate(NVStorage& storage) {
+    std::string ssid = storage.get_str("ssid");
+    if (ssid.empty()) {
+        ESP_LOGD(LOG_TAG, "Migrate: No legacy config found.");
+        return true;
+    }
+    ESP_LOGI(LOG_TAG, "Migrate: Converting legacy config to record version %u...", CONFIG_RECORD_VERSION);
+    config_profile_t& profile = this->profiles[0];
+    copy_field(profile.ssid, CONFIG_SSID_LENGTH, ssid);
+    copy_field(profile.psk, CONFIG_PSK_LENGTH, storage.get_str("psk"));
+    profile.security = static_cast<wifi_auth_mode_t>(storage.get_uint8("security"));
+    profile.priority = 0;
+    this->count = 1;
+    storage.begin();
+    this->write(storage);
+    storage.erase_key("ssid");
+    storage.erase_key("psk");
+    storage.erase_key("security");
+    if (!storage.commit()) {
+        ESP_LOGE(LOG_TAG, "Migrate: Could not store converted config!");
+    }
+    return true;
+}
+
+bool Config::write(NVStorage& storage) {
+    config_record_t record = {};
+    record.header.magic = CONFIG_RECORD_MAGIC;
+    record.header.version = CONFIG_RECORD_VERSION;
+    record.header.length = offsetof(config_payload_t, profiles);
+    if (this->count > 0) {
+        store_profile(record.payload.primary, this->profiles[0]);
+        record.payload.additional = this->count - 1;
+        for (size_t i = 1; i < this->count; i++) {
+            store_profile(record.payload.profiles[i - 1], this->profiles[i]);
+        }
+        record.header.length += record.payload.additional * sizeof(config_stored_profile_t);
+    }
+    record.header.crc = record_crc(record);
+    return storage.set_blob(CONFIG_RECORD_KEY, &record, sizeof(config_header_t) + record.header.length);
+}
+
+bool Config::reload() {
+    ESP_LOGD(LOG_TAG, "Reload: Reloading config...");
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    if (!this->read()) {
+        return false;
+    }
+    Config::publish(*this);
+    return true;
+}
+
 bool Config::commit() {
     try {
         NVStorage storage("config", true);
-        storage.set_str("ssid", this->ssid.c_str());
-        storage.set_str("psk", this->psk.c_str());
-        storage.set_uint8("security", this->security);
-        return true;
+        storage.begin();
+        this->write(storage);
+        return storage.commit();
     }
     catch (int error) {
         ESP_LOGE(LOG_TAG, "Commit: Unable to access NVS.");
@@ -38,26 +241,118 @@ bool Config::commit() {
     }
 }
 
-std::string Config::get_ssid() {
-    return this->ssid;
+std::string_view Config::get_ssid() const {
+    return this->count > 0 ? this->profiles[0].ssid : "";
+}
+
+std::string_view Config::get_psk() const {
+    return this->count > 0 ? this->profiles[0].psk : "";
 }
 
-std::string Config::get_psk() {
-    return this->psk;
+wifi_auth_mode_t Config::get_security() const {
+    return this->count > 0 ? this->profiles[0].security : WIFI_AUTH_OPEN;
 }
 
-wifi_auth_mode_t Config::get_security() {
-    return this->security;
+size_t Config::profile_count() const {
+    return this->count;
 }
 
-bool Config::set_network(std::string ssid, std::string psk, wifi_auth_mode_t security) {
-    this->ssid = ssid;
-    this->psk = psk;
-    this->security = security;
-    return this->commit();
+const config_profile_t& Config::get_profile(size_t index) const {
+    return this->profiles[index];
 }
 
-bool Config::uninitialized() {
-    return  this->ssid.empty() || 
-            this->psk.empty();
-}
\ No newline at end of file
+const config_profile_t* Config::find_profile(std::string_view ssid) const {
+    for (size_t i = 0; i < this->count; i++) {
+        if (ssid == this->profiles[i].ssid) {
+            return &this->profiles[i];
+        }
+    }
+    return nullptr;
+}
+
+// Setting a network moves its profile to the front, so the most recently
+// configured network is the primary one. With all slots taken the least
+// recently configured profile is dropped.
+bool Config::set_network(std::string_view ssid, std::string_view psk, wifi_auth_mode_t security, uint8_t priority) {
+    if (ssid.empty() || ssid.length() > CONFIG_SSID_LENGTH || psk.length() > CONFIG_PSK_LENGTH) {
+        ESP_LOGE(LOG_TAG, "Set: Network credentials exceed maximum length!");
+        return false;
+    }
+    if (priority > CONFIG_MAX_PRIORITY) {
+        ESP_LOGE(LOG_TAG, "Set: Network priority exceeds maximum!");
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    const config_profile_t* existing = this->find_profile(ssid);
+    size_t shifted = existing != nullptr ? existing - this->profiles : std::min<size_t>(this->count, CONFIG_MAX_PROFILES - 1);
+    if (existing == nullptr && this->count == CONFIG_MAX_PROFILES) {
+        ESP_LOGW(LOG_TAG, "Set: Dropping network profile '%s'.", this->profiles[CONFIG_MAX_PROFILES - 1].ssid);
+    }
+    memmove(&this->profiles[1], &this->profiles[0], shifted * sizeof(config_profile_t));
+    if (existing == nullptr) {
+        this->count = shifted + 1;
+    }
+    config_profile_t& profile = this->profiles[0];
+    copy_field(profile.ssid, CONFIG_SSID_LENGTH, ssid);
+    copy_field(profile.psk, CONFIG_PSK_LENGTH, psk);
+    profile.security = security;
+    profile.priority = priority;
+    if (!this->commit()) {
+        return false;
+    }
+    Config::publish(*this);
+    return true;
+}
+
+bool Config::remove_network(std::string_view ssid) {
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    const config_profile_t* existing = this->find_profile(ssid);
+    if (existing == nullptr) {
+        return false;
+    }
+    size_t index = existing - this->profiles;
+    memmove(&this->profiles[index], &this->profiles[index + 1], (this->count - index - 1) * sizeof(config_profile_t));
+    this->count--;
+    if (!this->commit()) {
+        return false;
+    }
+    Config::publish(*this);
+    return true;
+}
+
+// Replaces all profiles at once, in the given order, with one record
+// write. Used for provisioning, so an empty list is rejected rather than
+// sending the controller back into AP mode.
+bool Config::set_networks(const config_profile_t* profiles, size_t count) {
+    if (count == 0 || count > CONFIG_MAX_PROFILES) {
+        ESP_LOGE(LOG_TAG, "Set: Invalid number of network profiles!");
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        std::string_view ssid(profiles[i].ssid, strnlen(profiles[i].ssid, sizeof(profiles[i].ssid)));
+        if (ssid.empty() || ssid.length() > CONFIG_SSID_LENGTH ||
+            strnlen(profiles[i].psk, sizeof(profiles[i].psk)) > CONFIG_PSK_LENGTH ||
+            profiles[i].priority > CONFIG_MAX_PRIORITY) {
+            ESP_LOGE(LOG_TAG, "Set: Invalid network profile!");
+            return false;
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (ssid == profiles[j].ssid) {
+                ESP_LOGE(LOG_TAG, "Set: Duplicate network profile!");
+                return false;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    memcpy(this->profiles, profiles, count * sizeof(config_profile_t));
+    this->count = count;
+    if (!this->commit()) {
+        return false;
+    }
+    Config::publish(*this);
+    return true;
+}
+
+bool Config::uninitialized() const {
+    return this->count == 0;
+}
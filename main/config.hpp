@@ -3,25 +3,62 @@
 
 #include "esp_wifi_types.h"
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
 
-class Config {
-    std::string ssid;
-    std::string psk;
+#define CONFIG_SSID_LENGTH      32
+#define CONFIG_PSK_LENGTH       64
+#define CONFIG_MAX_LISTENERS    4
+#define CONFIG_MAX_PROFILES     4
+#define CONFIG_MAX_PRIORITY     9
+#define CONFIG_DEFAULT_SECURITY WIFI_AUTH_WPA2_PSK
+
+class Config;
+class NVStorage;
+
+// Stored network profile. Profiles are kept most recently configured
+// first; the priority biases the RSSI ranking done by NetSelect.
+typedef struct {
+    char ssid[CONFIG_SSID_LENGTH + 1];
+    char psk[CONFIG_PSK_LENGTH + 1];
     wifi_auth_mode_t security;
+    uint8_t priority;
+} config_profile_t;
+
+typedef void (*config_listener_t)(const Config& config, void* context);
+
+// Snapshot of the process-wide configuration. The configuration is read
+// from NVS once by Config::load() and kept in RAM; constructing a Config
+// copies the current values under a lock without touching flash or heap.
+class Config {
+    config_profile_t profiles[CONFIG_MAX_PROFILES];
+    size_t count;
+    bool read();
+    bool migrate(NVStorage& storage);
+    bool write(NVStorage& storage);
     bool commit();
+    static void publish(const Config& config);
 public:
     Config();
+    static bool load();
+    static bool subscribe(config_listener_t listener, void* context);
     bool reload();
-    bool uninitialized();
-    std::string get_ssid();
-    std::string get_psk();
-    wifi_auth_mode_t get_security();
+    bool uninitialized() const;
+    std::string_view get_ssid() const;
+    std::string_view get_psk() const;
+    wifi_auth_mode_t get_security() const;
+    size_t profile_count() const;
+    const config_profile_t& get_profile(size_t index) const;
+    const config_profile_t* find_profile(std::string_view ssid) const;
     bool set_network(
-        std::string ssid, 
-        std::string psk, 
-        wifi_auth_mode_t security
+        std::string_view ssid, 
+        std::string_view psk, 
+        wifi_auth_mode_t security,
+        uint8_t priority = 0
     );
+    bool remove_network(std::string_view ssid);
+    bool set_networks(const config_profile_t* profiles, size_t count);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,222 @@
+#include "counterlog.hpp"
+
+#include "esp_crc.h"
+#include "esp_log.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#define LOG_TAG "counterlog.cpp"
+
+// A blob takes an index entry and a data header entry plus its 32-byte
+// data spans.
+#define COUNTERLOG_RECORD_ENTRIES   (2 + (sizeof(counter_record_t) + COUNTERLOG_ENTRY_SIZE - 1) / COUNTERLOG_ENTRY_SIZE)
+
+typedef struct {
+    const char* name;
+    uint32_t flush_delta;
+} counter_spec_t;
+
+// A delta of 0 leaves the counter to the flush interval alone.
+static const counter_spec_t specs[COUNTER_COUNT] = {
+    { "cups", 5 },
+    { "descales", 1 },
+    { "heater_seconds", 900 },
+    { "uptime_seconds", 0 },
+    { "reboots", 1 },
+};
+
+static uint32_t record_crc(const counter_record_t& record) {
+    return esp_crc32_le(0, reinterpret_cast<const uint8_t*>(&record), offsetof(counter_record_t, crc));
+}
+
+static uint32_t retained_crc(const counter_retained_t& retained) {
+    return esp_crc32_le(0, reinterpret_cast<const uint8_t*>(&retained), offsetof(counter_retained_t, crc));
+}
+
+static void slot_key(uint32_t sequence, char* key, size_t size) {
+    snprintf(key, size, "log%u", (unsigned)(sequence % COUNTERLOG_SLOTS));
+}
+
+CounterLog::CounterLog() {
+    memset(this->values, 0, sizeof(this->values));
+    memset(this->pending, 0, sizeof(this->pending));
+    this->descaled_at = 0;
+    this->sequence = 0;
+    this->marked = false;
+    this->flushed_us = 0;
+}
+
+// Picks the newest intact record from all slots. Pending increments are
+// dropped, they have to be restored against the loaded sequence.
+bool CounterLog::load(NVStorage& storage) {
+    counter_record_t latest = {};
+    for (uint32_t slot = 0; slot < COUNTERLOG_SLOTS; slot++) {
+        char key[8];
+        slot_key(slot, key, sizeof(key));
+        counter_record_t record;
+        size_t length = sizeof(record);
+        if (!storage.get_blob(key, &record, length)) {
+            continue;
+        }
+        if (length != sizeof(record) || record.version != COUNTERLOG_VERSION ||
+            record.count != COUNTER_COUNT || record.crc != record_crc(record)) {
+            ESP_LOGW(LOG_TAG, "Load: Discarding damaged record in '%s'.", key);
+            continue;
+        }
+        if (record.sequence > latest.sequence) {
+            latest = record;
+        }
+    }
+    memcpy(this->values, latest.values, sizeof(this->values));
+    memset(this->pending, 0, sizeof(this->pending));
+    this->descaled_at = latest.descaled_at;
+    this->sequence = latest.sequence;
+    this->marked = false;
+    return latest.sequence != 0;
+}
+
+bool CounterLog::restore(const counter_retained_t& retained) {
+    if (retained.magic != COUNTERLOG_MAGIC || retained.crc != retained_crc(retained) ||
+        retained.sequence != this->sequence) {
+        return false;
+    }
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        this->pending[counter] += retained.pending[counter];
+    }
+    if (retained.descaled_at != this->descaled_at) {
+        this->descaled_at = retained.descaled_at;
+        this->marked = true;
+    }
+    return true;
+}
+
+void CounterLog::retain(counter_retained_t& retained) const {
+    retained.magic = COUNTERLOG_MAGIC;
+    retained.sequence = this->sequence;
+    memcpy(retained.pending, this->pending, sizeof(retained.pending));
+    retained.descaled_at = this->descaled_at;
+    retained.crc = retained_crc(retained);
+}
+
+void CounterLog::add(counter_id_t counter, uint32_t amount) {
+    this->pending[counter] += amount;
+    if (counter == COUNTER_DESCALES && amount > 0) {
+        this->descaled_at = this->value(COUNTER_CUPS);
+        this->marked = true;
+    }
+}
+
+bool CounterLog::due(int64_t now_us) const {
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        if (specs[counter].flush_delta > 0 && this->pending[counter] >= specs[counter].flush_delta) {
+            return true;
+        }
+    }
+    return this->dirty() && now_us - this->flushed_us >= COUNTERLOG_FLUSH_INTERVAL_S * 1000000LL;
+}
+
+bool CounterLog::dirty() const {
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        if (this->pending[counter] > 0) {
+            return true;
+        }
+    }
+    return this->marked;
+}
+
+// Appends one record to the next slot. On failure nothing changes, so
+// the increments stay pending for the next attempt.
+bool CounterLog::flush(NVStorage& storage, int64_t now_us) {
+    counter_record_t record;
+    if (!this->prepare(record)) {
+        return true;
+    }
+    if (!CounterLog::write(storage, record)) {
+        return false;
+    }
+    this->committed(record, now_us);
+    return true;
+}
+
+// Fills in the record that would be appended next; false if there is
+// nothing to write.
+bool CounterLog::prepare(counter_record_t& record) const {
+    if (!this->dirty()) {
+        return false;
+    }
+    record = {};
+    record.sequence = this->sequence + 1;
+    record.version = COUNTERLOG_VERSION;
+    record.count = COUNTER_COUNT;
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        record.values[counter] = this->value(static_cast<counter_id_t>(counter));
+    }
+    record.descaled_at = this->descaled_at;
+    record.crc = record_crc(record);
+    return true;
+}
+
+bool CounterLog::write(NVStorage& storage, const counter_record_t& record) {
+    char key[8];
+    slot_key(record.sequence, key, sizeof(key));
+    if (!storage.set_blob(key, &record, sizeof(record))) {
+        ESP_LOGE(LOG_TAG, "Flush: Could not append record %u!", (unsigned)record.sequence);
+        return false;
+    }
+    return true;
+}
+
+// Only what the record captured leaves pending; a descale marked after
+// prepare() still needs a record of its own.
+void CounterLog::committed(const counter_record_t& record, int64_t now_us) {
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        this->pending[counter] = this->value(static_cast<counter_id_t>(counter)) - record.values[counter];
+    }
+    memcpy(this->values, record.values, sizeof(this->values));
+    this->marked = (this->descaled_at != record.descaled_at);
+    this->sequence = record.sequence;
+    this->flushed_us = now_us;
+}
+
+uint32_t CounterLog::value(counter_id_t counter) const {
+    return this->values[counter] + this->pending[counter];
+}
+
+uint32_t CounterLog::cups_since_descale() const {
+    return this->value(COUNTER_CUPS) - this->descaled_at;
+}
+
+uint32_t CounterLog::records() const {
+    return this->sequence;
+}
+
+// Only the log's own share of the wear; other namespaces on the same
+// partition add to it.
+uint32_t CounterLog::erase_cycles() const {
+    uint64_t entries = (uint64_t)this->sequence * COUNTERLOG_RECORD_ENTRIES;
+    return (uint32_t)(entries / (COUNTERLOG_NVS_PAGES * COUNTERLOG_PAGE_ENTRIES));
+}
+
+uint32_t CounterLog::wear_ppm() const {
+    uint64_t entries = (uint64_t)this->sequence * COUNTERLOG_RECORD_ENTRIES;
+    return (uint32_t)(entries * 1000000 / ((uint64_t)COUNTERLOG_NVS_PAGES * COUNTERLOG_PAGE_ENTRIES * COUNTERLOG_ERASE_ENDURANCE));
+}
+
+// Most increments a power loss can cost while the log is writable. The
+// interval-only counters lose up to the interval plus whatever the caller
+// has not added yet.
+uint32_t CounterLog::max_loss(counter_id_t counter) {
+    if (specs[counter].flush_delta == 0) {
+        return COUNTERLOG_FLUSH_INTERVAL_S;
+    }
+    return specs[counter].flush_delta - 1;
+}
+
+const char* CounterLog::describe(counter_id_t counter) {
+    if (counter < 0 || counter >= COUNTER_COUNT) {
+        return "unknown";
+    }
+    return specs[counter].name;
+}
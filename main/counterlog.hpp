@@ -0,0 +1,94 @@
+#ifndef COUNTERLOG_H
+#define COUNTERLOG_H
+
+#include "nvstorage.hpp"
+
+#include <cstdint>
+
+#define COUNTERLOG_NAMESPACE        "counters"
+#define COUNTERLOG_SLOTS            4
+#define COUNTERLOG_VERSION          1
+#define COUNTERLOG_MAGIC            0x52544E43
+#define COUNTERLOG_FLUSH_INTERVAL_S 3600
+
+// Wear estimate for the default 24 KiB NVS partition: 6 pages of 126
+// 32-byte entries, one of which is always kept free for garbage
+// collection, and the rated erase cycles of a flash sector.
+#define COUNTERLOG_NVS_PAGES        5
+#define COUNTERLOG_PAGE_ENTRIES     126
+#define COUNTERLOG_ENTRY_SIZE       32
+#define COUNTERLOG_ERASE_ENDURANCE  100000
+
+typedef enum {
+    COUNTER_CUPS,
+    COUNTER_DESCALES,
+    COUNTER_HEATER_SECONDS,
+    COUNTER_UPTIME_SECONDS,
+    COUNTER_REBOOTS,
+    COUNTER_COUNT,
+} counter_id_t;
+
+// One entry of the log. Records go round-robin into COUNTERLOG_SLOTS
+// keys and the one with the highest sequence wins, so a torn or corrupt
+// write only loses the increments since the record before it.
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;
+    uint8_t version;
+    uint8_t count;
+    uint16_t reserved;
+    uint32_t values[COUNTER_COUNT];
+    uint32_t descaled_at;
+    uint32_t crc;
+} counter_record_t;
+
+// Increments not yet in the log, kept in RTC memory so they survive a
+// software reset. They only apply on top of the record they were
+// counted against.
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t pending[COUNTER_COUNT];
+    uint32_t descaled_at;
+    uint32_t crc;
+} counter_retained_t;
+
+// Lifetime usage counters with wear-aware persistence, kept free of any
+// platform code. Increments accumulate in RAM until a counter reaches
+// its flush delta or the flush interval passes with anything pending.
+class CounterLog {
+    uint32_t values[COUNTER_COUNT];
+    uint32_t pending[COUNTER_COUNT];
+    uint32_t descaled_at;
+    uint32_t sequence;
+    bool marked;
+    int64_t flushed_us;
+public:
+    CounterLog();
+    bool load(NVStorage& storage);
+    bool restore(const counter_retained_t& retained);
+    void retain(counter_retained_t& retained) const;
+
+    void add(counter_id_t counter, uint32_t amount);
+    bool due(int64_t now_us) const;
+    bool dirty() const;
+    bool flush(NVStorage& storage, int64_t now_us);
+
+    // flush() in three steps, so a caller can leave the NVS write outside
+    // its lock: prepare() snapshots the next record, write() appends it,
+    // committed() takes it as the new base. Increments added in between
+    // stay pending.
+    bool prepare(counter_record_t& record) const;
+    static bool write(NVStorage& storage, const counter_record_t& record);
+    void committed(const counter_record_t& record, int64_t now_us);
+
+    uint32_t value(counter_id_t counter) const;
+    uint32_t cups_since_descale() const;
+    uint32_t records() const;
+    uint32_t erase_cycles() const;
+    uint32_t wear_ppm() const;
+
+    static uint32_t max_loss(counter_id_t counter);
+    static const char* describe(counter_id_t counter);
+};
+
+#endif
@@ -0,0 +1,242 @@
+#include "counters.hpp"
+#include "io.hpp"
+#include "commands.hpp"
+#include "json.hpp"
+#include "journal.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <mutex>
+
+#define LOG_TAG "counters.cpp"
+
+static RTC_NOINIT_ATTR counter_retained_t retained;
+
+static CounterLog counters;
+static std::mutex counters_mutex;
+// Serializes appends, so two flushers never write the same sequence.
+static std::mutex append_mutex;
+static TaskHandle_t task = NULL;
+
+// Time already accrued, and the sub-second remainders not yet counted.
+static int64_t ticked_us = 0;
+static int64_t heater_since_us = -1;
+static int64_t uptime_rest_us = 0;
+static int64_t heater_rest_us = 0;
+static machine_state_t last_state = MACHINE_IDLE;
+
+// Callers hold counters_mutex.
+static void accrue(int64_t now) {
+    uptime_rest_us += now - ticked_us;
+    ticked_us = now;
+    if (heater_since_us >= 0) {
+        heater_rest_us += now - heater_since_us;
+        heater_since_us = now;
+    }
+    counters.add(COUNTER_UPTIME_SECONDS, (uint32_t)(uptime_rest_us / 1000000));
+    uptime_rest_us %= 1000000;
+    counters.add(COUNTER_HEATER_SECONDS, (uint32_t)(heater_rest_us / 1000000));
+    heater_rest_us %= 1000000;
+}
+
+// Writes the pending increments as a new record. counters_mutex is only
+// held to snapshot and to commit it, never across the NVS write, so the
+// status listener on the IO task does not wait on flash. Callers must not
+// hold counters_mutex.
+static bool append(int64_t now) {
+    std::lock_guard<std::mutex> appending(append_mutex);
+    counter_record_t record;
+    {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        if (!counters.prepare(record)) {
+            return true;
+        }
+    }
+    bool success = false;
+    try {
+        NVStorage storage(COUNTERLOG_NAMESPACE, true);
+        success = CounterLog::write(storage, record);
+    } catch (int error) {
+        ESP_LOGE(LOG_TAG, "Flush: Unable to access NVS.");
+    }
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    if (success) {
+        counters.committed(record, now);
+    }
+    counters.retain(retained);
+    return success;
+}
+
+static void counters_task(void* parameters) {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(COUNTERS_TICK_S * 1000));
+        bool due;
+        int64_t now = esp_timer_get_time();
+        {
+            std::lock_guard<std::mutex> lock(counters_mutex);
+            accrue(now);
+            counters.retain(retained);
+            due = counters.due(now);
+        }
+        if (due) {
+            append(now);
+        }
+    }
+}
+
+// Runs on the IO task, so flushing is left to the counters task.
+static void status_listener(const io_status_t& status, void* context) {
+    bool due;
+    {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        int64_t now = esp_timer_get_time();
+        if (status.state != last_state) {
+            if (status.state == MACHINE_BREWING_ONE) {
+                counters.add(COUNTER_CUPS, 1);
+            } else if (status.state == MACHINE_BREWING_TWO) {
+                counters.add(COUNTER_CUPS, 2);
+            } else if (status.state == MACHINE_DESCALING) {
+                counters.add(COUNTER_DESCALES, 1);
+            }
+            last_state = status.state;
+        }
+        if (status.heater && heater_since_us < 0) {
+            heater_since_us = now;
+        } else if (!status.heater && heater_since_us >= 0) {
+            heater_rest_us += now - heater_since_us;
+            heater_since_us = -1;
+        }
+        counters.retain(retained);
+        due = counters.due(now);
+    }
+    if (due) {
+        xTaskNotifyGive(task);
+    }
+}
+
+static esp_err_t counters_command(httpd_req_t* request, Query& query) {
+    CounterLog snapshot;
+    {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        snapshot = counters;
+    }
+    JSON json(request, query);
+    json.add_bool("success", true).begin_object("counters");
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        json.add_uint(CounterLog::describe(static_cast<counter_id_t>(counter)),
+            snapshot.value(static_cast<counter_id_t>(counter)));
+    }
+    json.end_object()
+        .add_uint("cups_since_descale", snapshot.cups_since_descale())
+        .begin_object("max_loss");
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        json.add_uint(CounterLog::describe(static_cast<counter_id_t>(counter)),
+            Counters::max_loss(static_cast<counter_id_t>(counter)));
+    }
+    json.end_object()
+        .begin_object("log")
+        .add_uint("records", snapshot.records())
+        .add_uint("erase_cycles", snapshot.erase_cycles())
+        .add_uint("wear_ppm", snapshot.wear_ppm())
+        .add_bool("pending", snapshot.dirty())
+        .end_object()
+        .finalize();
+    return ESP_OK;
+}
+
+static esp_err_t flush_command(httpd_req_t* request, Query& query) {
+    bool success = Counters::flush();
+    JSON::simple_response(request, query, success, success ? "Counters flushed." : "Could not flush counters!");
+    return ESP_OK;
+}
+
+static const command_t counters_commands[] = {
+    { "counters", counters_command, COMMAND_GET, {} },
+    { "flush_counters", flush_command, COMMAND_POST, {} },
+};
+
+// Loads the newest record and adds back whatever a software reset left
+// pending in RTC memory; after a power loss that memory fails its check.
+bool Counters::init() {
+
+    if (task != NULL) {
+        return true;
+    }
+
+    bool due;
+    int64_t now = esp_timer_get_time();
+    {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        try {
+            NVStorage storage(COUNTERLOG_NAMESPACE, true);
+            counters.load(storage);
+        } catch (int error) {
+            ESP_LOGE(LOG_TAG, "Init: Unable to access NVS.");
+        }
+        if (counters.restore(retained)) {
+            JOURNAL_LOGI(LOG_TAG, "Init: Restored pending increments from RTC memory.");
+        }
+        counters.add(COUNTER_REBOOTS, 1);
+        accrue(now);
+        counters.retain(retained);
+        due = counters.due(now);
+    }
+    if (due) {
+        append(now);
+    }
+
+    if (xTaskCreate(counters_task, "counters", COUNTERS_TASK_STACK_SIZE, NULL, COUNTERS_TASK_PRIORITY, &task) != pdPASS) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create counters task!");
+        return false;
+    }
+    IO::subscribe(status_listener, NULL);
+    Commands::add(counters_commands, sizeof(counters_commands) / sizeof(counters_commands[0]));
+    return true;
+
+}
+
+void Counters::add(counter_id_t counter, uint32_t amount) {
+    bool due;
+    {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        counters.add(counter, amount);
+        counters.retain(retained);
+        due = counters.due(esp_timer_get_time());
+    }
+    if (due && task != NULL) {
+        xTaskNotifyGive(task);
+    }
+}
+
+uint32_t Counters::value(counter_id_t counter) {
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    return counters.value(counter);
+}
+
+// Time counters also lose the part of the current tick not yet accrued.
+uint32_t Counters::max_loss(counter_id_t counter) {
+    uint32_t loss = CounterLog::max_loss(counter);
+    if (counter == COUNTER_HEATER_SECONDS || counter == COUNTER_UPTIME_SECONDS) {
+        loss += COUNTERS_TICK_S;
+    }
+    return loss;
+}
+
+uint32_t Counters::wear_ppm() {
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    return counters.wear_ppm();
+}
+
+bool Counters::flush() {
+    int64_t now = esp_timer_get_time();
+    {
+        std::lock_guard<std::mutex> lock(counters_mutex);
+        accrue(now);
+    }
+    return append(now);
+}
@@ -0,0 +1,27 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include "counterlog.hpp"
+
+#include <cstdint>
+
+#define COUNTERS_TICK_S             60
+#define COUNTERS_TASK_STACK_SIZE    3072
+#define COUNTERS_TASK_PRIORITY      2
+
+// Lifetime usage counters for maintenance: cups, descales, heater and
+// uptime seconds, reboots. Brews and heater edges are counted from IO
+// status changes, time is accrued once per tick. Pending increments are
+// mirrored to RTC memory on every change and appended to the NVS log by
+// a low-priority task when the flush policy says so, and on shutdown.
+class Counters {
+public:
+    static bool init();
+    static void add(counter_id_t counter, uint32_t amount);
+    static uint32_t value(counter_id_t counter);
+    static uint32_t max_loss(counter_id_t counter);
+    static uint32_t wear_ppm();
+    static bool flush();
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "form.hpp"
+#include "query.hpp"
+
+#include "esp_log.h"
+
+#define LOG_TAG "form.cpp"
+
+Form::Form(field_handler_t handler, void* context) {
+    this->handler = handler;
+    this->context = context;
+    this->state = KEY;
+    this->key_length = 0;
+    this->value_length = 0;
+    this->escape_length = 0;
+    this->total = 0;
+    this->result = FORM_OK;
+}
+
+bool Form::append(char current) {
+    if (this->state == KEY) {
+        if (this->key_length == FORM_MAX_KEY_LENGTH) {
+            this->result = FORM_ERR_FIELD_TOO_LONG;
+            return false;
+        }
+        this->key[this->key_length++] = current;
+    } else {
+        if (this->value_length == FORM_MAX_VALUE_LENGTH) {
+            this->result = FORM_ERR_FIELD_TOO_LONG;
+            return false;
+        }
+        this->value[this->value_length++] = current;
+    }
+    return true;
+}
+
+bool Form::emit() {
+    if (this->escape_length > 0) {
+        this->result = FORM_ERR_MALFORMED;
+        return false;
+    }
+    if (this->key_length > 0 || this->value_length > 0) {
+        std::string_view key(this->key, this->key_length);
+        std::string_view value(this->value, this->value_length);
+        if (!this->handler(key, value, this->context)) {
+            this->result = FORM_ERR_ABORTED;
+            return false;
+        }
+    }
+    this->state = KEY;
+    this->key_length = 0;
+    this->value_length = 0;
+    return true;
+}
+
+form_result_t Form::feed(const char* data, size_t length) {
+    if (this->result != FORM_OK) {
+        return this->result;
+    }
+    if (length > FORM_MAX_BODY_LENGTH - this->total) {
+        this->result = FORM_ERR_BODY_TOO_LARGE;
+        return this->result;
+    }
+    this->total += length;
+    for (size_t i = 0; i < length; i++) {
+        char current = data[i];
+        if (this->escape_length > 0) {
+            this->escape[this->escape_length++ - 1] = current;
+            if (this->escape_length < 3) {
+                continue;
+            }
+            this->escape_length = 0;
+            if (!Query::decode_hex(this->escape[0], this->escape[1], current)) {
+                this->result = FORM_ERR_MALFORMED;
+                return this->result;
+            }
+            if (!this->append(current)) {
+                return this->result;
+            }
+        } else if (current == '%') {
+            this->escape_length = 1;
+        } else if (current == '&') {
+            if (!this->emit()) {
+                return this->result;
+            }
+        } else if (current == '=' && this->state == KEY) {
+            this->state = VALUE;
+        } else if (!this->append(current == '+' ? ' ' : current)) {
+            return this->result;
+        }
+    }
+    return this->result;
+}
+
+form_result_t Form::finish() {
+    if (this->result == FORM_OK) {
+        this->emit();
+    }
+    return this->result;
+}
+
+form_result_t Form::receive(httpd_req_t* request) {
+    size_t remaining = request->content_len;
+    if (remaining > FORM_MAX_BODY_LENGTH) {
+        ESP_LOGW(LOG_TAG, "Receive: Body of %u bytes exceeds limit.", (unsigned)remaining);
+        this->result = FORM_ERR_BODY_TOO_LARGE;
+        return this->result;
+    }
+    char chunk[FORM_CHUNK_SIZE];
+    uint8_t retries = 0;
+    while (remaining > 0) {
+        size_t length = (remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        int received = httpd_req_recv(request, chunk, length);
+        if (received == HTTPD_SOCK_ERR_TIMEOUT && retries < FORM_RECV_RETRIES) {
+            retries++;
+            continue;
+        }
+        if (received <= 0) {
+            this->result = (received == HTTPD_SOCK_ERR_TIMEOUT ? FORM_ERR_TIMEOUT : FORM_ERR_RECV);
+            return this->result;
+        }
+        retries = 0;
+        remaining -= received;
+        if (this->feed(chunk, received) != FORM_OK) {
+            return this->result;
+        }
+    }
+    return this->finish();
+}
+
+const char* Form::describe(form_result_t result) {
+    switch (result) {
+        case FORM_OK:                   return "OK";
+        case FORM_ERR_RECV:             return "Failed receiving request body!";
+        case FORM_ERR_TIMEOUT:          return "Timed out receiving request body!";
+        case FORM_ERR_BODY_TOO_LARGE:   return "Request body too large!";
+        case FORM_ERR_FIELD_TOO_LONG:   return "Form field too long!";
+        case FORM_ERR_MALFORMED:        return "Malformed form encoding!";
+        case FORM_ERR_ABORTED:          return "Invalid form field!";
+    }
+    return "Unknown error!";
+}
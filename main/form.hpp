@@ -0,0 +1,54 @@
+#ifndef FORM_H
+#define FORM_H
+
+#include "esp_http_server.h"
+
+#include <string_view>
+
+#define FORM_CHUNK_SIZE         128
+#define FORM_MAX_KEY_LENGTH     32
+#define FORM_MAX_VALUE_LENGTH   128
+#define FORM_MAX_BODY_LENGTH    1024
+#define FORM_RECV_RETRIES       3
+
+typedef enum {
+    FORM_OK = 0,
+    FORM_ERR_RECV,
+    FORM_ERR_TIMEOUT,
+    FORM_ERR_BODY_TOO_LARGE,
+    FORM_ERR_FIELD_TOO_LONG,
+    FORM_ERR_MALFORMED,
+    FORM_ERR_ABORTED,
+} form_result_t;
+
+// Incremental application/x-www-form-urlencoded parser. The body is
+// consumed in chunks of FORM_CHUNK_SIZE bytes and every decoded field is
+// handed to the handler as soon as it is complete, so memory use does
+// not depend on the size of the request.
+class Form {
+public:
+    typedef bool (*field_handler_t)(std::string_view key, std::string_view value, void* context);
+private:
+    enum state_t { KEY, VALUE };
+    field_handler_t handler;
+    void* context;
+    state_t state;
+    char key[FORM_MAX_KEY_LENGTH];
+    char value[FORM_MAX_VALUE_LENGTH];
+    size_t key_length;
+    size_t value_length;
+    char escape[2];
+    uint8_t escape_length;
+    size_t total;
+    form_result_t result;
+    bool append(char current);
+    bool emit();
+public:
+    Form(field_handler_t handler, void* context);
+    form_result_t feed(const char* data, size_t length);
+    form_result_t finish();
+    form_result_t receive(httpd_req_t* request);
+    static const char* describe(form_result_t result);
+};
+
+#endif
@@ -1,146 +1,393 @@
 #include "interface.hpp"
 #include "nvstorage.hpp"
 #include "config.hpp"
+#include "commands.hpp"
 #include "query.hpp"
+#include "form.hpp"
+#include "actions.hpp"
+#include "io.hpp"
+#include "telemetry.hpp"
+#include "push.hpp"
+#include "assets.hpp"
+#include "metrics.hpp"
+#include "journal.hpp"
+#include "ota.hpp"
 #include "json.hpp"
-
-#include "html_template.h"
+#include "json_reader.hpp"
+#include "provision.hpp"
+#include "scheduler.hpp"
+#include "templates.hpp"
 
 #include "esp_log.h"
 
-#define LOG_TAG "interface.cpp"
+#include <cstdio>
+#include <cstring>
 
-esp_err_t command_handler(httpd_req_t* request) {
+#define LOG_TAG "interface.cpp"
 
-    Query query(request);
-    std::string command = query.get("type");
-    httpd_resp_set_type(request, "text/plain");
+struct netconfig_form_t {
+    std::string ssid;
+    std::string psk;
+    wifi_auth_mode_t security = CONFIG_DEFAULT_SECURITY;
+};
 
-    if (command.empty()) {
-        std::string response = JSON::simple_response(false, "Missing 'type' parameter!");
-        httpd_resp_send(request, response.c_str(), response.length());
+static bool parse_security(std::string_view value, wifi_auth_mode_t& security) {
+    if (value.empty() || value.length() > 2) {
+        return false;
     }
-    
-    else {
-
-        if (command == "network") {
-            Config config;
-            std::string ssid = config.get_ssid();
-            std::string response;
-            if (ssid.empty()) {
-                response = JSON()
-                    .add_bool("success", false)
-                    .add_string("message", "Unable to read network from config!")
-                    .finalize();
-            } else {
-                response = JSON()
-                    .add_bool("success", true)
-                    .add_string("message", "Successfully read network from config,")
-                    .add_json("network", JSON()
-                        .add_string("ssid", ssid)
-                        .add_string("psk", config.get_psk())
-                        .add_int("security", config.get_security())
-                    )
-                    .finalize();
-            }
-            httpd_resp_send(request, response.c_str(), response.length());
-        } 
-        
-        else if (command == "reboot") {
-            std::string response = JSON::simple_response(
-                true, "Going down in " + std::to_string(RESET_DELAY_SECS) + "seconds..."
-            );
-            httpd_resp_send(request, response.c_str(), response.length());
-            vTaskDelay((RESET_DELAY_SECS * 1000) / portTICK_PERIOD_MS);
-            esp_restart();
-        } 
-        
-        else if (command == "reset") {
-            bool deinit = NVStorage::deinit();
-            bool erase = NVStorage::erase();
-            bool success = deinit && erase;
-            std::string response = JSON()
-                .add_bool("success", success)
-                .add_bool("deinit", deinit)
-                .add_bool("erase", erase)
-                .add_string("message", (success ?
-                    "Successfully erased NVS, going down in" +
-                    std::to_string(RESET_DELAY_SECS) + " seconds..." :
-                    "Failed to erase NVS!"))
-                .finalize();
-            httpd_resp_send(request, response.c_str(), response.length());
-            if (success) {
-                vTaskDelay((RESET_DELAY_SECS * 1000) / portTICK_PERIOD_MS);
-                esp_restart();
-            }
-        } 
-        
-        else {
-            std::string response = JSON::simple_response(false, "Invalid command: '" + command + "'.");
-            httpd_resp_send(request, response.c_str(), response.length());
+    int result = 0;
+    for (char current : value) {
+        if (current < '0' || current > '9') {
+            return false;
         }
+        result = result * 10 + (current - '0');
     }
+    if (result >= WIFI_AUTH_MAX) {
+        return false;
+    }
+    security = static_cast<wifi_auth_mode_t>(result);
+    return true;
+}
 
-    return ESP_OK;
+static bool netconfig_field(std::string_view key, std::string_view value, void* context) {
+    netconfig_form_t* form = static_cast<netconfig_form_t*>(context);
+    if (key == "ssid") {
+        if (value.length() > 32) {
+            return false;
+        }
+        form->ssid = value;
+    } else if (key == "psk") {
+        if (value.length() > 64) {
+            return false;
+        }
+        form->psk = value;
+    } else if (key == "security") {
+        return parse_security(value, form->security);
+    }
+    return true;
 }
 
-esp_err_t root_handler(httpd_req_t* request) {
-    const char* response = HTML_TEMPLATE_NETCONFIG;
-    httpd_resp_send(request, response, strlen(response));
-    return ESP_OK;
+// JSON bodies, e.g. {"ssid": "...", "psk": "...", "security": 3}, are
+// validated by the same field handler as form bodies.
+static json_read_result_t netconfig_json(httpd_req_t* request, netconfig_form_t& fields, bool& valid) {
+    char body[INTERFACE_JSON_BODY_SIZE];
+    size_t length = 0;
+    json_read_result_t result = JSONReader::receive(request, body, sizeof(body), length);
+    if (result != JSON_READ_OK) {
+        return result;
+    }
+    JSONReader reader(body, length);
+    if (!reader.ok()) {
+        return reader.status();
+    }
+    std::string_view ssid;
+    std::string_view psk;
+    reader.get_string(JSON_READER_ROOT, "ssid", ssid);
+    reader.get_string(JSON_READER_ROOT, "psk", psk);
+    valid = netconfig_field("ssid", ssid, &fields) && netconfig_field("psk", psk, &fields);
+    uint32_t security;
+    if (reader.get_uint(JSON_READER_ROOT, "security", security)) {
+        valid = valid && security < WIFI_AUTH_MAX;
+        fields.security = static_cast<wifi_auth_mode_t>(security);
+    }
+    return JSON_READ_OK;
 }
 
 esp_err_t netconfig_handler(httpd_req_t* request) {
 
-    char* buffer = (char*)calloc(sizeof(char), request->content_len + 1);
-    int result = httpd_req_recv(request, buffer, request->content_len);
-    if (result <= 0) {
-        if (result == HTTPD_SOCK_ERR_TIMEOUT) {
+    netconfig_form_t fields;
+    if (JSONReader::is_json(request)) {
+        bool valid = false;
+        json_read_result_t result = netconfig_json(request, fields, valid);
+        if (result == JSON_READ_ERR_TIMEOUT) {
             httpd_resp_send_408(request);
-        } free(buffer);
-        return ESP_FAIL;
+            return ESP_FAIL;
+        }
+        if (result == JSON_READ_ERR_RECV) {
+            return ESP_FAIL;
+        }
+        if (result != JSON_READ_OK || !valid) {
+            JSON::simple_response(request, false, result != JSON_READ_OK ? JSONReader::describe(result) : "Invalid network field!");
+            return ESP_OK;
+        }
+    } else {
+        form_result_t result = Form(netconfig_field, &fields).receive(request);
+        if (result == FORM_ERR_TIMEOUT) {
+            httpd_resp_send_408(request);
+            return ESP_FAIL;
+        }
+        if (result == FORM_ERR_RECV) {
+            return ESP_FAIL;
+        }
+        if (result != FORM_OK) {
+            JSON::simple_response(request, false, Form::describe(result));
+            return ESP_OK;
+        }
     }
 
-    Query query(buffer);
-    free(buffer);
-
-    std::string ssid = query.get("ssid");
-    std::string psk = query.get("psk");
+    std::string& ssid = fields.ssid;
+    std::string& psk = fields.psk;
 
     if (ssid.empty() || psk.empty()) {
-        std::string response = JSON::simple_response(false, "Missing SSID/PSK parameters!");
-        httpd_resp_send(request, response.c_str(), response.length());
+        JSON::simple_response(request, false, "Missing SSID/PSK parameters!");
         return ESP_OK;
     }
     
     Config config;
-    bool success = config.set_network(ssid, psk, WIFI_AUTH_WPA2_PSK);
-    std::string response = JSON::simple_response(
-        success, success ? "Successfully set network to '" +
-        ssid + "! Going down in " + std::to_string(RESET_DELAY_SECS) + 
-        " seconds..." : "Failed to set network."
-    );
-    httpd_resp_send(request, response.c_str(), response.length());
+    bool success = config.set_network(ssid, psk, fields.security);
+    char message[96];
     if (success) {
-        vTaskDelay((RESET_DELAY_SECS * 1000) / portTICK_PERIOD_MS);
-        esp_restart();
+        success = Actions::schedule(ACTION_REBOOT);
+        snprintf(message, sizeof(message), "Successfully set network to '%.32s'! Going down in %u ms...",
+            ssid.c_str(), (unsigned)Actions::default_delay(ACTION_REBOOT));
+    } else {
+        snprintf(message, sizeof(message), "Failed to set network.");
+    }
+    JSON::simple_response(request, success, message);
+
+    return ESP_OK;
+
+}
+
+esp_err_t telemetry_handler(httpd_req_t* request) {
+
+    Query query(request);
+    std::string_view format = query.get("format");
+    uint32_t since = 0;
+    uint32_t until = UINT32_MAX;
+    query.get_uint("since", since);
+    query.get_uint("until", until);
+
+    if (format == "binary") {
+        httpd_resp_set_type(request, "application/octet-stream");
+        Telemetry::export_window(request, TELEMETRY_BINARY, since, until);
+    } else if (format.empty() || format == "csv") {
+        httpd_resp_set_type(request, "text/csv");
+        Telemetry::export_window(request, TELEMETRY_CSV, since, until);
+    } else {
+        httpd_resp_set_type(request, "text/plain");
+        JSON::simple_response(request, false, "Parameter 'format' must be 'csv' or 'binary'!");
     }
 
     return ESP_OK;
+}
+
+// Full device configuration as one CBOR document, see Provision.
+esp_err_t config_export_handler(httpd_req_t* request) {
+    uint8_t document[PROVISION_MAX_LENGTH];
+    size_t length = Provision::write(Config(), Scheduler::table(), document, sizeof(document));
+    if (length == 0) {
+        httpd_resp_set_type(request, "text/plain");
+        JSON::simple_response(request, false, "Could not encode configuration!");
+        return ESP_OK;
+    }
+    httpd_resp_set_type(request, "application/cbor");
+    return httpd_resp_send(request, (const char*)document, length);
+}
+
+// Imports a document from config_export_handler. Nothing is stored
+// unless the whole document is valid; schedules and network profiles are
+// then written as one blob each and take effect immediately. Only a
+// controller still waiting in AP mode reboots to join its new network.
+esp_err_t config_import_handler(httpd_req_t* request) {
+
+    httpd_resp_set_type(request, "text/plain");
+
+    uint8_t body[PROVISION_MAX_LENGTH];
+    size_t length = 0;
+    json_read_result_t received = JSONReader::receive(request, (char*)body, sizeof(body), length);
+    if (received == JSON_READ_ERR_TIMEOUT) {
+        httpd_resp_send_408(request);
+        return ESP_FAIL;
+    }
+    if (received == JSON_READ_ERR_RECV) {
+        return ESP_FAIL;
+    }
+    if (received != JSON_READ_OK) {
+        JSON::simple_response(request, false, JSONReader::describe(received));
+        return ESP_OK;
+    }
+
+    provision_document_t document;
+    provision_result_t result = Provision::read(body, length, document);
+    if (result != PROVISION_OK) {
+        JSON::simple_response(request, false, Provision::describe(result));
+        return ESP_OK;
+    }
+
+    // Staging is the single write that commits the import; should one of
+    // the sections below fail to store, the next boot applies it again.
+    if (!Provision::stage(body, length)) {
+        JSON::simple_response(request, false, "Failed to store configuration!");
+        return ESP_OK;
+    }
+    Config config;
+    bool provisioning = config.uninitialized();
+    bool success = true;
+    if (document.sections & (PROVISION_SCHEDULES | PROVISION_MACHINE)) {
+        scheduler_table_t table = Scheduler::table();
+        Provision::merge(document, table);
+        success = Scheduler::set_table(table);
+    }
+    if (success && (document.sections & PROVISION_NETWORKS)) {
+        success = config.set_networks(document.networks, document.network_count);
+    }
+    if (!success) {
+        JSON::simple_response(request, false, "Configuration staged, it is applied on the next boot.");
+        return ESP_OK;
+    }
+    Provision::clear();
+
+    if (provisioning && (document.sections & PROVISION_NETWORKS)) {
+        char message[96];
+        success = Actions::schedule(ACTION_REBOOT);
+        snprintf(message, sizeof(message), "Configuration imported! Going down in %u ms to join '%.32s'...",
+            (unsigned)Actions::default_delay(ACTION_REBOOT), document.networks[0].ssid);
+        JSON::simple_response(request, success, message);
+        return ESP_OK;
+    }
+    JSON::simple_response(request, true, "Configuration imported.");
+    return ESP_OK;
 
 }
 
-httpd_uri_t root_uri {
-    .uri = "/",
+// Deferred log entries, formatted on the way out. 'since' is the
+// sequence number of the first entry wanted, so clients can poll for
+// new lines only.
+esp_err_t logs_handler(httpd_req_t* request) {
+    Query query(request);
+    uint32_t since = 0;
+    query.get_uint("since", since);
+    httpd_resp_set_type(request, "text/plain");
+    return Journal::export_text(request, since);
+}
+
+// WebSocket endpoint. The handshake attaches the socket to the push
+// channel; text frames carry commands in query-string form, e.g.
+// "type=brew&cups=1", and are answered with a compact JSON frame.
+esp_err_t websocket_handler(httpd_req_t* request) {
+
+    int fd = httpd_req_to_sockfd(request);
+    if (request->method == HTTP_GET) {
+        if (!Push::attach(fd)) {
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    }
+
+    char buffer[INTERFACE_WS_FRAME_SIZE + 1];
+    httpd_ws_frame_t frame = {};
+    if (httpd_ws_recv_frame(request, &frame, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (frame.type == HTTPD_WS_TYPE_CLOSE) {
+        Push::detach(fd);
+        return ESP_OK;
+    }
+    if (frame.type != HTTPD_WS_TYPE_TEXT || frame.len > INTERFACE_WS_FRAME_SIZE) {
+        return ESP_FAIL;
+    }
+    frame.payload = (uint8_t*)buffer;
+    if (httpd_ws_recv_frame(request, &frame, frame.len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    buffer[frame.len] = '\0';
+
+    Query query(buffer);
+    std::string_view command = query.get("type");
+    char response[INTERFACE_WS_FRAME_SIZE];
+    JSON json(response, sizeof(response), false);
+    if (command == "status") {
+        io_status_t status = IO::status();
+        json.add_bool("success", true)
+            .add_string("state", Machine::describe(status.state))
+            .add_bool("heater", status.heater)
+            .add_bool("water", status.water);
+    } else {
+        machine_command_t action;
+        const char* error = IO::parse_command(command, query, action);
+        io_command_result_t result = (error == NULL ? IO::command(action) : IO_COMMAND_REJECTED);
+        json.add_bool("success", result != IO_COMMAND_REJECTED);
+        if (result == IO_COMMAND_PENDING) {
+            json.add_bool("pending", true);
+        }
+        if (error != NULL) {
+            json.add_string("message", error);
+        }
+        json.add_string("state", Machine::describe(IO::status().state));
+    }
+    if (!json.finalize()) {
+        return ESP_FAIL;
+    }
+
+    httpd_ws_frame_t reply = {};
+    reply.type = HTTPD_WS_TYPE_TEXT;
+    reply.payload = (uint8_t*)response;
+    reply.len = json.length();
+    return httpd_ws_send_frame(request, &reply);
+
+}
+
+static void page_slot(template_slot_t slot, TemplateWriter& writer, void* context) {
+    const Config& config = *(const Config*)context;
+    switch (slot) {
+        case TEMPLATE_SLOT_SSID:
+            writer.add_text(config.uninitialized() ? "none" : config.get_ssid());
+            break;
+        case TEMPLATE_SLOT_PROFILES:
+            writer.add_int(config.profile_count());
+            break;
+        case TEMPLATE_SLOT_STATE:
+            writer.add_text(Machine::describe(IO::status().state));
+            break;
+        default:
+            break;
+    }
+}
+
+// Pages in templates/ are rendered with live values, everything else is
+// a static asset; '/' maps to index.html and any query string is ignored.
+static esp_err_t page_handler(httpd_req_t* request) {
+    std::string_view path(request->uri);
+    path = path.substr(0, path.find('?'));
+    if (path == "/") {
+        path = "/index.html";
+    }
+    const template_t* page = Templates::find(path);
+    if (page == NULL) {
+        return Assets::handler(request);
+    }
+    Config config;
+    return Templates::render(request, page, page_slot, &config);
+}
+
+// Registered last with wildcard matching so it only receives GET
+// requests no other handler claimed.
+httpd_uri_t assets_uri {
+    .uri = "/*",
     .method = HTTP_GET,
-    .handler = root_handler,
+    .handler = page_handler,
     .user_ctx = NULL
 };
 
 httpd_uri_t command_uri {
     .uri = "/command",
     .method = HTTP_GET,
-    .handler = command_handler,
+    .handler = Commands::dispatch,
+    .user_ctx = NULL
+};
+
+httpd_uri_t command_post_uri {
+    .uri = "/command",
+    .method = HTTP_POST,
+    .handler = Commands::dispatch,
+    .user_ctx = NULL
+};
+
+httpd_uri_t command_batch_uri {
+    .uri = "/command/batch",
+    .method = HTTP_POST,
+    .handler = Commands::batch,
     .user_ctx = NULL
 };
 
@@ -151,12 +398,87 @@ httpd_uri_t netconfig_uri {
     .user_ctx = NULL
 };
 
+Interface::Interface() {
+    this->server = NULL;
+}
+
+httpd_uri_t telemetry_uri {
+    .uri = "/telemetry",
+    .method = HTTP_GET,
+    .handler = telemetry_handler,
+    .user_ctx = NULL
+};
+
+httpd_uri_t ota_uri {
+    .uri = "/ota",
+    .method = HTTP_POST,
+    .handler = Ota::handler,
+    .user_ctx = NULL
+};
+
+httpd_uri_t config_export_uri {
+    .uri = "/config",
+    .method = HTTP_GET,
+    .handler = config_export_handler,
+    .user_ctx = NULL
+};
+
+httpd_uri_t config_import_uri {
+    .uri = "/config",
+    .method = HTTP_POST,
+    .handler = config_import_handler,
+    .user_ctx = NULL
+};
+
+httpd_uri_t logs_uri {
+    .uri = "/logs",
+    .method = HTTP_GET,
+    .handler = logs_handler,
+    .user_ctx = NULL
+};
+
+httpd_uri_t metrics_uri {
+    .uri = "/metrics",
+    .method = HTTP_GET,
+    .handler = Metrics::handler,
+    .user_ctx = NULL
+};
+
+httpd_uri_t websocket_uri {
+    .uri = "/ws",
+    .method = HTTP_GET,
+    .handler = websocket_handler,
+    .user_ctx = NULL,
+    .is_websocket = true
+};
+
+// Every route is wrapped for /metrics. assets_uri has to stay last.
+static httpd_uri_t* const uris[] = {
+    &command_uri,
+    &command_post_uri,
+    &command_batch_uri,
+    &netconfig_uri,
+    &config_export_uri,
+    &config_import_uri,
+    &telemetry_uri,
+    &metrics_uri,
+    &logs_uri,
+    &ota_uri,
+    &websocket_uri,
+    &assets_uri,
+};
+
 bool Interface::start_server() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.max_uri_handlers = INTERFACE_MAX_URI_HANDLERS;
+    config.stack_size = INTERFACE_STACK_SIZE;
     if (httpd_start(&this->server, &config) == ESP_OK) {
-        httpd_register_uri_handler(this->server, &root_uri);
-        httpd_register_uri_handler(this->server, &command_uri);
-        httpd_register_uri_handler(this->server, &netconfig_uri);
+        for (httpd_uri_t* uri : uris) {
+            Metrics::wrap(uri);
+            httpd_register_uri_handler(this->server, uri);
+        }
+        Push::init(this->server);
         return true;
     }
     return false;
@@ -164,7 +486,9 @@ bool Interface::start_server() {
 
 bool Interface::stop_server() {
     if (this->server) {
-        return httpd_stop(this->server) == ESP_OK;
+        esp_err_t result = httpd_stop(this->server);
+        this->server = NULL;
+        return result == ESP_OK;
     }
     return false;
 }
\ No newline at end of file
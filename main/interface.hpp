@@ -5,7 +5,10 @@
 
 #include <string>
 
-#define RESET_DELAY_SECS 5
+#define INTERFACE_WS_FRAME_SIZE     128
+#define INTERFACE_MAX_URI_HANDLERS  16
+#define INTERFACE_JSON_BODY_SIZE    256
+#define INTERFACE_STACK_SIZE        6144
 
 class Interface {
     httpd_handle_t server;
@@ -14,6 +17,7 @@ class Interface {
         std::string message
     );
 public:
+    Interface();
     bool start_server();
     bool stop_server();
 };
@@ -1,4 +1,403 @@
 #include "io.hpp"
+#include "commands.hpp"
+#include "json.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <atomic>
+#include <mutex>
+
+#define LOG_TAG "io.cpp"
+
+static const gpio_num_t button_pins[IO_BUTTON_COUNT] = {
+    IO_PIN_BUTTON_POWER, IO_PIN_BUTTON_ONE_CUP, IO_PIN_BUTTON_TWO_CUP
+};
+
+static const gpio_num_t press_pins[IO_BUTTON_COUNT] = {
+    IO_PIN_PRESS_POWER, IO_PIN_PRESS_ONE_CUP, IO_PIN_PRESS_TWO_CUP
+};
+
+// Command replies go to a notification index of their own and carry the
+// ticket of the command, so a reply that arrives after the caller timed
+// out is told apart from the one it waits for.
+typedef struct {
+    io_event_t event;
+    TaskHandle_t reply;
+    uint32_t ticket;
+} io_message_t;
+
+static QueueHandle_t queue = NULL;
+static std::mutex status_mutex;
+static io_status_t current = { MACHINE_IDLE, 0, false, true };
+static io_latency_t latencies = {};
+static portMUX_TYPE latency_lock = portMUX_INITIALIZER_UNLOCKED;
+static std::atomic<uint32_t> tickets(0);
+
+struct io_subscriber_t {
+    io_listener_t listener;
+    void* context;
+};
+
+// Slots are only ever appended. The count is published after the slot is
+// written, so the IO task sees either the old list or the complete new one.
+static io_subscriber_t subscribers[IO_MAX_LISTENERS];
+static std::atomic<size_t> subscriber_count(0);
+static std::mutex subscribe_mutex;
+
+// Button presses are emulated by driving the press pins high and releasing
+// them from a one-shot esp_timer, so pulse width does not depend on task
+// scheduling.
+class GpioHal : public IOHal {
+    esp_timer_handle_t timer = NULL;
+    volatile uint8_t pressed = 0;
+    volatile int64_t released = 0;
+
+    static void release(void* argument) {
+        GpioHal* hal = static_cast<GpioHal*>(argument);
+        for (int button = 0; button < IO_BUTTON_COUNT; button++) {
+            if (hal->pressed & IO_BUTTON_MASK(button)) {
+                gpio_set_level(press_pins[button], 0);
+            }
+        }
+        hal->released = esp_timer_get_time();
+        hal->pressed = 0;
+    }
+
+public:
+    bool init() {
+        esp_timer_create_args_t args = {};
+        args.callback = GpioHal::release;
+        args.arg = this;
+        args.name = "io_press";
+        return esp_timer_create(&args, &this->timer) == ESP_OK;
+    }
+
+    int64_t now() override {
+        return esp_timer_get_time();
+    }
+
+    bool press(uint8_t buttons, uint32_t duration_us) override {
+        if (this->pressed != 0) {
+            return false;
+        }
+        this->pressed = buttons;
+        for (int button = 0; button < IO_BUTTON_COUNT; button++) {
+            if (buttons & IO_BUTTON_MASK(button)) {
+                gpio_set_level(press_pins[button], 1);
+            }
+        }
+        if (esp_timer_start_once(this->timer, duration_us) != ESP_OK) {
+            GpioHal::release(this);
+            return false;
+        }
+        return true;
+    }
+
+    // Our own presses show up on the front-panel inputs as well; those
+    // edges must not be fed back into the state machine.
+    bool echo(uint8_t button, int64_t timestamp) {
+        return (this->pressed & IO_BUTTON_MASK(button)) ||
+               timestamp - this->released < IO_DEBOUNCE_US;
+    }
+};
+
+static GpioHal hal;
+
+static void IRAM_ATTR button_isr(void* argument) {
+    uint8_t button = (uint8_t)(uintptr_t)argument;
+    if (gpio_get_level(button_pins[button]) != 0) {
+        return;
+    }
+    io_message_t message = { { IO_EVENT_BUTTON, button, true, esp_timer_get_time() }, NULL, 0 };
+    BaseType_t woken = pdFALSE;
+    if (xQueueSendFromISR(queue, &message, &woken) != pdTRUE) {
+        portENTER_CRITICAL_ISR(&latency_lock);
+        latencies.dropped++;
+        portEXIT_CRITICAL_ISR(&latency_lock);
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void IRAM_ATTR sense_isr(void* argument) {
+    io_event_type_t type = (io_event_type_t)(uintptr_t)argument;
+    gpio_num_t pin = (type == IO_EVENT_HEATER ? IO_PIN_SENSE_HEATER : IO_PIN_SENSE_WATER);
+    io_message_t message = { { type, 0, gpio_get_level(pin) != 0, esp_timer_get_time() }, NULL, 0 };
+    BaseType_t woken = pdFALSE;
+    if (xQueueSendFromISR(queue, &message, &woken) != pdTRUE) {
+        portENTER_CRITICAL_ISR(&latency_lock);
+        latencies.dropped++;
+        portEXIT_CRITICAL_ISR(&latency_lock);
+    }
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void record_latency(int64_t timestamp) {
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - timestamp);
+    portENTER_CRITICAL(&latency_lock);
+    latencies.count++;
+    latencies.last_us = latency;
+    latencies.total_us += latency;
+    if (latency > latencies.max_us) {
+        latencies.max_us = latency;
+    }
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+static void publish(Machine& machine) {
+    io_status_t next = { machine.get_state(), machine.get_entered(), machine.get_heater(), machine.get_water() };
+    {
+        std::lock_guard<std::mutex> lock(status_mutex);
+        if (next.state == current.state && next.entered == current.entered &&
+            next.heater == current.heater && next.water == current.water) {
+            return;
+        }
+        current = next;
+    }
+    size_t count = subscriber_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        subscribers[i].listener(next, subscribers[i].context);
+    }
+}
+
+// The task blocks on the event queue until the next state machine
+// deadline, so edges are handled as soon as they arrive and timeouts
+// fire without periodic polling.
+static void io_task(void* parameters) {
+    Machine machine(hal);
+    int64_t last_edge[IO_BUTTON_COUNT] = {};
+    io_message_t message;
+    while (true) {
+        int64_t deadline = machine.deadline();
+        TickType_t timeout = portMAX_DELAY;
+        if (deadline > 0) {
+            int64_t remaining = deadline - esp_timer_get_time();
+            timeout = (remaining > 0 ? pdMS_TO_TICKS(remaining / 1000) + 1 : 0);
+        }
+        if (xQueueReceive(queue, &message, timeout) == pdTRUE) {
+            io_event_t& event = message.event;
+            if (event.type == IO_EVENT_COMMAND) {
+                bool accepted = machine.command(static_cast<machine_command_t>(event.source));
+                if (message.reply != NULL) {
+                    xTaskNotifyIndexed(message.reply, IO_NOTIFY_INDEX, (message.ticket << 1) | (accepted ? 1 : 0),
+                        eSetValueWithOverwrite);
+                }
+            } else if (event.type == IO_EVENT_BUTTON) {
+                bool bounce = event.timestamp - last_edge[event.source] < IO_DEBOUNCE_US;
+                last_edge[event.source] = event.timestamp;
+                if (!bounce && !hal.echo(event.source, event.timestamp)) {
+                    machine.handle(event);
+                    record_latency(event.timestamp);
+                }
+            } else {
+                machine.handle(event);
+                record_latency(event.timestamp);
+            }
+        }
+        machine.expire();
+        publish(machine);
+    }
+}
+
+static esp_err_t status_command(httpd_req_t* request, Query& query) {
+    io_status_t status = IO::status();
+    io_latency_t latency = IO::latency();
+    JSON(request, query)
+        .add_bool("success", true)
+        .add_string("message", "Successfully read machine status.")
+        .begin_object("machine")
+            .add_string("state", Machine::describe(status.state))
+            .add_int("since", (int)((esp_timer_get_time() - status.entered) / 1000))
+            .add_bool("heater", status.heater)
+            .add_bool("water", status.water)
+        .end_object()
+        .begin_object("latency")
+            .add_int("count", latency.count)
+            .add_int("last_us", latency.last_us)
+            .add_int("max_us", latency.max_us)
+            .add_int("mean_us", latency.count ? (int)(latency.total_us / latency.count) : 0)
+            .add_int("dropped", latency.dropped)
+        .end_object()
+        .finalize();
+    return ESP_OK;
+}
+
+static esp_err_t machine_command(httpd_req_t* request, Query& query) {
+    machine_command_t action;
+    const char* error = IO::parse_command(query.get("type"), query, action);
+    if (error != NULL) {
+        JSON::simple_response(request, query, false, error);
+        return ESP_OK;
+    }
+    io_command_result_t result = IO::command(action);
+    JSON(request, query)
+        .add_bool("success", result != IO_COMMAND_REJECTED)
+        .add_string("message", result == IO_COMMAND_ACCEPTED ? "Command accepted." :
+                               result == IO_COMMAND_PENDING ? "Command queued, machine is busy." :
+                               "Command rejected in current state.")
+        .add_string("state", Machine::describe(IO::status().state))
+        .finalize();
+    return ESP_OK;
+}
+
+static const command_t io_commands[] = {
+    { "brew", machine_command, COMMAND_GET | COMMAND_POST, { "cups" } },
+    { "descale", machine_command, COMMAND_GET | COMMAND_POST, {} },
+    { "power", machine_command, COMMAND_GET | COMMAND_POST, { "state" } },
+    { "status", status_command, COMMAND_GET, {} },
+};
 
 IO::IO() {}
-IO::~IO() {}
\ No newline at end of file
+IO::~IO() {}
+
+bool IO::init() {
+
+    if (queue != NULL) {
+        return true;
+    }
+
+    gpio_config_t outputs = {};
+    outputs.pin_bit_mask = (1ULL << IO_PIN_PRESS_POWER) | (1ULL << IO_PIN_PRESS_ONE_CUP) | (1ULL << IO_PIN_PRESS_TWO_CUP);
+    outputs.mode = GPIO_MODE_OUTPUT;
+    outputs.intr_type = GPIO_INTR_DISABLE;
+
+    gpio_config_t buttons = {};
+    buttons.pin_bit_mask = (1ULL << IO_PIN_BUTTON_POWER) | (1ULL << IO_PIN_BUTTON_ONE_CUP) | (1ULL << IO_PIN_BUTTON_TWO_CUP);
+    buttons.mode = GPIO_MODE_INPUT;
+    buttons.pull_up_en = GPIO_PULLUP_ENABLE;
+    buttons.intr_type = GPIO_INTR_NEGEDGE;
+
+    gpio_config_t senses = {};
+    senses.pin_bit_mask = (1ULL << IO_PIN_SENSE_HEATER) | (1ULL << IO_PIN_SENSE_WATER);
+    senses.mode = GPIO_MODE_INPUT;
+    senses.intr_type = GPIO_INTR_ANYEDGE;
+
+    if (gpio_config(&outputs) != ESP_OK || gpio_config(&buttons) != ESP_OK || gpio_config(&senses) != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Init: Could not configure GPIOs!");
+        return false;
+    }
+
+    if (!hal.init()) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create press timer!");
+        return false;
+    }
+
+    queue = xQueueCreate(IO_QUEUE_LENGTH, sizeof(io_message_t));
+    if (queue == NULL) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create event queue!");
+        return false;
+    }
+
+    if (gpio_install_isr_service(0) != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Init: Could not install GPIO ISR service!");
+        return false;
+    }
+    for (int button = 0; button < IO_BUTTON_COUNT; button++) {
+        gpio_isr_handler_add(button_pins[button], button_isr, (void*)(uintptr_t)button);
+    }
+    gpio_isr_handler_add(IO_PIN_SENSE_HEATER, sense_isr, (void*)(uintptr_t)IO_EVENT_HEATER);
+    gpio_isr_handler_add(IO_PIN_SENSE_WATER, sense_isr, (void*)(uintptr_t)IO_EVENT_WATER);
+
+    if (xTaskCreate(io_task, "io", IO_TASK_STACK_SIZE, NULL, IO_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create IO task!");
+        return false;
+    }
+
+    // Seed the state machine with the current sense levels.
+    int64_t now = esp_timer_get_time();
+    io_message_t heater = { { IO_EVENT_HEATER, 0, gpio_get_level(IO_PIN_SENSE_HEATER) != 0, now }, NULL, 0 };
+    io_message_t water = { { IO_EVENT_WATER, 0, gpio_get_level(IO_PIN_SENSE_WATER) != 0, now }, NULL, 0 };
+    xQueueSend(queue, &heater, 0);
+    xQueueSend(queue, &water, 0);
+
+    Commands::add(io_commands, sizeof(io_commands) / sizeof(io_commands[0]));
+
+    ESP_LOGI(LOG_TAG, "Init: Machine control running.");
+    return true;
+
+}
+
+// A command that was queued but not answered in time is reported as
+// pending rather than rejected, since the IO task will still run it.
+io_command_result_t IO::command(machine_command_t command) {
+    if (queue == NULL) {
+        return IO_COMMAND_REJECTED;
+    }
+    uint32_t ticket = tickets.fetch_add(1) & (UINT32_MAX >> 1);
+    int64_t started = esp_timer_get_time();
+    io_message_t message = { { IO_EVENT_COMMAND, (uint8_t)command, true, started }, xTaskGetCurrentTaskHandle(), ticket };
+    xTaskNotifyStateClearIndexed(NULL, IO_NOTIFY_INDEX);
+    if (xQueueSend(queue, &message, pdMS_TO_TICKS(IO_COMMAND_TIMEOUT_MS)) != pdTRUE) {
+        return IO_COMMAND_REJECTED;
+    }
+    int64_t deadline = started + IO_COMMAND_TIMEOUT_MS * 1000LL;
+    while (true) {
+        int64_t remaining = deadline - esp_timer_get_time();
+        uint32_t reply = 0;
+        if (remaining <= 0 ||
+            xTaskNotifyWaitIndexed(IO_NOTIFY_INDEX, 0, UINT32_MAX, &reply, pdMS_TO_TICKS(remaining / 1000) + 1) != pdTRUE) {
+            return IO_COMMAND_PENDING;
+        }
+        if ((reply >> 1) == ticket) {
+            return (reply & 1) ? IO_COMMAND_ACCEPTED : IO_COMMAND_REJECTED;
+        }
+    }
+}
+
+io_status_t IO::status() {
+    std::lock_guard<std::mutex> lock(status_mutex);
+    return current;
+}
+
+io_latency_t IO::latency() {
+    portENTER_CRITICAL(&latency_lock);
+    io_latency_t copy = latencies;
+    portEXIT_CRITICAL(&latency_lock);
+    return copy;
+}
+
+// Safe to call while the IO task is running; a new listener gets the
+// next status change.
+bool IO::subscribe(io_listener_t listener, void* context) {
+    std::lock_guard<std::mutex> lock(subscribe_mutex);
+    size_t count = subscriber_count.load(std::memory_order_relaxed);
+    if (count == IO_MAX_LISTENERS) {
+        ESP_LOGE(LOG_TAG, "Subscribe: Too many IO listeners!");
+        return false;
+    }
+    subscribers[count] = { listener, context };
+    subscriber_count.store(count + 1, std::memory_order_release);
+    return true;
+}
+
+// Maps the power/brew/descale commands and their parameter to a machine
+// command. Returns an error message, or NULL on success.
+const char* IO::parse_command(std::string_view command, Query& query, machine_command_t& action) {
+    if (command == "power") {
+        std::string_view state = query.get("state");
+        if (state != "on" && state != "off") {
+            return "Parameter 'state' must be 'on' or 'off'!";
+        }
+        action = (state == "on" ? MACHINE_POWER_ON : MACHINE_POWER_OFF);
+    } else if (command == "brew") {
+        std::string_view cups = query.get("cups");
+        if (cups != "1" && cups != "2") {
+            return "Parameter 'cups' must be 1 or 2!";
+        }
+        action = (cups == "1" ? MACHINE_BREW_ONE : MACHINE_BREW_TWO);
+    } else if (command == "descale") {
+        action = MACHINE_DESCALE;
+    } else {
+        return "Invalid command!";
+    }
+    return NULL;
+}
@@ -1,10 +1,72 @@
 #ifndef IO_H
 #define IO_H
 
+#include "machine.hpp"
+#include "query.hpp"
+
+#include "driver/gpio.h"
+
+#include <cstdint>
+
+#define IO_PIN_BUTTON_POWER     GPIO_NUM_25
+#define IO_PIN_BUTTON_ONE_CUP   GPIO_NUM_26
+#define IO_PIN_BUTTON_TWO_CUP   GPIO_NUM_27
+#define IO_PIN_PRESS_POWER      GPIO_NUM_16
+#define IO_PIN_PRESS_ONE_CUP    GPIO_NUM_17
+#define IO_PIN_PRESS_TWO_CUP    GPIO_NUM_18
+#define IO_PIN_SENSE_HEATER     GPIO_NUM_32
+#define IO_PIN_SENSE_WATER      GPIO_NUM_33
+
+#define IO_QUEUE_LENGTH         16
+#define IO_TASK_STACK_SIZE      4096
+#define IO_TASK_PRIORITY        10
+#define IO_DEBOUNCE_US          30000
+#define IO_COMMAND_TIMEOUT_MS   100
+#define IO_NOTIFY_INDEX         1
+#define IO_MAX_LISTENERS        6
+
+// Edge-to-action latency of input events: time from the GPIO edge seen
+// by the ISR until the state machine finished handling it.
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t dropped;
+} io_latency_t;
+
+// Outcome of IO::command. A pending command is still queued and runs once
+// the IO task gets to it; whether it is accepted is not known yet.
+typedef enum {
+    IO_COMMAND_REJECTED,
+    IO_COMMAND_ACCEPTED,
+    IO_COMMAND_PENDING,
+} io_command_result_t;
+
+typedef struct {
+    machine_state_t state;
+    int64_t entered;
+    bool heater;
+    bool water;
+} io_status_t;
+
+// Called from the IO task whenever the published status changes; must
+// not block.
+typedef void (*io_listener_t)(const io_status_t& status, void* context);
+
+// Machine control. Front-panel buttons and the heater/water sense lines
+// raise GPIO interrupts that are queued to the IO task, which owns the
+// brew state machine and emulates button presses with esp_timer pulses.
 class IO {
 public:
     IO();
     ~IO();
+    bool init();
+    static io_command_result_t command(machine_command_t command);
+    static io_status_t status();
+    static io_latency_t latency();
+    static bool subscribe(io_listener_t listener, void* context);
+    static const char* parse_command(std::string_view command, Query& query, machine_command_t& action);
 };
 
-#endif
\ No newline at end of file
+#endif
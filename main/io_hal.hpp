@@ -0,0 +1,28 @@
+#ifndef IO_HAL_H
+#define IO_HAL_H
+
+#include <cstdint>
+
+typedef enum {
+    IO_BUTTON_POWER,
+    IO_BUTTON_ONE_CUP,
+    IO_BUTTON_TWO_CUP,
+    IO_BUTTON_COUNT
+} io_button_t;
+
+#define IO_BUTTON_MASK(button) (1u << (button))
+
+// Hardware abstraction used by the brew state machine. The firmware
+// implements it on top of GPIO and esp_timer; tests implement it with a
+// simulated machine.
+class IOHal {
+public:
+    virtual ~IOHal() {}
+    // Monotonic time in microseconds.
+    virtual int64_t now() = 0;
+    // Holds the buttons in the mask pressed for duration_us. Returns false
+    // if another press is still in progress.
+    virtual bool press(uint8_t buttons, uint32_t duration_us) = 0;
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "journal.hpp"
+
+#include "esp_attr.h"
+#include "esp_ota_ops.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <cstdio>
+
+#define LOG_TAG "journal.cpp"
+
+#define JOURNAL_IMAGE_LENGTH    16
+
+typedef struct {
+    uint32_t magic;
+    char image[JOURNAL_IMAGE_LENGTH + 1];
+    std::atomic<uint32_t> head;
+    journal_entry_t entries[JOURNAL_CAPACITY];
+} journal_store_t;
+
+static RTC_NOINIT_ATTR journal_store_t store;
+
+static char chunk[JOURNAL_CHUNK_SIZE];
+
+static const char level_letters[] = { 'E', 'W', 'I', 'D' };
+
+// Entries hold pointers into the running image, so retained entries are
+// only trusted after a reset of the very same build.
+void Journal::init() {
+    char image[JOURNAL_IMAGE_LENGTH + 1] = {};
+    esp_ota_get_app_elf_sha256(image, sizeof(image));
+    if (store.magic == JOURNAL_MAGIC && memcmp(store.image, image, sizeof(image)) == 0) {
+        uint32_t retained = store.head.load();
+        JOURNAL_LOGI(LOG_TAG, "Restarted, %u entries retained.",
+            (unsigned)(retained < JOURNAL_CAPACITY ? retained : JOURNAL_CAPACITY));
+        return;
+    }
+    memset((void*)store.entries, 0, sizeof(store.entries));
+    memcpy(store.image, image, sizeof(image));
+    store.head.store(0);
+    store.magic = JOURNAL_MAGIC;
+    JOURNAL_LOGI(LOG_TAG, "Started with an empty journal.");
+}
+
+journal_entry_t* Journal::claim(journal_level_t level, const char* tag, const char* format, uint8_t count, uint32_t& sequence) {
+    sequence = store.head.fetch_add(1, std::memory_order_relaxed);
+    journal_entry_t* entry = &store.entries[sequence % JOURNAL_CAPACITY];
+    entry->sequence = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    entry->timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    entry->tag = tag;
+    entry->format = format;
+    entry->level = level;
+    entry->count = count;
+    entry->text_length = 0;
+    return entry;
+}
+
+void Journal::publish(journal_entry_t* entry, uint32_t sequence) {
+    std::atomic_thread_fence(std::memory_order_release);
+    entry->sequence = sequence + 1;
+}
+
+// Strings are copied because callers often pass buffers that are gone by
+// the time the journal is read. They are truncated to the space left in
+// the entry.
+void Journal::encode(journal_entry_t* entry, size_t index, const char* value) {
+    size_t offset = entry->text_length;
+    size_t available = JOURNAL_TEXT_LENGTH - offset;
+    if (available == 0) {
+        entry->args[index] = JOURNAL_TEXT_LENGTH;
+        return;
+    }
+    size_t length = (value == NULL ? 0 : strnlen(value, available - 1));
+    if (length > 0) {
+        memcpy(entry->text + offset, value, length);
+    }
+    entry->text[offset + length] = '\0';
+    entry->text_length = offset + length + 1;
+    entry->args[index] = offset;
+}
+
+uint32_t Journal::head() {
+    return store.head.load(std::memory_order_acquire);
+}
+
+bool Journal::read(uint32_t sequence, journal_entry_t& entry) {
+    const journal_entry_t& slot = store.entries[sequence % JOURNAL_CAPACITY];
+    if (slot.sequence != sequence + 1) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    memcpy((void*)&entry, (const void*)&slot, sizeof(entry));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence == sequence + 1;
+}
+
+// Formats the entry one conversion at a time, so each raw argument is
+// handed to snprintf with the type its conversion expects.
+size_t Journal::render(const journal_entry_t& entry, char* buffer, size_t size) {
+
+    size_t length = 0;
+    auto emit = [&](int written) {
+        if (written > 0) {
+            length += written;
+            if (length >= size) {
+                length = size - 1;
+            }
+        }
+    };
+
+    emit(snprintf(buffer, size, "%u %u.%03u %c %s: ", (unsigned)(entry.sequence - 1),
+        (unsigned)(entry.timestamp_ms / 1000), (unsigned)(entry.timestamp_ms % 1000),
+        entry.level < sizeof(level_letters) ? level_letters[entry.level] : '?', entry.tag));
+
+    size_t index = 0;
+    const char* cursor = entry.format;
+    while (*cursor != '\0' && length + 1 < size) {
+
+        if (*cursor != '%') {
+            buffer[length++] = *cursor++;
+            continue;
+        }
+        if (cursor[1] == '%') {
+            buffer[length++] = '%';
+            cursor += 2;
+            continue;
+        }
+
+        char spec[16];
+        size_t spec_length = 0;
+        int longs = 0;
+        spec[spec_length++] = *cursor++;
+        while (*cursor != '\0' && strchr("-+ #0123456789.hljzt", *cursor) != NULL && spec_length < sizeof(spec) - 2) {
+            if (*cursor == 'l' || *cursor == 'j') {
+                longs += (*cursor == 'j' ? 2 : 1);
+            }
+            spec[spec_length++] = *cursor++;
+        }
+        char conversion = *cursor;
+        if (conversion == '\0') {
+            break;
+        }
+        spec[spec_length++] = conversion;
+        spec[spec_length] = '\0';
+        cursor++;
+
+        if (index >= entry.count) {
+            emit(snprintf(buffer + length, size - length, "?"));
+            continue;
+        }
+        uint64_t raw = entry.args[index++];
+        char* out = buffer + length;
+        size_t left = size - length;
+
+        switch (conversion) {
+            case 'd': case 'i':
+                emit(longs >= 2 ? snprintf(out, left, spec, (long long)raw) :
+                     longs == 1 ? snprintf(out, left, spec, (long)raw) :
+                                  snprintf(out, left, spec, (int)raw));
+                break;
+            case 'u': case 'x': case 'X': case 'o':
+                emit(longs >= 2 ? snprintf(out, left, spec, (unsigned long long)raw) :
+                     longs == 1 ? snprintf(out, left, spec, (unsigned long)raw) :
+                                  snprintf(out, left, spec, (unsigned)raw));
+                break;
+            case 'c':
+                emit(snprintf(out, left, spec, (int)raw));
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                double number;
+                memcpy(&number, &raw, sizeof(number));
+                emit(snprintf(out, left, spec, number));
+                break;
+            }
+            case 's':
+                emit(snprintf(out, left, spec, raw < entry.text_length ? entry.text + raw : ""));
+                break;
+            case 'p':
+                emit(snprintf(out, left, spec, (void*)(uintptr_t)raw));
+                break;
+            default:
+                emit(snprintf(out, left, "%s", spec));
+                break;
+        }
+    }
+
+    buffer[length] = '\0';
+    return length;
+
+}
+
+esp_err_t Journal::export_text(httpd_req_t* request, uint32_t since) {
+
+    uint32_t head = Journal::head();
+    uint32_t first = (head > JOURNAL_CAPACITY ? head - JOURNAL_CAPACITY : 0);
+    if (since > first) {
+        first = since;
+    }
+
+    size_t used = 0;
+    journal_entry_t entry;
+    char line[JOURNAL_LINE_LENGTH];
+    for (uint32_t sequence = first; sequence < head; sequence++) {
+        if (!Journal::read(sequence, entry)) {
+            continue;
+        }
+        size_t length = Journal::render(entry, line, sizeof(line) - 1);
+        line[length++] = '\n';
+        if (used + length > sizeof(chunk)) {
+            if (httpd_resp_send_chunk(request, chunk, used) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            used = 0;
+        }
+        memcpy(chunk + used, line, length);
+        used += length;
+    }
+    if (used > 0 && httpd_resp_send_chunk(request, chunk, used) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(request, NULL, 0);
+
+}
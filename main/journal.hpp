@@ -0,0 +1,109 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#define JOURNAL_CAPACITY        48
+#define JOURNAL_MAX_ARGS        6
+#define JOURNAL_TEXT_LENGTH     16
+#define JOURNAL_LINE_LENGTH     160
+#define JOURNAL_CHUNK_SIZE      512
+#define JOURNAL_MAGIC           0x4C4E524A
+
+// Levels above the project log level compile out like ESP_LOGx calls.
+// CONFIG_LOG_DEFAULT_LEVEL counts from ESP_LOG_NONE, journal levels
+// from JOURNAL_ERROR.
+#ifdef CONFIG_LOG_DEFAULT_LEVEL
+#define JOURNAL_LEVEL           CONFIG_LOG_DEFAULT_LEVEL
+#else
+#define JOURNAL_LEVEL           3
+#endif
+
+#define JOURNAL_ENABLED(level) ((level) < JOURNAL_LEVEL)
+#define JOURNAL_LOG(level, tag, format, ...) \
+    do { if (JOURNAL_ENABLED(level)) Journal::record(level, tag, format, ##__VA_ARGS__); } while (0)
+
+#define JOURNAL_LOGE(tag, format, ...) JOURNAL_LOG(JOURNAL_ERROR, tag, format, ##__VA_ARGS__)
+#define JOURNAL_LOGW(tag, format, ...) JOURNAL_LOG(JOURNAL_WARN, tag, format, ##__VA_ARGS__)
+#define JOURNAL_LOGI(tag, format, ...) JOURNAL_LOG(JOURNAL_INFO, tag, format, ##__VA_ARGS__)
+#define JOURNAL_LOGD(tag, format, ...) JOURNAL_LOG(JOURNAL_DEBUG, tag, format, ##__VA_ARGS__)
+
+typedef enum {
+    JOURNAL_ERROR,
+    JOURNAL_WARN,
+    JOURNAL_INFO,
+    JOURNAL_DEBUG,
+} journal_level_t;
+
+// One deferred log call. Tag and format are pointers into flash; string
+// arguments are copied into text, everything else is kept as raw bits
+// and only formatted when the entry is read.
+typedef struct {
+    volatile uint32_t sequence;
+    uint32_t timestamp_ms;
+    const char* tag;
+    const char* format;
+    uint8_t level;
+    uint8_t count;
+    uint8_t text_length;
+    uint64_t args[JOURNAL_MAX_ARGS];
+    char text[JOURNAL_TEXT_LENGTH];
+} journal_entry_t;
+
+// Deferred logging backend. record() claims a slot with one atomic
+// increment and stores the call's arguments; nothing is formatted until
+// the journal is read at /logs. The ring lives in RTC memory that is not
+// cleared on reset, so entries from before a crash or watchdog reset are
+// still readable after the restart, as long as the firmware image did
+// not change.
+class Journal {
+    static journal_entry_t* claim(journal_level_t level, const char* tag, const char* format, uint8_t count, uint32_t& sequence);
+    static void publish(journal_entry_t* entry, uint32_t sequence);
+
+    template <typename T>
+    static void encode(journal_entry_t* entry, size_t index, T value) {
+        if constexpr (std::is_floating_point<T>::value) {
+            double number = value;
+            memcpy(&entry->args[index], &number, sizeof(number));
+        } else if constexpr (std::is_pointer<T>::value) {
+            entry->args[index] = (uintptr_t)value;
+        } else if constexpr (std::is_signed<T>::value) {
+            entry->args[index] = (uint64_t)(int64_t)value;
+        } else {
+            entry->args[index] = (uint64_t)value;
+        }
+    }
+
+    static void encode(journal_entry_t* entry, size_t index, const char* value);
+    static void encode(journal_entry_t* entry, size_t index, char* value) {
+        Journal::encode(entry, index, (const char*)value);
+    }
+
+public:
+    static void init();
+
+    template <typename... Args>
+    static void record(journal_level_t level, const char* tag, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= JOURNAL_MAX_ARGS, "Too many arguments for a journal entry");
+        uint32_t sequence;
+        journal_entry_t* entry = Journal::claim(level, tag, format, sizeof...(Args), sequence);
+        size_t index = 0;
+        (Journal::encode(entry, index++, args), ...);
+        (void)index;
+        Journal::publish(entry, sequence);
+    }
+
+    static uint32_t head();
+    static bool read(uint32_t sequence, journal_entry_t& entry);
+    static size_t render(const journal_entry_t& entry, char* buffer, size_t size);
+    static esp_err_t export_text(httpd_req_t* request, uint32_t since);
+};
+
+#endif
@@ -1,92 +1,255 @@
 #include "json.hpp"
 
-#include <cstring>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
 
-JSON::JSON() {
-    this->empty = true;
+JSON::JSON(char* buffer, size_t size, bool pretty) {
+    this->request = nullptr;
+    this->buffer = buffer;
+    this->capacity = (size > 0 ? size - 1 : 0);
+    this->position = 0;
+    this->written = 0;
+    this->pretty = pretty;
+    this->failed = (buffer == nullptr || size == 0);
     this->finalized = false;
-    this->json_string = "{";
+    this->enclosing = nullptr;
+    this->depth = 1;
+    this->populated[0] = false;
+    this->put('{');
 }
 
-std::string JSON::simple_response(bool success, std::string message) {
-    return JSON()
+JSON::JSON(httpd_req_t* request, bool pretty) : JSON(request, nullptr, pretty) {}
+
+// Command handlers pass their query along, so a result embedded by a
+// batch lands inside the enclosing response.
+JSON::JSON(httpd_req_t* request, Query& query, bool pretty) : JSON(request, query.embedded(), pretty) {}
+
+JSON::JSON(httpd_req_t* request, json_embed_t* enclosing, bool pretty) {
+    this->request = request;
+    this->buffer = this->chunk;
+    this->capacity = JSON_CHUNK_SIZE;
+    this->position = 0;
+    this->written = 0;
+    this->pretty = pretty;
+    this->failed = false;
+    this->finalized = false;
+    this->enclosing = enclosing;
+    this->depth = 1;
+    this->populated[0] = false;
+    if (this->enclosing != nullptr) {
+        this->write(this->enclosing->prefix);
+        this->enclosing->written = true;
+    }
+    this->put('{');
+}
+
+bool JSON::simple_response(httpd_req_t* request, bool success, std::string_view message) {
+    return JSON(request)
+        .add_bool("success", success)
+        .add_string("message", message)
+        .finalize();
+}
+
+bool JSON::simple_response(httpd_req_t* request, Query& query, bool success, std::string_view message) {
+    return JSON(request, query)
         .add_bool("success", success)
         .add_string("message", message)
         .finalize();
 }
 
-void JSON::escape(std::string &value) {
-    const char* escape_chars = "\\\"";
-    for (int i = 0; i < strlen(escape_chars); i++) {
-        const char escape_char = escape_chars[i];
-        size_t pos = value.find(escape_char);
-        while (pos != std::string::npos) {
-            value.insert(pos, "\\");
-            pos = value.find(escape_char, pos + 2);
+bool JSON::flush() {
+    if (this->request == nullptr || this->position == 0) {
+        return true;
+    }
+    if (httpd_resp_send_chunk(this->request, this->buffer, this->position) != ESP_OK) {
+        this->failed = true;
+    }
+    this->position = 0;
+    return !this->failed;
+}
+
+void JSON::put(char value) {
+    if (this->failed) {
+        return;
+    }
+    if (this->position == this->capacity) {
+        if (this->request == nullptr) {
+            this->failed = true;
+            return;
         }
+        if (!this->flush()) {
+            return;
+        }
+    }
+    this->buffer[this->position++] = value;
+    this->written++;
+}
+
+void JSON::write(std::string_view value) {
+    for (char current : value) {
+        this->put(current);
     }
 }
 
-void JSON::indent(std::string &value) {
-    size_t pos = value.find('\n');
-    while (pos != std::string::npos) {
-        value.insert(pos + 1, "\t");
-        pos = value.find('\n', pos + 2);
+void JSON::escape(std::string_view value) {
+    static const char* hex = "0123456789abcdef";
+    for (char current : value) {
+        switch (current) {
+            case '"':  this->write("\\\""); break;
+            case '\\': this->write("\\\\"); break;
+            case '\n': this->write("\\n"); break;
+            case '\r': this->write("\\r"); break;
+            case '\t': this->write("\\t"); break;
+            default:
+                if (static_cast<unsigned char>(current) < 0x20) {
+                    this->write("\\u00");
+                    this->put(hex[(current >> 4) & 0x0F]);
+                    this->put(hex[current & 0x0F]);
+                } else {
+                    this->put(current);
+                }
+        }
     }
 }
 
-JSON& JSON::add(std::string key, std::string value, bool quotes, bool escape) {
+void JSON::indent() {
+    if (this->pretty) {
+        this->put('\n');
+        for (uint8_t i = 1; i < this->depth; i++) {
+            this->put('\t');
+        }
+    }
+}
+
+JSON& JSON::key(std::string_view key) {
+    bool& populated = this->populated[this->depth - 1];
+    if (populated) {
+        this->put(',');
+    }
+    populated = true;
+    this->depth++;
+    this->indent();
+    this->depth--;
+    this->put('"');
+    this->escape(key);
+    this->write(this->pretty ? "\": " : "\":");
+    return *this;
+}
+
+JSON& JSON::number(std::string_view key, const char* format, ...) {
     if (this->finalized) {
         return *this;
     }
-    this->empty = false;
-    if (escape) {
-        this->escape(key);
-        this->escape(value);
+    char value[32];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(value, sizeof(value), format, args);
+    va_end(args);
+    this->key(key);
+    if (length < 0 || static_cast<size_t>(length) >= sizeof(value)) {
+        this->failed = true;
+        return *this;
     }
-    std::string quot = (quotes ? "\"" : "");
-    this->json_string += "\n\t\"" + key + "\": " + quot + value + quot + ",";
+    this->write(std::string_view(value, length));
     return *this;
 }
 
-JSON& JSON::add_json(std::string key, JSON json) {
-    std::string value = json.finalize();
-    this->indent(value);
-    return this->add(key, value, false, false);
+JSON& JSON::add_bool(std::string_view key, bool value) {
+    if (!this->finalized) {
+        if (this->enclosing != nullptr && this->depth == 1 && key == "success") {
+            this->enclosing->success = value;
+        }
+        this->key(key).write(value ? "true" : "false");
+    }
+    return *this;
+}
+
+JSON& JSON::add_int(std::string_view key, int value) {
+    return this->number(key, "%d", value);
 }
 
-JSON& JSON::add_bool(std::string key, bool value) {
-    return this->add(key, (value ? "true" : "false"), false, true);
+JSON& JSON::add_uint(std::string_view key, uint32_t value) {
+    return this->number(key, "%u", (unsigned)value);
 }
 
-JSON& JSON::add_int(std::string key, int value) {
-    return this->add(key, std::to_string(value), false, true);
+JSON& JSON::add_float(std::string_view key, float value) {
+    return this->add_double(key, value);
 }
 
-JSON& JSON::add_float(std::string key, float value) {
-    return this->add(key, std::to_string(value), false, true);
+JSON& JSON::add_double(std::string_view key, double value) {
+    if (!std::isfinite(value)) {
+        if (!this->finalized) {
+            this->key(key).write("null");
+        }
+        return *this;
+    }
+    return this->number(key, "%f", value);
 }
 
-JSON& JSON::add_double(std::string key, double value) {
-    return this->add(key, std::to_string(value), false, true);
+JSON& JSON::add_string(std::string_view key, std::string_view value) {
+    if (!this->finalized) {
+        this->key(key).put('"');
+        this->escape(value);
+        this->put('"');
+    }
+    return *this;
+}
+
+JSON& JSON::begin_object(std::string_view key) {
+    if (this->finalized) {
+        return *this;
+    }
+    if (this->depth == JSON_MAX_DEPTH) {
+        this->failed = true;
+        return *this;
+    }
+    this->key(key).put('{');
+    this->populated[this->depth++] = false;
+    return *this;
 }
 
-JSON& JSON::add_string(std::string key, std::string value) {
-    return this->add(key, value, true, true);
+JSON& JSON::end_object() {
+    if (this->finalized || this->depth <= 1) {
+        return *this;
+    }
+    this->indent();
+    this->put('}');
+    this->depth--;
+    return *this;
 }
 
 size_t JSON::length() {
-    return this->json_string.length();
+    return this->written;
 }
 
-std::string JSON::finalize() {
+bool JSON::ok() {
+    return !this->failed;
+}
+
+const char* JSON::c_str() {
+    if (this->request != nullptr || this->failed) {
+        return nullptr;
+    }
+    this->buffer[this->position] = '\0';
+    return this->buffer;
+}
+
+bool JSON::finalize() {
     if (this->finalized) {
-        return this->json_string;
+        return !this->failed;
     }
+    while (this->depth > 1) {
+        this->end_object();
+    }
+    this->indent();
+    this->put('}');
+    this->depth = 0;
     this->finalized = true;
-    if (!this->empty) {
-        this->json_string.erase(this->json_string.length() - 1);
+    if (this->request != nullptr) {
+        if (this->flush() && this->enclosing == nullptr && httpd_resp_send_chunk(this->request, nullptr, 0) != ESP_OK) {
+            this->failed = true;
+        }
     }
-    this->json_string += "\n}";
-    return this->json_string;
-}
\ No newline at end of file
+    return !this->failed;
+}
@@ -1,30 +1,72 @@
 #ifndef JSON_H
 #define JSON_H
 
-#include <string>
+#include "query.hpp"
 
+#include "esp_http_server.h"
+
+#include <string_view>
+
+#define JSON_MAX_DEPTH  8
+#define JSON_CHUNK_SIZE 256
+
+// Response of a handler embedded into an enclosing response, e.g. one
+// result of a /command batch. A writer constructed from a Query carrying
+// it emits prefix before its object, leaves the HTTP response open on
+// finalize() and reports its top-level "success" member back.
+typedef struct json_embed {
+    const char* prefix;
+    bool written;
+    bool success;
+} json_embed_t;
+
+// Streaming JSON writer. Output is either written into a caller-supplied
+// buffer or sent to an HTTP request in chunks of JSON_CHUNK_SIZE bytes,
+// so building a response never touches the heap.
 class JSON {
-    
-    bool empty;
+
+    httpd_req_t* request;
+    char chunk[JSON_CHUNK_SIZE];
+    char* buffer;
+    size_t capacity;
+    size_t position;
+    size_t written;
+    bool pretty;
+    bool failed;
     bool finalized;
-    std::string json_string;
-    JSON& add(std::string key, std::string value, bool quotes, bool escape);
-    void escape(std::string &value);
-    void indent(std::string &value);
+    json_embed_t* enclosing;
+    uint8_t depth;
+    bool populated[JSON_MAX_DEPTH];
+
+    bool flush();
+    void put(char value);
+    void write(std::string_view value);
+    void escape(std::string_view value);
+    void indent();
+    JSON& key(std::string_view key);
+    JSON& number(std::string_view key, const char* format, ...);
+    JSON(httpd_req_t* request, json_embed_t* enclosing, bool pretty);
 
 public:
 
-    JSON();
-    static std::string simple_response(bool success, std::string message);
-    JSON& add_bool(std::string key, bool value);
-    JSON& add_int(std::string key, int value);
-    JSON& add_float(std::string key, float value);
-    JSON& add_double(std::string key, double value);
-    JSON& add_string(std::string key, std::string value);
-    JSON& add_json(std::string key, JSON json);
+    JSON(char* buffer, size_t size, bool pretty = true);
+    JSON(httpd_req_t* request, bool pretty = true);
+    JSON(httpd_req_t* request, Query& query, bool pretty = true);
+    static bool simple_response(httpd_req_t* request, bool success, std::string_view message);
+    static bool simple_response(httpd_req_t* request, Query& query, bool success, std::string_view message);
+    JSON& add_bool(std::string_view key, bool value);
+    JSON& add_int(std::string_view key, int value);
+    JSON& add_uint(std::string_view key, uint32_t value);
+    JSON& add_float(std::string_view key, float value);
+    JSON& add_double(std::string_view key, double value);
+    JSON& add_string(std::string_view key, std::string_view value);
+    JSON& begin_object(std::string_view key);
+    JSON& end_object();
     size_t length();
-    std::string finalize();
+    bool ok();
+    const char* c_str();
+    bool finalize();
 
 };
 
-#endif
\ No newline at end of file
+#endif
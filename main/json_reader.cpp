@@ -0,0 +1,420 @@
+#include "json_reader.hpp"
+#include "query.hpp"
+
+#include "esp_log.h"
+
+#include <cstring>
+
+#define LOG_TAG "json_reader.cpp"
+
+JSONReader::JSONReader(char* buffer, size_t length) {
+    this->buffer = buffer;
+    this->length = length;
+    this->position = 0;
+    this->count = 0;
+    this->result = JSON_READ_OK;
+    if (length > UINT16_MAX) {
+        this->fail(JSON_READ_ERR_TOO_LARGE);
+        return;
+    }
+    this->skip_whitespace();
+    if (!this->parse_value(0)) {
+        return;
+    }
+    this->skip_whitespace();
+    if (this->position != this->length) {
+        this->fail(JSON_READ_ERR_MALFORMED);
+    }
+}
+
+bool JSONReader::fail(json_read_result_t error) {
+    if (this->result == JSON_READ_OK) {
+        this->result = error;
+    }
+    this->count = 0;
+    return false;
+}
+
+void JSONReader::skip_whitespace() {
+    while (this->position < this->length) {
+        char current = this->buffer[this->position];
+        if (current != ' ' && current != '\t' && current != '\r' && current != '\n') {
+            break;
+        }
+        this->position++;
+    }
+}
+
+int JSONReader::allocate(json_token_type_t type) {
+    if (this->count == JSON_READER_MAX_TOKENS) {
+        this->fail(JSON_READ_ERR_TOO_MANY_TOKENS);
+        return -1;
+    }
+    json_token_t& token = this->tokens[this->count];
+    token.type = type;
+    token.start = this->position;
+    token.length = 0;
+    token.size = 0;
+    token.next = this->count + 1;
+    return this->count++;
+}
+
+bool JSONReader::parse_value(size_t depth) {
+    if (this->position >= this->length) {
+        return this->fail(JSON_READ_ERR_MALFORMED);
+    }
+    switch (this->buffer[this->position]) {
+        case '{':   return this->parse_container(depth, true);
+        case '[':   return this->parse_container(depth, false);
+        case '"':   return this->parse_string();
+        case 't':   return this->parse_literal("true", JSON_TOKEN_BOOLEAN);
+        case 'f':   return this->parse_literal("false", JSON_TOKEN_BOOLEAN);
+        case 'n':   return this->parse_literal("null", JSON_TOKEN_NULL);
+        default:    return this->parse_number();
+    }
+}
+
+// Objects alternate key strings and values; both are tokens, so an
+// object member takes two slots and its value subtree follows its key.
+bool JSONReader::parse_container(size_t depth, bool object) {
+    if (depth == JSON_READER_MAX_DEPTH) {
+        return this->fail(JSON_READ_ERR_TOO_DEEP);
+    }
+    int index = this->allocate(object ? JSON_TOKEN_OBJECT : JSON_TOKEN_ARRAY);
+    if (index < 0) {
+        return false;
+    }
+    char close = (object ? '}' : ']');
+    this->position++;
+    this->skip_whitespace();
+    if (this->position < this->length && this->buffer[this->position] == close) {
+        this->position++;
+    } else {
+        while (true) {
+            this->skip_whitespace();
+            if (object) {
+                if (this->position >= this->length || this->buffer[this->position] != '"' || !this->parse_string()) {
+                    return this->fail(JSON_READ_ERR_MALFORMED);
+                }
+                this->skip_whitespace();
+                if (this->position >= this->length || this->buffer[this->position] != ':') {
+                    return this->fail(JSON_READ_ERR_MALFORMED);
+                }
+                this->position++;
+                this->skip_whitespace();
+            }
+            if (!this->parse_value(depth + 1)) {
+                return false;
+            }
+            this->tokens[index].size++;
+            this->skip_whitespace();
+            if (this->position >= this->length) {
+                return this->fail(JSON_READ_ERR_MALFORMED);
+            }
+            char separator = this->buffer[this->position++];
+            if (separator == close) {
+                break;
+            }
+            if (separator != ',') {
+                return this->fail(JSON_READ_ERR_MALFORMED);
+            }
+        }
+    }
+    this->tokens[index].length = this->position - this->tokens[index].start;
+    this->tokens[index].next = this->count;
+    return true;
+}
+
+static size_t encode_utf8(uint32_t code, char* out) {
+    if (code < 0x80) {
+        out[0] = code;
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = 0xC0 | (code >> 6);
+        out[1] = 0x80 | (code & 0x3F);
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = 0xE0 | (code >> 12);
+        out[1] = 0x80 | ((code >> 6) & 0x3F);
+        out[2] = 0x80 | (code & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | (code >> 18);
+    out[1] = 0x80 | ((code >> 12) & 0x3F);
+    out[2] = 0x80 | ((code >> 6) & 0x3F);
+    out[3] = 0x80 | (code & 0x3F);
+    return 4;
+}
+
+bool JSONReader::parse_string() {
+    this->position++;
+    int index = this->allocate(JSON_TOKEN_STRING);
+    if (index < 0) {
+        return false;
+    }
+    // Escapes never decode to more bytes than they occupy, so the decoded
+    // string is written over the raw one as it is read.
+    char* out = this->buffer + this->position;
+    char* start = out;
+    while (this->position < this->length) {
+        char current = this->buffer[this->position++];
+        if (current == '"') {
+            this->tokens[index].length = out - start;
+            return true;
+        }
+        if ((uint8_t)current < 0x20) {
+            return this->fail(JSON_READ_ERR_MALFORMED);
+        }
+        if (current != '\\') {
+            *out++ = current;
+            continue;
+        }
+        if (this->position >= this->length) {
+            break;
+        }
+        char escape = this->buffer[this->position++];
+        switch (escape) {
+            case '"':   *out++ = '"';   continue;
+            case '\\':  *out++ = '\\';  continue;
+            case '/':   *out++ = '/';   continue;
+            case 'b':   *out++ = '\b';  continue;
+            case 'f':   *out++ = '\f';  continue;
+            case 'n':   *out++ = '\n';  continue;
+            case 'r':   *out++ = '\r';  continue;
+            case 't':   *out++ = '\t';  continue;
+            case 'u':   break;
+            default:    return this->fail(JSON_READ_ERR_MALFORMED);
+        }
+        uint32_t code = 0;
+        for (int pair = 0; pair < 2; pair++) {
+            if (this->position + 4 > this->length) {
+                return this->fail(JSON_READ_ERR_MALFORMED);
+            }
+            uint32_t unit = 0;
+            for (int i = 0; i < 4; i++) {
+                int digit = Query::hex_value(this->buffer[this->position++]);
+                if (digit < 0) {
+                    return this->fail(JSON_READ_ERR_MALFORMED);
+                }
+                unit = (unit << 4) | digit;
+            }
+            if (pair == 0 && unit >= 0xD800 && unit < 0xDC00) {
+                // High surrogate, a low one has to follow.
+                if (this->position + 2 > this->length || this->buffer[this->position] != '\\' ||
+                    this->buffer[this->position + 1] != 'u') {
+                    return this->fail(JSON_READ_ERR_MALFORMED);
+                }
+                this->position += 2;
+                code = unit;
+                continue;
+            }
+            if (pair == 1) {
+                if (unit < 0xDC00 || unit >= 0xE000) {
+                    return this->fail(JSON_READ_ERR_MALFORMED);
+                }
+                code = 0x10000 + ((code - 0xD800) << 10) + (unit - 0xDC00);
+            } else if (unit >= 0xDC00 && unit < 0xE000) {
+                return this->fail(JSON_READ_ERR_MALFORMED);
+            } else {
+                code = unit;
+            }
+            break;
+        }
+        out += encode_utf8(code, out);
+    }
+    return this->fail(JSON_READ_ERR_MALFORMED);
+}
+
+bool JSONReader::parse_number() {
+    int index = this->allocate(JSON_TOKEN_NUMBER);
+    if (index < 0) {
+        return false;
+    }
+    const char* text = this->buffer;
+    size_t& at = this->position;
+    auto digits = [&]() {
+        size_t begin = at;
+        while (at < this->length && text[at] >= '0' && text[at] <= '9') {
+            at++;
+        }
+        return at - begin;
+    };
+    if (at < this->length && text[at] == '-') {
+        at++;
+    }
+    size_t integer = digits();
+    if (integer == 0 || (integer > 1 && text[at - integer] == '0')) {
+        return this->fail(JSON_READ_ERR_MALFORMED);
+    }
+    if (at < this->length && text[at] == '.') {
+        at++;
+        if (digits() == 0) {
+            return this->fail(JSON_READ_ERR_MALFORMED);
+        }
+    }
+    if (at < this->length && (text[at] == 'e' || text[at] == 'E')) {
+        at++;
+        if (at < this->length && (text[at] == '+' || text[at] == '-')) {
+            at++;
+        }
+        if (digits() == 0) {
+            return this->fail(JSON_READ_ERR_MALFORMED);
+        }
+    }
+    this->tokens[index].length = at - this->tokens[index].start;
+    return true;
+}
+
+bool JSONReader::parse_literal(const char* literal, json_token_type_t type) {
+    size_t literal_length = strlen(literal);
+    if (this->length - this->position < literal_length ||
+        memcmp(this->buffer + this->position, literal, literal_length) != 0) {
+        return this->fail(JSON_READ_ERR_MALFORMED);
+    }
+    int index = this->allocate(type);
+    if (index < 0) {
+        return false;
+    }
+    this->position += literal_length;
+    this->tokens[index].length = literal_length;
+    return true;
+}
+
+json_read_result_t JSONReader::status() const {
+    return this->result;
+}
+
+bool JSONReader::ok() const {
+    return this->result == JSON_READ_OK;
+}
+
+size_t JSONReader::size() const {
+    return this->count;
+}
+
+const json_token_t& JSONReader::token(int index) const {
+    return this->tokens[index];
+}
+
+std::string_view JSONReader::view(int index) const {
+    if (index < 0 || (size_t)index >= this->count) {
+        return std::string_view();
+    }
+    return std::string_view(this->buffer + this->tokens[index].start, this->tokens[index].length);
+}
+
+// Index of the value stored under key in object, or -1.
+int JSONReader::find(int object, std::string_view key) const {
+    if (object < 0 || (size_t)object >= this->count || this->tokens[object].type != JSON_TOKEN_OBJECT) {
+        return -1;
+    }
+    int index = object + 1;
+    for (uint16_t member = 0; member < this->tokens[object].size; member++) {
+        if (this->view(index) == key) {
+            return index + 1;
+        }
+        index = this->tokens[index + 1].next;
+    }
+    return -1;
+}
+
+bool JSONReader::get_string(int object, std::string_view key, std::string_view& out) const {
+    int index = this->find(object, key);
+    if (index < 0 || this->tokens[index].type != JSON_TOKEN_STRING) {
+        return false;
+    }
+    out = this->view(index);
+    return true;
+}
+
+bool JSONReader::to_int(int index, int64_t& out) const {
+    if (index < 0 || (size_t)index >= this->count || this->tokens[index].type != JSON_TOKEN_NUMBER) {
+        return false;
+    }
+    std::string_view text = this->view(index);
+    bool negative = (text[0] == '-');
+    uint64_t value = 0;
+    for (size_t i = (negative ? 1 : 0); i < text.length(); i++) {
+        if (text[i] < '0' || text[i] > '9' || value > (uint64_t)INT64_MAX / 10) {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    if (value > (uint64_t)INT64_MAX) {
+        return false;
+    }
+    out = (negative ? -(int64_t)value : (int64_t)value);
+    return true;
+}
+
+bool JSONReader::get_int(int object, std::string_view key, int64_t& out) const {
+    return this->to_int(this->find(object, key), out);
+}
+
+bool JSONReader::get_uint(int object, std::string_view key, uint32_t& out) const {
+    int64_t value;
+    if (!this->get_int(object, key, value) || value < 0 || value > UINT32_MAX) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+bool JSONReader::get_bool(int object, std::string_view key, bool& out) const {
+    int index = this->find(object, key);
+    if (index < 0 || this->tokens[index].type != JSON_TOKEN_BOOLEAN) {
+        return false;
+    }
+    out = (this->view(index) == "true");
+    return true;
+}
+
+bool JSONReader::is_json(httpd_req_t* request) {
+    char type[32] = {};
+    esp_err_t found = httpd_req_get_hdr_value_str(request, "Content-Type", type, sizeof(type));
+    if (found != ESP_OK && found != ESP_ERR_HTTPD_RESULT_TRUNC) {
+        return false;
+    }
+    return strncmp(type, "application/json", 16) == 0;
+}
+
+// Reads the whole body into buffer; bodies that do not fit are refused
+// before anything is received.
+json_read_result_t JSONReader::receive(httpd_req_t* request, char* buffer, size_t size, size_t& length) {
+    size_t remaining = request->content_len;
+    if (remaining > size || remaining > JSON_READER_MAX_LENGTH) {
+        ESP_LOGW(LOG_TAG, "Receive: Body of %u bytes exceeds limit.", (unsigned)remaining);
+        return JSON_READ_ERR_TOO_LARGE;
+    }
+    length = 0;
+    uint8_t retries = 0;
+    while (remaining > 0) {
+        int received = httpd_req_recv(request, buffer + length, remaining);
+        if (received == HTTPD_SOCK_ERR_TIMEOUT && retries < JSON_READER_RECV_RETRIES) {
+            retries++;
+            continue;
+        }
+        if (received <= 0) {
+            return (received == HTTPD_SOCK_ERR_TIMEOUT ? JSON_READ_ERR_TIMEOUT : JSON_READ_ERR_RECV);
+        }
+        retries = 0;
+        length += received;
+        remaining -= received;
+    }
+    return JSON_READ_OK;
+}
+
+const char* JSONReader::describe(json_read_result_t result) {
+    switch (result) {
+        case JSON_READ_OK:                  return "OK";
+        case JSON_READ_ERR_RECV:            return "Failed receiving request body!";
+        case JSON_READ_ERR_TIMEOUT:         return "Timed out receiving request body!";
+        case JSON_READ_ERR_TOO_LARGE:       return "Request body too large!";
+        case JSON_READ_ERR_MALFORMED:       return "Malformed JSON!";
+        case JSON_READ_ERR_TOO_DEEP:        return "JSON nested too deeply!";
+        case JSON_READ_ERR_TOO_MANY_TOKENS: return "JSON has too many values!";
+    }
+    return "Unknown error!";
+}
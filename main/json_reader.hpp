@@ -0,0 +1,88 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include "esp_http_server.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#define JSON_READER_MAX_TOKENS  32
+#define JSON_READER_MAX_DEPTH   8
+#define JSON_READER_MAX_LENGTH  1024
+#define JSON_READER_RECV_RETRIES 3
+#define JSON_READER_ROOT        0
+
+typedef enum {
+    JSON_TOKEN_OBJECT,
+    JSON_TOKEN_ARRAY,
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_NUMBER,
+    JSON_TOKEN_BOOLEAN,
+    JSON_TOKEN_NULL,
+} json_token_type_t;
+
+typedef enum {
+    JSON_READ_OK = 0,
+    JSON_READ_ERR_RECV,
+    JSON_READ_ERR_TIMEOUT,
+    JSON_READ_ERR_TOO_LARGE,
+    JSON_READ_ERR_MALFORMED,
+    JSON_READ_ERR_TOO_DEEP,
+    JSON_READ_ERR_TOO_MANY_TOKENS,
+} json_read_result_t;
+
+// A value in the parsed buffer. Strings are unescaped in place, so every
+// token is a plain view [start, start + length). size is the number of
+// members or elements of a container; next is the index of the first
+// token after this one's subtree.
+typedef struct {
+    uint8_t type;
+    uint16_t start;
+    uint16_t length;
+    uint16_t size;
+    uint16_t next;
+} json_token_t;
+
+// In-situ JSON tokenizer in the spirit of jsmn. The caller's buffer is
+// tokenized once on construction; lookups return views into it and never
+// allocate. Depth and token count are capped so hostile bodies cannot
+// exhaust the httpd task.
+class JSONReader {
+    char* buffer;
+    size_t length;
+    size_t position;
+    json_token_t tokens[JSON_READER_MAX_TOKENS];
+    size_t count;
+    json_read_result_t result;
+
+    void skip_whitespace();
+    int allocate(json_token_type_t type);
+    bool parse_value(size_t depth);
+    bool parse_container(size_t depth, bool object);
+    bool parse_string();
+    bool parse_number();
+    bool parse_literal(const char* literal, json_token_type_t type);
+    bool fail(json_read_result_t error);
+
+public:
+    JSONReader(char* buffer, size_t length);
+    json_read_result_t status() const;
+    bool ok() const;
+    size_t size() const;
+    const json_token_t& token(int index) const;
+
+    std::string_view view(int index) const;
+    int find(int object, std::string_view key) const;
+    bool get_string(int object, std::string_view key, std::string_view& out) const;
+    bool get_int(int object, std::string_view key, int64_t& out) const;
+    bool get_uint(int object, std::string_view key, uint32_t& out) const;
+    bool get_bool(int object, std::string_view key, bool& out) const;
+    bool to_int(int index, int64_t& out) const;
+
+    static bool is_json(httpd_req_t* request);
+    static json_read_result_t receive(httpd_req_t* request, char* buffer, size_t size, size_t& length);
+    static const char* describe(json_read_result_t result);
+};
+
+#endif
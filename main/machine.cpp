@@ -0,0 +1,164 @@
+#include "machine.hpp"
+
+#include "esp_log.h"
+
+#define LOG_TAG "machine.cpp"
+
+Machine::Machine(IOHal& hal) : hal(hal) {
+    this->state = MACHINE_IDLE;
+    this->entered = hal.now();
+    this->heater = false;
+    this->water = true;
+}
+
+void Machine::transition(machine_state_t next) {
+    if (next == this->state) {
+        return;
+    }
+    ESP_LOGI(LOG_TAG, "Transition: %s -> %s", Machine::describe(this->state), Machine::describe(next));
+    this->state = next;
+    this->entered = this->hal.now();
+}
+
+// After brewing or descaling the machine reheats; it is ready again once
+// the heater switches off.
+void Machine::finish_cycle() {
+    this->transition(this->heater ? MACHINE_HEATING : MACHINE_READY);
+}
+
+bool Machine::powered() {
+    return this->state != MACHINE_IDLE;
+}
+
+bool Machine::handle(const io_event_t& event) {
+    machine_state_t previous = this->state;
+    switch (event.type) {
+
+        case IO_EVENT_BUTTON:
+            if (event.source == IO_BUTTON_POWER) {
+                this->transition(this->powered() ? MACHINE_IDLE : MACHINE_HEATING);
+            } else if (this->state == MACHINE_READY && this->water) {
+                this->transition(event.source == IO_BUTTON_ONE_CUP ? MACHINE_BREWING_ONE : MACHINE_BREWING_TWO);
+            }
+            break;
+
+        case IO_EVENT_HEATER:
+            this->heater = event.level;
+            if (this->heater && this->state == MACHINE_IDLE) {
+                this->transition(MACHINE_HEATING);
+            } else if (!this->heater && this->state == MACHINE_HEATING) {
+                this->transition(MACHINE_READY);
+            }
+            break;
+
+        case IO_EVENT_WATER:
+            this->water = event.level;
+            if (!this->water && this->powered()) {
+                this->transition(MACHINE_ERROR);
+            } else if (this->water && this->state == MACHINE_ERROR) {
+                this->finish_cycle();
+            }
+            break;
+
+        case IO_EVENT_COMMAND:
+            this->command(static_cast<machine_command_t>(event.source));
+            break;
+
+    }
+    return this->state != previous;
+}
+
+bool Machine::command(machine_command_t command) {
+    switch (command) {
+
+        case MACHINE_POWER_ON:
+            if (this->powered() || !this->hal.press(IO_BUTTON_MASK(IO_BUTTON_POWER), MACHINE_PRESS_US)) {
+                return false;
+            }
+            this->transition(MACHINE_HEATING);
+            return true;
+
+        case MACHINE_POWER_OFF:
+            if (!this->powered() || !this->hal.press(IO_BUTTON_MASK(IO_BUTTON_POWER), MACHINE_PRESS_US)) {
+                return false;
+            }
+            this->transition(MACHINE_IDLE);
+            return true;
+
+        case MACHINE_BREW_ONE:
+        case MACHINE_BREW_TWO: {
+            bool one = (command == MACHINE_BREW_ONE);
+            io_button_t button = (one ? IO_BUTTON_ONE_CUP : IO_BUTTON_TWO_CUP);
+            if (this->state != MACHINE_READY || !this->water ||
+                !this->hal.press(IO_BUTTON_MASK(button), MACHINE_PRESS_US)) {
+                return false;
+            }
+            this->transition(one ? MACHINE_BREWING_ONE : MACHINE_BREWING_TWO);
+            return true;
+        }
+
+        case MACHINE_DESCALE:
+            if (this->state != MACHINE_READY || !this->water ||
+                !this->hal.press(IO_BUTTON_MASK(IO_BUTTON_ONE_CUP) | IO_BUTTON_MASK(IO_BUTTON_TWO_CUP),
+                                 MACHINE_DESCALE_PRESS_US)) {
+                return false;
+            }
+            this->transition(MACHINE_DESCALING);
+            return true;
+
+    }
+    return false;
+}
+
+int64_t Machine::deadline() {
+    switch (this->state) {
+        case MACHINE_HEATING:       return this->entered + MACHINE_HEAT_TIMEOUT_US;
+        case MACHINE_BREWING_ONE:   return this->entered + MACHINE_BREW_ONE_CUP_US;
+        case MACHINE_BREWING_TWO:   return this->entered + MACHINE_BREW_TWO_CUP_US;
+        case MACHINE_DESCALING:     return this->entered + MACHINE_DESCALE_US;
+        default:                    return 0;
+    }
+}
+
+bool Machine::expire() {
+    int64_t deadline = this->deadline();
+    if (deadline == 0 || this->hal.now() < deadline) {
+        return false;
+    }
+    if (this->state == MACHINE_HEATING) {
+        ESP_LOGW(LOG_TAG, "Expire: Heater did not reach temperature in time!");
+        this->transition(MACHINE_ERROR);
+    } else {
+        this->finish_cycle();
+    }
+    return true;
+}
+
+machine_state_t Machine::get_state() {
+    return this->state;
+}
+
+int64_t Machine::get_entered() {
+    return this->entered;
+}
+
+bool Machine::get_heater() {
+    return this->heater;
+}
+
+bool Machine::get_water() {
+    return this->water;
+}
+
+const char* Machine::describe(machine_state_t state) {
+    switch (state) {
+        case MACHINE_IDLE:          return "idle";
+        case MACHINE_HEATING:       return "heating";
+        case MACHINE_READY:         return "ready";
+        case MACHINE_BREWING_ONE:   return "brewing_one";
+        case MACHINE_BREWING_TWO:   return "brewing_two";
+        case MACHINE_DESCALING:     return "descaling";
+        case MACHINE_ERROR:         return "error";
+    }
+    return "unknown";
+}
@@ -0,0 +1,76 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "io_hal.hpp"
+
+#include <cstdint>
+
+#define MACHINE_PRESS_US            150000
+#define MACHINE_DESCALE_PRESS_US    3000000
+#define MACHINE_HEAT_TIMEOUT_US     (180 * 1000000LL)
+#define MACHINE_BREW_ONE_CUP_US     (35 * 1000000LL)
+#define MACHINE_BREW_TWO_CUP_US     (65 * 1000000LL)
+#define MACHINE_DESCALE_US          (600 * 1000000LL)
+
+typedef enum {
+    MACHINE_IDLE,
+    MACHINE_HEATING,
+    MACHINE_READY,
+    MACHINE_BREWING_ONE,
+    MACHINE_BREWING_TWO,
+    MACHINE_DESCALING,
+    MACHINE_ERROR,
+} machine_state_t;
+
+typedef enum {
+    MACHINE_POWER_ON,
+    MACHINE_POWER_OFF,
+    MACHINE_BREW_ONE,
+    MACHINE_BREW_TWO,
+    MACHINE_DESCALE,
+} machine_command_t;
+
+typedef enum {
+    IO_EVENT_BUTTON,
+    IO_EVENT_HEATER,
+    IO_EVENT_WATER,
+    IO_EVENT_COMMAND,
+} io_event_type_t;
+
+// Input to the state machine. Button events carry the button in source
+// and are only sent for presses; heater and water events carry the new
+// sense level (heater on, water present). timestamp is the time of the
+// edge, taken in the ISR.
+typedef struct {
+    io_event_type_t type;
+    uint8_t source;
+    bool level;
+    int64_t timestamp;
+} io_event_t;
+
+// Deterministic model of the Senseo front panel. All state changes happen
+// in handle(), command() and expire(), driven by the caller; buttons are
+// pressed through the HAL.
+class Machine {
+    IOHal& hal;
+    machine_state_t state;
+    int64_t entered;
+    bool heater;
+    bool water;
+    void transition(machine_state_t next);
+    void finish_cycle();
+    bool powered();
+public:
+    Machine(IOHal& hal);
+    bool handle(const io_event_t& event);
+    bool command(machine_command_t command);
+    bool expire();
+    int64_t deadline();
+    machine_state_t get_state();
+    int64_t get_entered();
+    bool get_heater();
+    bool get_water();
+    static const char* describe(machine_state_t state);
+};
+
+#endif
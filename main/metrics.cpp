@@ -0,0 +1,200 @@
+#include "metrics.hpp"
+#include "netconfig.hpp"
+#include "counters.hpp"
+
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include "lwip/sockets.h"
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+
+#define LOG_TAG "metrics.cpp"
+
+// Upper bucket bounds in microseconds, with their Prometheus labels in
+// seconds.
+static const uint32_t bucket_bounds[METRICS_BUCKET_COUNT] = {
+    500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+
+static const char* const bucket_labels[METRICS_BUCKET_COUNT] = {
+    "0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "1"
+};
+
+static metrics_route_t routes[METRICS_MAX_ROUTES];
+static size_t route_count = 0;
+static metrics_route_t* current = NULL;
+
+static char chunk[METRICS_CHUNK_SIZE];
+static size_t chunk_length = 0;
+static bool chunk_failed = false;
+
+// Replaces the default send function of plain HTTP sessions so bytes
+// written on behalf of a route are attributed to it. Mirrors the error
+// mapping of the default implementation.
+static int counting_send(httpd_handle_t server, int fd, const char* buffer, size_t length, int flags) {
+    int sent = send(fd, buffer, length, flags);
+    if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return HTTPD_SOCK_ERR_TIMEOUT;
+        }
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+    if (current != NULL) {
+        current->bytes += sent;
+    }
+    return sent;
+}
+
+static esp_err_t trampoline(httpd_req_t* request) {
+    metrics_route_t* route = static_cast<metrics_route_t*>(request->user_ctx);
+    request->user_ctx = route->context;
+    if (!route->websocket) {
+        httpd_sess_set_send_override(request->handle, httpd_req_to_sockfd(request), counting_send);
+    }
+
+    current = route;
+    int64_t started = esp_timer_get_time();
+    esp_err_t result = route->handler(request);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - started);
+    current = NULL;
+
+    route->count++;
+    route->total_us += elapsed;
+    if (result != ESP_OK) {
+        route->errors++;
+    }
+    for (int i = 0; i < METRICS_BUCKET_COUNT; i++) {
+        if (elapsed <= bucket_bounds[i]) {
+            route->buckets[i]++;
+            break;
+        }
+    }
+    return result;
+}
+
+bool Metrics::wrap(httpd_uri_t* uri) {
+    if (uri->handler == trampoline) {
+        return true;
+    }
+    if (route_count == METRICS_MAX_ROUTES) {
+        ESP_LOGW(LOG_TAG, "Wrap: No slot left for '%s', serving it uninstrumented.", uri->uri);
+        return false;
+    }
+    metrics_route_t& route = routes[route_count++];
+    route = {};
+    route.uri = uri->uri;
+    route.method = uri->method;
+    route.handler = uri->handler;
+    route.context = uri->user_ctx;
+    route.websocket = uri->is_websocket;
+    uri->handler = trampoline;
+    uri->user_ctx = &route;
+    return true;
+}
+
+static void flush(httpd_req_t* request) {
+    if (!chunk_failed && chunk_length > 0 &&
+        httpd_resp_send_chunk(request, chunk, chunk_length) != ESP_OK) {
+        chunk_failed = true;
+    }
+    chunk_length = 0;
+}
+
+// Appends one formatted line to the chunk buffer, sending the buffer
+// first if the line does not fit.
+static void append(httpd_req_t* request, const char* format, ...) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_list arguments;
+        va_start(arguments, format);
+        int length = vsnprintf(chunk + chunk_length, sizeof(chunk) - chunk_length, format, arguments);
+        va_end(arguments);
+        if (length >= 0 && chunk_length + length < sizeof(chunk)) {
+            chunk_length += length;
+            return;
+        }
+        flush(request);
+    }
+    ESP_LOGW(LOG_TAG, "Render: Line longer than %d bytes dropped.", METRICS_CHUNK_SIZE);
+}
+
+static const char* method_name(httpd_method_t method) {
+    switch (method) {
+        case HTTP_GET:      return "GET";
+        case HTTP_POST:     return "POST";
+        case HTTP_PUT:      return "PUT";
+        case HTTP_DELETE:   return "DELETE";
+        default:            return "OTHER";
+    }
+}
+
+esp_err_t Metrics::handler(httpd_req_t* request) {
+
+    httpd_resp_set_type(request, "text/plain; version=0.0.4");
+    chunk_length = 0;
+    chunk_failed = false;
+
+    append(request, "# HELP http_request_duration_seconds Handler run time per route.\n"
+                    "# TYPE http_request_duration_seconds histogram\n");
+    for (size_t i = 0; i < route_count; i++) {
+        const metrics_route_t& route = routes[i];
+        const char* method = method_name(route.method);
+        uint32_t cumulative = 0;
+        for (int bucket = 0; bucket < METRICS_BUCKET_COUNT; bucket++) {
+            cumulative += route.buckets[bucket];
+            append(request, "http_request_duration_seconds_bucket{route=\"%s\",method=\"%s\",le=\"%s\"} %u\n",
+                route.uri, method, bucket_labels[bucket], (unsigned)cumulative);
+        }
+        append(request, "http_request_duration_seconds_bucket{route=\"%s\",method=\"%s\",le=\"+Inf\"} %u\n"
+                        "http_request_duration_seconds_sum{route=\"%s\",method=\"%s\"} %llu.%06llu\n"
+                        "http_request_duration_seconds_count{route=\"%s\",method=\"%s\"} %u\n",
+            route.uri, method, (unsigned)route.count,
+            route.uri, method, route.total_us / 1000000, route.total_us % 1000000,
+            route.uri, method, (unsigned)route.count);
+    }
+
+    append(request, "# HELP http_request_errors_total Handlers that returned an error.\n"
+                    "# TYPE http_request_errors_total counter\n");
+    for (size_t i = 0; i < route_count; i++) {
+        append(request, "http_request_errors_total{route=\"%s\",method=\"%s\"} %u\n",
+            routes[i].uri, method_name(routes[i].method), (unsigned)routes[i].errors);
+    }
+
+    append(request, "# HELP http_response_bytes_total Bytes written to the socket per route.\n"
+                    "# TYPE http_response_bytes_total counter\n");
+    for (size_t i = 0; i < route_count; i++) {
+        append(request, "http_response_bytes_total{route=\"%s\",method=\"%s\"} %llu\n",
+            routes[i].uri, method_name(routes[i].method), routes[i].bytes);
+    }
+
+    append(request, "# TYPE heap_free_bytes gauge\nheap_free_bytes %u\n"
+                    "# TYPE heap_minimum_free_bytes gauge\nheap_minimum_free_bytes %u\n"
+                    "# TYPE heap_largest_free_block_bytes gauge\nheap_largest_free_block_bytes %u\n"
+                    "# TYPE wifi_reconnects_total counter\nwifi_reconnects_total %u\n"
+                    "# TYPE wifi_roams_total counter\nwifi_roams_total %u\n",
+        (unsigned)esp_get_free_heap_size(),
+        (unsigned)esp_get_minimum_free_heap_size(),
+        (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+        (unsigned)NetConfig::reconnects(),
+        (unsigned)NetConfig::roams());
+
+    append(request, "# HELP usage_total Lifetime usage counters.\n"
+                    "# TYPE usage_total counter\n");
+    for (int counter = 0; counter < COUNTER_COUNT; counter++) {
+        append(request, "usage_total{counter=\"%s\"} %u\n",
+            CounterLog::describe(static_cast<counter_id_t>(counter)),
+            (unsigned)Counters::value(static_cast<counter_id_t>(counter)));
+    }
+    append(request, "# TYPE usage_log_wear_ppm gauge\nusage_log_wear_ppm %u\n", (unsigned)Counters::wear_ppm());
+
+    flush(request);
+    if (chunk_failed || httpd_resp_send_chunk(request, NULL, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+
+}
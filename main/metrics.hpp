@@ -0,0 +1,40 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "esp_http_server.h"
+
+#include <cstdint>
+
+#define METRICS_MAX_ROUTES      16
+#define METRICS_BUCKET_COUNT    10
+#define METRICS_CHUNK_SIZE      1024
+
+typedef struct {
+    const char* uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t* request);
+    void* context;
+    bool websocket;
+    uint32_t count;
+    uint32_t errors;
+    uint64_t bytes;
+    uint64_t total_us;
+    uint32_t buckets[METRICS_BUCKET_COUNT];
+} metrics_route_t;
+
+// Request instrumentation. wrap() swaps a URI's handler for a timing
+// trampoline before it is registered; per-route histograms, error and
+// byte counts are rendered at /metrics in Prometheus text format along
+// with heap and Wi-Fi gauges.
+//
+// All routes are served by the single httpd task, so the counters need
+// no locking. Bytes are only counted on plain HTTP sessions: WebSocket
+// frames are also sent from other tasks, so WebSocket routes are timed
+// but keep the default send function.
+class Metrics {
+public:
+    static bool wrap(httpd_uri_t* uri);
+    static esp_err_t handler(httpd_req_t* request);
+};
+
+#endif
@@ -1,5 +1,10 @@
 #include "netconfig.hpp"
 #include "nvstorage.hpp"
+#include "config.hpp"
+#include "netselect.hpp"
+#include "commands.hpp"
+#include "journal.hpp"
+#include "json.hpp"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -8,6 +13,7 @@
 #include "esp_system.h"
 #include "esp_event.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 
 #include <cstring>
@@ -15,13 +21,214 @@
 #define LOG_TAG "netconfig.cpp"
 
 static int retry_count = 0;
-static EventGroupHandle_t s_wifi_event_group;
+static uint32_t reconnect_count = 0;
+static EventGroupHandle_t s_wifi_event_group = NULL;
+
+static bool wifi_initialized = false;
+static bool wifi_started = false;
+static esp_netif_t* sta_netif = NULL;
+static esp_netif_t* ap_netif = NULL;
+
+static bool fast_path = false;
+static netconfig_timing_t timing = {};
+
+// Station state driven from the event handler: the ranked candidates of
+// the last scan, and whether a scan or an AP switch is in flight.
+static wifi_ap_record_t scan_records[NETCONFIG_SCAN_RECORDS];
+static netselect_candidate_t candidates[NETSELECT_MAX_CANDIDATES];
+static size_t candidate_count = 0;
+static size_t candidate_index = 0;
+static bool station_connected = false;
+static bool scanning = false;
+static bool roaming = false;
+static bool switching = false;
+static uint32_t roam_count = 0;
+
+// Access point and address of the last successful connection, used to
+// skip the all-channel scan on the next connect to the same network.
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_ip4_addr_t ip;
+} netconfig_cache_t;
+
+// Copy of what is stored, so reconnects to the same access point do not
+// touch NVS from the event loop.
+static netconfig_cache_t remembered = {};
+
+static const config_profile_t* load_cache(const Config& config, netconfig_cache_t& cache) {
+    try {
+        NVStorage storage(NETCONFIG_CACHE_NAMESPACE, true);
+        size_t length = sizeof(cache);
+        if (!storage.get_blob(NETCONFIG_CACHE_KEY, &cache, length) || length != sizeof(cache) || cache.channel == 0) {
+            return nullptr;
+        }
+        remembered = cache;
+        return config.find_profile(std::string_view(cache.ssid, strnlen(cache.ssid, sizeof(cache.ssid))));
+    } catch (int error) {
+        return nullptr;
+    }
+}
+
+static void store_cache(const netconfig_cache_t& cache) {
+    if (memcmp(&cache, &remembered, sizeof(cache)) == 0) {
+        return;
+    }
+    try {
+        NVStorage storage(NETCONFIG_CACHE_NAMESPACE, true);
+        if (!storage.set_blob(NETCONFIG_CACHE_KEY, &cache, sizeof(cache))) {
+            ESP_LOGW(LOG_TAG, "Could not store connection cache!");
+            return;
+        }
+        remembered = cache;
+    } catch (int error) {
+        ESP_LOGW(LOG_TAG, "Could not access connection cache!");
+    }
+}
+
+static void clear_cache() {
+    remembered = {};
+    try {
+        NVStorage storage(NETCONFIG_CACHE_NAMESPACE, true);
+        storage.erase_key(NETCONFIG_CACHE_KEY);
+    } catch (int error) {
+        ESP_LOGW(LOG_TAG, "Could not access connection cache!");
+    }
+}
+
+static void remember_connection(const ip_event_got_ip_t* event) {
+    wifi_ap_record_t ap_info;
+    wifi_config_t wireless_cfg;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK ||
+        esp_wifi_get_config(WIFI_IF_STA, &wireless_cfg) != ESP_OK) {
+        return;
+    }
+    netconfig_cache_t cache = {};
+    strncpy(cache.ssid, (const char*)wireless_cfg.sta.ssid, sizeof(cache.ssid) - 1);
+    memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+    cache.channel = ap_info.primary;
+    cache.ip = event->ip_info.ip;
+    store_cache(cache);
+}
+
+static void fill_station(wifi_config_t& wireless_cfg, const config_profile_t& profile, const uint8_t* bssid, uint8_t channel) {
+    wireless_cfg = {};
+    strncpy((char*)wireless_cfg.sta.ssid, profile.ssid, sizeof(wireless_cfg.sta.ssid));
+    strncpy((char*)wireless_cfg.sta.password, profile.psk, sizeof(wireless_cfg.sta.password));
+    wireless_cfg.sta.threshold.authmode = profile.security;
+    wireless_cfg.sta.pmf_cfg.capable = true;
+    wireless_cfg.sta.pmf_cfg.required = false;
+    memcpy(wireless_cfg.sta.bssid, bssid, sizeof(wireless_cfg.sta.bssid));
+    wireless_cfg.sta.bssid_set = true;
+    wireless_cfg.sta.channel = channel;
+    wireless_cfg.sta.scan_method = WIFI_FAST_SCAN;
+}
+
+// Scans are non-blocking; the result is handled on WIFI_EVENT_SCAN_DONE.
+// A roaming scan runs while the current association is kept up.
+static bool start_scan(bool roam) {
+    if (scanning) {
+        return true;
+    }
+    wifi_scan_config_t scan_cfg = {};
+    scan_cfg.show_hidden = false;
+    if (esp_wifi_scan_start(&scan_cfg, false) != ESP_OK) {
+        ESP_LOGW(LOG_TAG, "Could not start scan!");
+        return false;
+    }
+    scanning = true;
+    roaming = roam;
+    return true;
+}
+
+// Points the station at a ranked candidate, pinned to its BSSID and
+// channel so the driver does not scan again.
+static bool select_candidate(size_t index) {
+    Config config;
+    const netselect_candidate_t& candidate = candidates[index];
+    const wifi_ap_record_t& record = scan_records[candidate.record];
+    if (candidate.profile >= config.profile_count()) {
+        return false;
+    }
+    const config_profile_t& profile = config.get_profile(candidate.profile);
+    ESP_LOGI(LOG_TAG, "Selected '%s' at " MACSTR " on channel %u (%d dBm, score %d).",
+        profile.ssid, MAC2STR(record.bssid), record.primary, record.rssi, candidate.score);
+    wifi_config_t wireless_cfg;
+    fill_station(wireless_cfg, profile, record.bssid, record.primary);
+    if (esp_wifi_set_config(WIFI_IF_STA, &wireless_cfg) != ESP_OK) {
+        ESP_LOGW(LOG_TAG, "Could not apply station configuration!");
+        return false;
+    }
+    candidate_index = index;
+    return true;
+}
+
+// A failed directed connect means the cached access point moved or went
+// away; drop the cache and fall back to scanning.
+static void leave_fast_path() {
+    ESP_LOGW(LOG_TAG, "Fast reconnect failed, falling back to full scan...");
+    fast_path = false;
+    timing.fast_path = false;
+    clear_cache();
+}
+
+static void retry_or_fail() {
+    if (NETCONFIG_RECONNECT_ATTEMPTS < 0 || retry_count < NETCONFIG_RECONNECT_ATTEMPTS) {
+        retry_count++;
+        reconnect_count++;
+        start_scan(false);
+    } else {
+        ESP_LOGE(LOG_TAG, "Connection failed!");
+        xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
+    }
+}
+
+static void scan_done() {
+    scanning = false;
+    uint16_t number = NETCONFIG_SCAN_RECORDS;
+    if (esp_wifi_scan_get_ap_records(&number, scan_records) != ESP_OK) {
+        number = 0;
+    }
+    Config config;
+    candidate_count = NetSelect::rank(config, scan_records, number, candidates, NETSELECT_MAX_CANDIDATES);
+    JOURNAL_LOGD(LOG_TAG, "Scan found %u access points, %u usable.", number, candidate_count);
+
+    if (roaming) {
+        roaming = false;
+        wifi_ap_record_t current = {};
+        int target = -1;
+        if (station_connected && esp_wifi_sta_get_ap_info(&current) == ESP_OK) {
+            target = NetSelect::roam_target(current.bssid, current.rssi, scan_records, candidates, candidate_count);
+        }
+        if (target >= 0 && select_candidate(target)) {
+            JOURNAL_LOGI(LOG_TAG, "Roaming away from access point at %d dBm...", current.rssi);
+            switching = true;
+            roam_count++;
+            esp_wifi_disconnect();
+        } else if (station_connected) {
+            esp_wifi_set_rssi_threshold(NETCONFIG_ROAM_RSSI);
+        }
+        return;
+    }
+
+    if (candidate_count == 0) {
+        ESP_LOGW(LOG_TAG, "No configured network in range!");
+        retry_or_fail();
+        return;
+    }
+    if (select_candidate(0)) {
+        esp_wifi_connect();
+    }
+}
 
 static void ap_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
 
-    ESP_LOGD(LOG_TAG, "AP event handler triggered!");
+    if (event_id == WIFI_EVENT_AP_START) {
+        xEventGroupSetBits(s_wifi_event_group, WIFI_AP_STARTED_BIT);
+    }
 
-    if (event_id == WIFI_EVENT_AP_STACONNECTED) {
+    else if (event_id == WIFI_EVENT_AP_STACONNECTED) {
         wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*)event_data;
         ESP_LOGI(LOG_TAG, "Client " MACSTR " joined, AID=%d.", MAC2STR(event->mac), event->aid);
     }
@@ -35,65 +242,252 @@ static void ap_event_handler(void* arg, esp_event_base_t event_base, int32_t eve
 
 static void sta_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
 
-    ESP_LOGD(LOG_TAG, "Station event handler triggered!");
-
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        ESP_LOGI(LOG_TAG, "Connecting to access point...");
-        esp_wifi_connect();
+        timing.started = esp_timer_get_time();
+        if (fast_path) {
+            JOURNAL_LOGI(LOG_TAG, "Connecting to access point...");
+            esp_wifi_connect();
+        } else {
+            JOURNAL_LOGI(LOG_TAG, "Scanning for configured networks...");
+            start_scan(false);
+        }
+    }
+
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        scan_done();
+    }
+
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_BSS_RSSI_LOW) {
+        wifi_event_bss_rssi_low_t* event = (wifi_event_bss_rssi_low_t*)event_data;
+        JOURNAL_LOGI(LOG_TAG, "Signal dropped to %d dBm, looking for a better access point...", (int)event->rssi);
+        start_scan(true);
+    }
+
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        timing.associated = esp_timer_get_time();
     }
     
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (NETCONFIG_RECONNECT_ATTEMPTS < 0 || retry_count < NETCONFIG_RECONNECT_ATTEMPTS) {
-            ESP_LOGW(LOG_TAG, "Connection to access point lost, attempting reconnect...");
+        station_connected = false;
+        if (switching) {
+            switching = false;
+            timing = {};
+            timing.started = esp_timer_get_time();
+            esp_wifi_connect();
+            reconnect_count++;
+        } else if (fast_path) {
+            leave_fast_path();
+            reconnect_count++;
+            start_scan(false);
+        } else if (candidate_index + 1 < candidate_count && select_candidate(candidate_index + 1)) {
+            ESP_LOGW(LOG_TAG, "Connection failed, trying next access point...");
             esp_wifi_connect();
-            retry_count++;
         } else {
-            ESP_LOGE(LOG_TAG, "Connection failed!");
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        } 
+            ESP_LOGW(LOG_TAG, "Connection to access point lost, attempting reconnect...");
+            candidate_count = 0;
+            retry_or_fail();
+        }
     }
     
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         retry_count = 0;
         ip_event_got_ip_t* event = (ip_event_got_ip_t*)event_data;
-        ESP_LOGI(LOG_TAG, "Got IP address: " IPSTR, IP2STR(&event->ip_info.ip));
+        JOURNAL_LOGI(LOG_TAG, "Got IP address: " IPSTR, IP2STR(&event->ip_info.ip));
+        timing.addressed = esp_timer_get_time();
+        JOURNAL_LOGI(LOG_TAG, "Connect timing: associate %lld ms, address %lld ms, total %lld ms (%s).",
+            (timing.associated - timing.started) / 1000,
+            (timing.addressed - timing.associated) / 1000,
+            (timing.addressed - timing.started) / 1000,
+            timing.fast_path ? "fast reconnect" : "full scan");
+        fast_path = false;
+        station_connected = true;
+        candidate_count = 0;
+        remember_connection(event);
+        esp_wifi_set_rssi_threshold(NETCONFIG_ROAM_RSSI);
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
     }
 
 }
 
-bool NetConfig::publish_ap() { 
+// Added profiles are picked up by the next scan. Only removing or
+// changing the network currently in use forces a new selection.
+static void config_listener(const Config& config, void* context) {
+    wifi_config_t wireless_cfg = {};
+    if (!station_connected || esp_wifi_get_config(WIFI_IF_STA, &wireless_cfg) != ESP_OK) {
+        return;
+    }
+    const char* ssid = (const char*)wireless_cfg.sta.ssid;
+    const config_profile_t* profile = config.find_profile(std::string_view(ssid, strnlen(ssid, sizeof(wireless_cfg.sta.ssid))));
+    if (profile != nullptr && strncmp(profile->psk, (const char*)wireless_cfg.sta.password, sizeof(wireless_cfg.sta.password)) == 0) {
+        return;
+    }
+    JOURNAL_LOGI(LOG_TAG, "Profile of '%s' changed, selecting network again...", ssid);
+    esp_wifi_disconnect();
+}
+
+static esp_err_t network_command(httpd_req_t* request, Query& query) {
+    Config config;
+    std::string_view ssid = config.get_ssid();
+    if (ssid.empty()) {
+        JSON::simple_response(request, query, false, "Unable to read network from config!");
+        return ESP_OK;
+    }
+    JSON json(request, query);
+    json.add_bool("success", true)
+        .add_string("message", "Successfully read network from config,")
+        .begin_object("network")
+            .add_string("ssid", ssid)
+            .add_string("psk", config.get_psk())
+            .add_int("security", config.get_security())
+        .end_object()
+        .add_int("roams", roam_count);
+    wifi_ap_record_t current;
+    if (station_connected && esp_wifi_sta_get_ap_info(&current) == ESP_OK) {
+        char bssid[18];
+        snprintf(bssid, sizeof(bssid), MACSTR, MAC2STR(current.bssid));
+        json.begin_object("connected")
+                .add_string("ssid", (const char*)current.ssid)
+                .add_string("bssid", bssid)
+                .add_int("channel", current.primary)
+                .add_int("rssi", current.rssi)
+            .end_object();
+    }
+    json.begin_object("profiles");
+    for (size_t i = 0; i < config.profile_count(); i++) {
+        const config_profile_t& profile = config.get_profile(i);
+        json.begin_object(profile.ssid)
+                .add_int("security", profile.security)
+                .add_int("priority", profile.priority)
+            .end_object();
+    }
+    json.end_object().finalize();
+    return ESP_OK;
+}
+
+// Adds or updates a profile without a reboot; the station picks it up
+// with the next scan.
+static esp_err_t add_network_command(httpd_req_t* request, Query& query) {
+    uint32_t security = CONFIG_DEFAULT_SECURITY;
+    uint32_t priority = 0;
+    if (query.has("security") && (!query.get_uint("security", security) || security >= WIFI_AUTH_MAX)) {
+        JSON::simple_response(request, query, false, "Invalid 'security' parameter!");
+        return ESP_OK;
+    }
+    if (query.has("priority") && (!query.get_uint("priority", priority) || priority > CONFIG_MAX_PRIORITY)) {
+        JSON::simple_response(request, query, false, "Parameter 'priority' must be 0 to 9!");
+        return ESP_OK;
+    }
+    bool success = Config().set_network(query.get("ssid"), query.get("psk"), static_cast<wifi_auth_mode_t>(security), priority);
+    JSON::simple_response(request, query, success, success ? "Network profile stored." : "Failed to store network profile!");
+    return ESP_OK;
+}
+
+static esp_err_t remove_network_command(httpd_req_t* request, Query& query) {
+    Config config;
+    std::string_view ssid = query.get("ssid");
+    if (config.profile_count() == 1 && config.find_profile(ssid) != nullptr) {
+        JSON::simple_response(request, query, false, "Cannot remove the last network profile!");
+        return ESP_OK;
+    }
+    bool success = config.remove_network(ssid);
+    JSON::simple_response(request, query, success, success ? "Network profile removed." : "No network profile with this 'ssid'!");
+    return ESP_OK;
+}
 
-    ESP_LOGI(LOG_TAG, "Setting up network in AP mode...");
+static const command_t network_commands[] = {
+    { "add_network", add_network_command, COMMAND_POST, { "ssid", "psk" } },
+    { "network", network_command, COMMAND_GET, {} },
+    { "remove_network", remove_network_command, COMMAND_POST, { "ssid" } },
+};
 
-    ESP_LOGD(LOG_TAG, "Initializing network interface...");
+const netconfig_timing_t& NetConfig::connect_timing() {
+    return timing;
+}
+
+// Network stack, event loop, Wi-Fi driver and event handlers are set up
+// once and shared by station and AP mode, so the AP can be added while
+// the station is still trying to connect.
+static bool init_wifi() {
+
+    if (wifi_initialized) {
+        return true;
+    }
+
+    s_wifi_event_group = xEventGroupCreate();
+
+    JOURNAL_LOGD(LOG_TAG, "Initializing network interface...");
     if (esp_netif_init() != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Network interface initialization failed!");
         return false;
     }
 
-    ESP_LOGD(LOG_TAG, "Setting up default event loop...");
+    JOURNAL_LOGD(LOG_TAG, "Setting up default event loop...");
     if (esp_event_loop_create_default() != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Could not set up default event loop!");
         return false;
     }
 
-    esp_netif_create_default_wifi_ap();
     wifi_init_config_t config = WIFI_INIT_CONFIG_DEFAULT();
-
-    ESP_LOGD(LOG_TAG, "Initializing default wireless configuration...");
+    JOURNAL_LOGD(LOG_TAG, "Initializing default wireless configuration...");
     if (esp_wifi_init(&config) != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Could not initialize default wireless configuration!");
         return false;
     }
 
-    ESP_LOGD(LOG_TAG, "Registering wireless event handler...");
-    if (esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &ap_event_handler, NULL) != ESP_OK) {
-        ESP_LOGW(LOG_TAG, "Could not register wireless event handler!");
+    JOURNAL_LOGD(LOG_TAG, "Setting up event handlers...");
+    if ((esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &ap_event_handler, NULL, NULL) |
+         esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &sta_event_handler, NULL, NULL) |
+         esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &sta_event_handler, NULL, NULL)) != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Failed setting up event handlers!");
+        return false;
+    }
+
+    Commands::add(network_commands, sizeof(network_commands) / sizeof(network_commands[0]));
+
+    wifi_initialized = true;
+    return true;
+
+}
+
+static bool start_wifi() {
+    if (wifi_started) {
+        return true;
+    }
+    JOURNAL_LOGD(LOG_TAG, "Starting wireless interface...");
+    if (esp_wifi_start() != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Could not start wireless interface!");
+        return false;
+    }
+    wifi_started = true;
+    return true;
+}
+
+uint32_t NetConfig::reconnects() {
+    return reconnect_count;
+}
+
+EventBits_t NetConfig::wait(EventBits_t bits, uint32_t timeout_ms) {
+    if (s_wifi_event_group == NULL) {
+        return 0;
     }
+    TickType_t timeout = (timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
+    return xEventGroupWaitBits(s_wifi_event_group, bits, pdFALSE, pdFALSE, timeout) & bits;
+}
 
-    ESP_LOGD(LOG_TAG, "Setting wireless mode to AP...");
-    if (esp_wifi_set_mode(WIFI_MODE_AP) != ESP_OK) {
+bool NetConfig::publish_ap() { 
+
+    JOURNAL_LOGI(LOG_TAG, "Setting up network in AP mode...");
+    if (!init_wifi()) {
+        return false;
+    }
+
+    if (ap_netif == NULL) {
+        ap_netif = esp_netif_create_default_wifi_ap();
+    }
+
+    wifi_mode_t mode = (sta_netif != NULL ? WIFI_MODE_APSTA : WIFI_MODE_AP);
+    JOURNAL_LOGD(LOG_TAG, "Setting wireless mode to %s...", mode == WIFI_MODE_APSTA ? "AP+station" : "AP");
+    if (esp_wifi_set_mode(mode) != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Could not set wireless mode to AP!");
         return false;
     }
@@ -107,103 +501,94 @@ bool NetConfig::publish_ap() {
     wireless_cfg.ap.max_connection = 4;
     wireless_cfg.ap.beacon_interval = 100;
 
-    ESP_LOGD(LOG_TAG, "Setting wireless configuration...");
+    JOURNAL_LOGD(LOG_TAG, "Setting wireless configuration...");
     if (esp_wifi_set_config(WIFI_IF_AP, &wireless_cfg) != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Could not set wireless configuration!");
         return false;
     }
 
-    ESP_LOGD(LOG_TAG, "Starting wireless interface...");
-    if (esp_wifi_start() != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Could not start wireless interface!");
+    if (!start_wifi()) {
         return false;
     }
 
-    ESP_LOGI(LOG_TAG, "Wireless AP setup finished! SSID: %s", NETCONFIG_AP_SSID);
+    JOURNAL_LOGI(LOG_TAG, "Wireless AP setup finished! SSID: %s", NETCONFIG_AP_SSID);
     return true;
 
 }
 
-bool NetConfig::connect_station(std::string ssid, std::string psk, wifi_auth_mode_t security) {
+uint32_t NetConfig::roams() {
+    return roam_count;
+}
 
-    ESP_LOGI(LOG_TAG, "Connecting to network '%s'...", ssid.c_str());
-    ESP_LOGD(LOG_TAG, "Network PSK is %s", psk.c_str());
+// With a cached access point that still matches a profile the station
+// connects directly; otherwise the STA_START handler scans once and
+// connects to the best ranked candidate.
+bool NetConfig::start_station(const Config& config) {
 
-    s_wifi_event_group = xEventGroupCreate();
-    ESP_LOGD(LOG_TAG, "Initializing network interface...");
-    if (esp_netif_init() != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Network interface initialization failed!");
-        return false;
-    }
-    
-    if (esp_event_loop_create_default() != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Could not set up default event loop!");
-        return false;
-    }
+    JOURNAL_LOGI(LOG_TAG, "Connecting with %u network profiles...", config.profile_count());
 
-    esp_netif_create_default_wifi_sta();
-    wifi_init_config_t config = WIFI_INIT_CONFIG_DEFAULT();
-    
-    ESP_LOGD(LOG_TAG, "Initializing default wireless configuration...");
-    if (esp_wifi_init(&config) != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Could not initialize default wireless configuration!");
+    if (!init_wifi()) {
         return false;
     }
 
-    ESP_LOGD(LOG_TAG, "Setting up event handlers...");
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-    if ((esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &sta_event_handler, NULL, &instance_any_id) |
-         esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &sta_event_handler, NULL, &instance_got_ip)) != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Failed setting up event handlers!");
-        return false;
+    if (sta_netif == NULL) {
+        sta_netif = esp_netif_create_default_wifi_sta();
     }
 
-    wifi_config_t wireless_cfg = {};
-    strncpy((char*)wireless_cfg.sta.ssid, ssid.c_str(), 32);
-    strncpy((char*)wireless_cfg.sta.password, psk.c_str(), 64);
-    wireless_cfg.sta.threshold.authmode = security;
-    wireless_cfg.sta.pmf_cfg.capable = true;
-    wireless_cfg.sta.pmf_cfg.required = false;
+    netconfig_cache_t cache;
+    const config_profile_t* profile = load_cache(config, cache);
+    fast_path = profile != nullptr;
+    timing = {};
+    timing.fast_path = fast_path;
 
-    ESP_LOGD(LOG_TAG, "Setting wireless mode to station...");
-    if (esp_wifi_set_mode(WIFI_MODE_STA) != ESP_OK) {
+    wifi_mode_t mode = (ap_netif != NULL ? WIFI_MODE_APSTA : WIFI_MODE_STA);
+    JOURNAL_LOGD(LOG_TAG, "Setting wireless mode to station...");
+    if (esp_wifi_set_mode(mode) != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Failed setting wireless mode to station!");
         return false;
     }
-    
-    ESP_LOGD(LOG_TAG, "Setting wireless configuration...");
-    if (esp_wifi_set_config(WIFI_IF_STA, &wireless_cfg) != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Could not set wireless configuration!");
-        return false;
+
+    if (fast_path) {
+        ESP_LOGI(LOG_TAG, "Trying fast reconnect to " MACSTR " on channel %u, last address " IPSTR "...",
+            MAC2STR(cache.bssid), cache.channel, IP2STR(&cache.ip));
+        wifi_config_t wireless_cfg;
+        fill_station(wireless_cfg, *profile, cache.bssid, cache.channel);
+        JOURNAL_LOGD(LOG_TAG, "Setting wireless configuration...");
+        if (esp_wifi_set_config(WIFI_IF_STA, &wireless_cfg) != ESP_OK) {
+            ESP_LOGE(LOG_TAG, "Could not set wireless configuration!");
+            return false;
+        }
     }
 
-    ESP_LOGD(LOG_TAG, "Starting wireless interface...");
-    if (esp_wifi_start() != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Could not start wireless interface!");
+    if (!start_wifi()) {
         return false;
     }
+    Config::subscribe(config_listener, NULL);
+    return true;
 
-    // Waiting until connection established (WIFI_CONNECTED_BIT) or connection failed over number of re-tries (WIFI_FAIL_BIT)
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
+}
 
-    // xEventGroupWaitBits() returns the bits before the call returned
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(LOG_TAG, "Connected to SSID '%s'.", ssid.c_str());
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(LOG_TAG, "Failed to connect to SSID '%s'.", ssid.c_str());
-    } else {
-        ESP_LOGE(LOG_TAG, "Got an unexpected event bit!");
-    }
+bool NetConfig::connect_station(const Config& config) {
 
-    ESP_LOGD(LOG_TAG, "Unregistering event handlers...");
-    if ((esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip) |
-         esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id)) != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Failed unregistering event handlers!");
+    if (!this->start_station(config)) {
         return false;
     }
 
-    vEventGroupDelete(s_wifi_event_group);
-    return true; 
+    // Waiting until connection established (WIFI_CONNECTED_BIT) or connection failed over number of re-tries (WIFI_FAIL_BIT)
+    EventBits_t bits = NetConfig::wait(WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, UINT32_MAX);
+    if (bits & WIFI_CONNECTED_BIT) {
+        JOURNAL_LOGI(LOG_TAG, "Connected to a configured network.");
+        return true;
+    }
+    JOURNAL_LOGI(LOG_TAG, "Failed to connect to any configured network.");
+    return false;
+
+}
 
+bool NetConfig::shutdown() {
+    JOURNAL_LOGD(LOG_TAG, "Stopping wireless interface...");
+    esp_err_t stopped = esp_wifi_stop();
+    esp_err_t deinitialized = esp_wifi_deinit();
+    wifi_started = false;
+    return (stopped == ESP_OK || stopped == ESP_ERR_WIFI_NOT_INIT) && deinitialized == ESP_OK;
 }
\ No newline at end of file
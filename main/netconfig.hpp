@@ -1,24 +1,46 @@
 #ifndef NETCONFIG_H
 #define NETCONFIG_H
 
+#include "config.hpp"
+
 #include "esp_wifi_types.h"
 
-#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include <cstdint>
 
 #define NETCONFIG_AP_SSID               "ESP32-AP"
 #define NETCONFIG_RECONNECT_ATTEMPTS    -1
+#define NETCONFIG_SCAN_RECORDS          16
+#define NETCONFIG_ROAM_RSSI             -75
+
+#define NETCONFIG_CACHE_NAMESPACE       "netconfig"
+#define NETCONFIG_CACHE_KEY             "last"
 
 #define WIFI_CONNECTED_BIT  BIT0
 #define WIFI_FAIL_BIT       BIT1
+#define WIFI_AP_STARTED_BIT BIT2
+
+// Timestamps (esp_timer, microseconds) of the phases of the last
+// station connect attempt.
+typedef struct {
+    int64_t started;
+    int64_t associated;
+    int64_t addressed;
+    bool fast_path;
+} netconfig_timing_t;
 
 class NetConfig {
 public:
-    bool connect_station(
-        std::string ssid, 
-        std::string psk, 
-        wifi_auth_mode_t security
-    );
+    static const netconfig_timing_t& connect_timing();
+    static uint32_t reconnects();
+    static uint32_t roams();
+    static EventBits_t wait(EventBits_t bits, uint32_t timeout_ms);
+    bool start_station(const Config& config);
+    bool connect_station(const Config& config);
     bool publish_ap();
+    static bool shutdown();
 };
 
 #endif
\ No newline at end of file
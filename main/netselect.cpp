@@ -0,0 +1,78 @@
+#include "netselect.hpp"
+
+#include <cstring>
+
+// Profiles with a PSK only match personal-mode access points at or above
+// the stored security; profiles without one only match open networks.
+bool NetSelect::compatible(const config_profile_t& profile, wifi_auth_mode_t authmode) {
+    if (profile.psk[0] == '\0') {
+        return authmode == WIFI_AUTH_OPEN;
+    }
+    switch (authmode) {
+        case WIFI_AUTH_WEP:
+        case WIFI_AUTH_WPA_PSK:
+        case WIFI_AUTH_WPA2_PSK:
+        case WIFI_AUTH_WPA_WPA2_PSK:
+        case WIFI_AUTH_WPA3_PSK:
+        case WIFI_AUTH_WPA2_WPA3_PSK:
+            return authmode >= profile.security;
+        default:
+            return false;
+    }
+}
+
+int NetSelect::score(const config_profile_t& profile, int8_t rssi) {
+    return rssi + profile.priority * NETSELECT_PRIORITY_WEIGHT;
+}
+
+// Candidates are returned best first. Equal scores keep scan order, and
+// once capacity is reached weaker candidates are dropped.
+size_t NetSelect::rank(const Config& config, const wifi_ap_record_t* records, size_t count,
+                       netselect_candidate_t* candidates, size_t capacity) {
+    size_t ranked = 0;
+    for (size_t i = 0; i < count && i <= UINT8_MAX; i++) {
+        const wifi_ap_record_t& record = records[i];
+        if (record.rssi < NETSELECT_MIN_RSSI) {
+            continue;
+        }
+        const char* ssid = reinterpret_cast<const char*>(record.ssid);
+        const config_profile_t* profile = config.find_profile(std::string_view(ssid, strnlen(ssid, sizeof(record.ssid))));
+        if (profile == nullptr || !NetSelect::compatible(*profile, record.authmode)) {
+            continue;
+        }
+        int score = NetSelect::score(*profile, record.rssi);
+        size_t position = ranked;
+        while (position > 0 && candidates[position - 1].score < score) {
+            position--;
+        }
+        if (position == capacity) {
+            continue;
+        }
+        size_t moved = (ranked < capacity ? ranked : capacity - 1) - position;
+        memmove(&candidates[position + 1], &candidates[position], moved * sizeof(netselect_candidate_t));
+        candidates[position].profile = profile - &config.get_profile(0);
+        candidates[position].record = i;
+        candidates[position].score = score;
+        if (ranked < capacity) {
+            ranked++;
+        }
+    }
+    return ranked;
+}
+
+// Picks the best ranked access point other than the current one that is
+// stronger by at least NETSELECT_ROAM_HYSTERESIS, so a station sitting
+// between two access points of similar strength does not flap.
+int NetSelect::roam_target(const uint8_t* bssid, int8_t rssi, const wifi_ap_record_t* records,
+                           const netselect_candidate_t* candidates, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const wifi_ap_record_t& record = records[candidates[i].record];
+        if (memcmp(record.bssid, bssid, sizeof(record.bssid)) == 0) {
+            continue;
+        }
+        if (record.rssi >= rssi + NETSELECT_ROAM_HYSTERESIS) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,47 @@
+#ifndef NETSELECT_H
+#define NETSELECT_H
+
+#include "config.hpp"
+
+#include "esp_wifi_types.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#define NETSELECT_MAX_CANDIDATES    8
+#define NETSELECT_MIN_RSSI          -90
+#define NETSELECT_PRIORITY_WEIGHT   6
+#define NETSELECT_ROAM_HYSTERESIS   8
+
+// Usable access point from a scan: indices into the config profiles and
+// the scan records, and the score it was ranked by.
+typedef struct {
+    uint8_t profile;
+    uint8_t record;
+    int16_t score;
+} netselect_candidate_t;
+
+// Ranking of scan results against the stored network profiles, kept free
+// of any driver calls so recorded scans can be replayed on the host.
+// Each priority step is worth NETSELECT_PRIORITY_WEIGHT dB of RSSI.
+class NetSelect {
+public:
+    static bool compatible(const config_profile_t& profile, wifi_auth_mode_t authmode);
+    static int score(const config_profile_t& profile, int8_t rssi);
+    static size_t rank(
+        const Config& config,
+        const wifi_ap_record_t* records,
+        size_t count,
+        netselect_candidate_t* candidates,
+        size_t capacity
+    );
+    static int roam_target(
+        const uint8_t* bssid,
+        int8_t rssi,
+        const wifi_ap_record_t* records,
+        const netselect_candidate_t* candidates,
+        size_t count
+    );
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "nvstorage.hpp"
+#include "journal.hpp"
 
 #include "nvs.h"
 #include "nvs_flash.h"
@@ -6,6 +7,9 @@
 
 #include "esp_log.h"
 
+#include <cstring>
+#include <set>
+
 #define LOG_TAG "nvstorage.cpp"
 
 bool NVStorage::init() {
@@ -33,34 +37,58 @@ bool NVStorage::erase() {
     return nvs_flash_erase() == ESP_OK;
 }
 
+// Clears every namespace but keep, entry by entry rather than by wiping
+// the partition, so keep is never absent even if power fails midway.
+bool NVStorage::erase_except(const char* keep) {
+    std::set<std::string> namespaces;
+    nvs_iterator_t iterator = nvs_entry_find(NVS_DEFAULT_PART_NAME, NULL, NVS_TYPE_ANY);
+    while (iterator != NULL) {
+        nvs_entry_info_t info;
+        nvs_entry_info(iterator, &info);
+        if (strcmp(info.namespace_name, keep) != 0) {
+            namespaces.insert(info.namespace_name);
+        }
+        iterator = nvs_entry_next(iterator);
+    }
+    bool success = true;
+    for (const std::string& ns : namespaces) {
+        try {
+            NVStorage storage(ns.c_str(), true);
+            success &= storage.reset() && storage.commit();
+        } catch (int error) {
+            success = false;
+        }
+    }
+    return success;
+}
+
 NVStorage::NVStorage(const char* ns, bool rw) {
-    ESP_LOGD(LOG_TAG, "Open: Getting handle to NVS...");
     nvs_open_mode_t mode = (rw ? NVS_READWRITE : NVS_READONLY);
     esp_err_t result = nvs_open(ns, mode, &this->handle);
     if (result == ESP_ERR_NVS_NOT_INITIALIZED) {
         if (!NVStorage::init()) {
-            throw;
+            throw result;
         }
         result = nvs_open(ns, mode, &this->handle);
     }
     if (result != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Open: Could not open NVS namespace '%s'! (%d)", ns, result);
-        throw;
+        throw result;
     }
-    ESP_LOGD(LOG_TAG, "Open: Successfully obtained NVS handle!");
+    this->batching = false;
+    this->dirty = false;
+    this->stats = {};
 }
 
 NVStorage::~NVStorage() {
-    ESP_LOGD(LOG_TAG, "Destructor: Destructing NVStorage instance...");
-    if (nvs_commit(this->handle) != ESP_OK) {
+    if (this->dirty && nvs_commit(this->handle) != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Destructor: Could not commit changes to NVS.");
     }
-    ESP_LOGD(LOG_TAG, "Destructor: Closing handle to NVS...");
     nvs_close(this->handle);
 }
 
 std::string NVStorage::get_str(const char* key) {
-    ESP_LOGD(LOG_TAG, "Get: Getting value for key '%s'...", key);
+    JOURNAL_LOGD(LOG_TAG, "Get: Getting value for key '%s'...", key);
     size_t length;
     if (nvs_get_str(this->handle, key, NULL, &length) != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Get: Could not get size for key '%s'!", key);
@@ -76,17 +104,58 @@ std::string NVStorage::get_str(const char* key) {
     return result;
 }
 
-bool NVStorage::set_str(const char* key, const char* value) {
-    ESP_LOGD(LOG_TAG, "Set: Setting value for key '%s'...", key);
-    if (nvs_set_str(this->handle, key, value) != ESP_OK) {
+bool NVStorage::str_unchanged(const char* key, const char* value) {
+    size_t length;
+    if (nvs_get_str(this->handle, key, NULL, &length) != ESP_OK ||
+        length != strlen(value) + 1 || length > NVSTORAGE_COMPARE_LENGTH) {
+        return false;
+    }
+    char stored[NVSTORAGE_COMPARE_LENGTH];
+    if (nvs_get_str(this->handle, key, stored, &length) != ESP_OK) {
+        return false;
+    }
+    return memcmp(stored, value, length) == 0;
+}
+
+bool NVStorage::blob_unchanged(const char* key, const void* value, size_t length) {
+    size_t stored_length = NVSTORAGE_COMPARE_LENGTH;
+    if (length > NVSTORAGE_COMPARE_LENGTH) {
+        return false;
+    }
+    uint8_t stored[NVSTORAGE_COMPARE_LENGTH];
+    if (nvs_get_blob(this->handle, key, stored, &stored_length) != ESP_OK) {
+        return false;
+    }
+    return stored_length == length && memcmp(stored, value, length) == 0;
+}
+
+bool NVStorage::written(const char* key, esp_err_t result) {
+    if (result != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Set: Could not set value for key '%s'!", key);
+        this->stats.failed++;
         return false;
     }
-    return nvs_commit(this->handle) == ESP_OK;
+    this->stats.written++;
+    this->dirty = true;
+    if (!this->batching) {
+        return this->commit();
+    }
+    return true;
+}
+
+bool NVStorage::set_str(const char* key, const char* value) {
+    JOURNAL_LOGD(LOG_TAG, "Set: Setting value for key '%s'...", key);
+    this->stats.staged++;
+    if (this->str_unchanged(key, value)) {
+        JOURNAL_LOGD(LOG_TAG, "Set: Value for key '%s' unchanged, skipping.", key);
+        this->stats.elided++;
+        return true;
+    }
+    return this->written(key, nvs_set_str(this->handle, key, value));
 }
 
 uint8_t NVStorage::get_uint8(const char* key) {
-    ESP_LOGD(LOG_TAG, "Get: Getting value for key '%s'...", key);
+    JOURNAL_LOGD(LOG_TAG, "Get: Getting value for key '%s'...", key);
     uint8_t value;
     if (nvs_get_u8(this->handle, key, &value) != ESP_OK) {
         ESP_LOGE(LOG_TAG, "Get: Could not get value for key '%s'!", key);
@@ -96,14 +165,82 @@ uint8_t NVStorage::get_uint8(const char* key) {
 }
 
 bool NVStorage::set_uint8(const char* key, uint8_t value) {
-    ESP_LOGD(LOG_TAG, "Set: Setting value for key '%s'...", key);
-    if (nvs_set_u8(this->handle, key, value) != ESP_OK) {
-        ESP_LOGE(LOG_TAG, "Set: Could not set value for key '%s'!", key);
+    JOURNAL_LOGD(LOG_TAG, "Set: Setting value for key '%s'...", key);
+    this->stats.staged++;
+    uint8_t stored;
+    if (nvs_get_u8(this->handle, key, &stored) == ESP_OK && stored == value) {
+        JOURNAL_LOGD(LOG_TAG, "Set: Value for key '%s' unchanged, skipping.", key);
+        this->stats.elided++;
+        return true;
+    }
+    return this->written(key, nvs_set_u8(this->handle, key, value));
+}
+
+bool NVStorage::get_blob(const char* key, void* out, size_t& length) {
+    return this->read_blob(key, out, length) == ESP_OK;
+}
+
+// Like get_blob, but lets the caller tell a missing key from a failed read.
+esp_err_t NVStorage::read_blob(const char* key, void* out, size_t& length) {
+    JOURNAL_LOGD(LOG_TAG, "Get: Getting blob for key '%s'...", key);
+    esp_err_t result = nvs_get_blob(this->handle, key, out, &length);
+    if (result != ESP_OK) {
+        if (result != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGE(LOG_TAG, "Get: Could not get blob for key '%s'! (%d)", key, result);
+        }
+        length = 0;
+    }
+    return result;
+}
+
+bool NVStorage::set_blob(const char* key, const void* value, size_t length) {
+    JOURNAL_LOGD(LOG_TAG, "Set: Setting blob for key '%s'...", key);
+    this->stats.staged++;
+    if (this->blob_unchanged(key, value, length)) {
+        JOURNAL_LOGD(LOG_TAG, "Set: Blob for key '%s' unchanged, skipping.", key);
+        this->stats.elided++;
+        return true;
+    }
+    return this->written(key, nvs_set_blob(this->handle, key, value, length));
+}
+
+bool NVStorage::erase_key(const char* key) {
+    esp_err_t result = nvs_erase_key(this->handle, key);
+    if (result == ESP_ERR_NVS_NOT_FOUND) {
+        return true;
+    }
+    return this->written(key, result);
+}
+
+void NVStorage::begin() {
+    this->batching = true;
+    this->stats = {};
+}
+
+bool NVStorage::commit() {
+    bool success = true;
+    if (this->batching) {
+        JOURNAL_LOGD(LOG_TAG, "Commit: %u staged, %u written, %u elided, %u failed.",
+            this->stats.staged, this->stats.written, this->stats.elided, this->stats.failed);
+        success = (this->stats.failed == 0);
+        this->batching = false;
+    }
+    if (!this->dirty) {
+        return success;
+    }
+    if (nvs_commit(this->handle) != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Commit: Could not commit changes to NVS.");
         return false;
     }
-    return nvs_commit(this->handle) == ESP_OK;
+    this->dirty = false;
+    return success;
+}
+
+const nvs_transaction_stats_t& NVStorage::transaction_stats() {
+    return this->stats;
 }
 
 bool NVStorage::reset() {
+    this->dirty = true;
     return nvs_erase_all(this->handle) == ESP_OK;
 }
\ No newline at end of file
@@ -5,8 +5,23 @@
 
 #include <string>
 
+#define NVSTORAGE_COMPARE_LENGTH 256
+
+typedef struct {
+    uint16_t staged;
+    uint16_t written;
+    uint16_t elided;
+    uint16_t failed;
+} nvs_transaction_stats_t;
+
 class NVStorage {
     nvs_handle_t handle;
+    bool batching;
+    bool dirty;
+    nvs_transaction_stats_t stats;
+    bool str_unchanged(const char* key, const char* value);
+    bool blob_unchanged(const char* key, const void* value, size_t length);
+    bool written(const char* key, esp_err_t result);
 public:
     NVStorage(const char* ns, bool rw);
     ~NVStorage();
@@ -14,14 +29,25 @@ public:
     static bool init();
     static bool deinit();
     static bool erase();
+    static bool erase_except(const char* keep);
 
     uint8_t get_uint8(const char* key);
     std::string get_str(const char* key);
     bool set_uint8(const char* key, uint8_t value);
     bool set_str(const char* key, const char* value);
+    bool get_blob(const char* key, void* out, size_t& length);
+    esp_err_t read_blob(const char* key, void* out, size_t& length);
+    bool set_blob(const char* key, const void* value, size_t length);
+    bool erase_key(const char* key);
+
+    // Writes between begin() and commit() are staged without committing;
+    // values equal to what is already stored are skipped entirely.
+    void begin();
+    bool commit();
+    const nvs_transaction_stats_t& transaction_stats();
 
     bool reset();
     bool close();
 };
 
-#endif
\ No newline at end of file
+#endif
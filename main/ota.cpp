@@ -0,0 +1,238 @@
+#include "ota.hpp"
+#include "actions.hpp"
+#include "journal.hpp"
+#include "json.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_ota_ops.h"
+#include "esp_log.h"
+
+#include "mbedtls/sha256.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#define LOG_TAG "ota.cpp"
+
+typedef struct {
+    int index;
+    size_t length;
+} ota_block_t;
+
+static char buffers[2][OTA_BUFFER_SIZE];
+static std::atomic<bool> busy(false);
+
+// Hand-off between the receiving handler and the writer task. filled
+// carries blocks to flash, a zero-length block ends the image; free
+// returns buffers once their block is written.
+static QueueHandle_t filled = NULL;
+static QueueHandle_t free_buffers = NULL;
+static esp_ota_handle_t update = 0;
+static std::atomic<bool> write_failed(false);
+static TaskHandle_t waiter = NULL;
+
+static void writer_task(void* parameters) {
+    ota_block_t block;
+    while (xQueueReceive(filled, &block, portMAX_DELAY) == pdTRUE && block.length > 0) {
+        if (!write_failed && esp_ota_write(update, buffers[block.index], block.length) != ESP_OK) {
+            write_failed = true;
+        }
+        xQueueSend(free_buffers, &block.index, portMAX_DELAY);
+    }
+    xTaskNotifyGive(waiter);
+    vTaskDelete(NULL);
+}
+
+static bool parse_hash(httpd_req_t* request, uint8_t hash[32]) {
+    char text[65];
+    if (httpd_req_get_hdr_value_str(request, OTA_HASH_HEADER, text, sizeof(text)) != ESP_OK ||
+        strlen(text) != 64) {
+        return false;
+    }
+    for (int i = 0; i < 32; i++) {
+        unsigned value;
+        if (sscanf(text + i * 2, "%2x", &value) != 1) {
+            return false;
+        }
+        hash[i] = value;
+    }
+    return true;
+}
+
+static bool start_writer() {
+    if (filled == NULL) {
+        filled = xQueueCreate(2, sizeof(ota_block_t));
+        free_buffers = xQueueCreate(2, sizeof(int));
+        if (filled == NULL || free_buffers == NULL) {
+            return false;
+        }
+    }
+    xQueueReset(filled);
+    xQueueReset(free_buffers);
+    for (int index = 0; index < 2; index++) {
+        xQueueSend(free_buffers, &index, 0);
+    }
+    write_failed = false;
+    waiter = xTaskGetCurrentTaskHandle();
+    xTaskNotifyStateClear(NULL);
+    return xTaskCreate(writer_task, "ota_writer", OTA_WRITER_STACK_SIZE, NULL, OTA_WRITER_PRIORITY, NULL) == pdPASS;
+}
+
+// Ends the writer and waits until it has flashed every queued block.
+static void stop_writer() {
+    ota_block_t end = { 0, 0 };
+    xQueueSend(filled, &end, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+// Streams the body into the update partition. Returns an error message,
+// or NULL once every byte is received and handed to the writer.
+static const char* receive(httpd_req_t* request, uint8_t digest[32]) {
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    const char* error = NULL;
+    size_t remaining = request->content_len;
+    int retries = 0;
+    while (remaining > 0 && error == NULL) {
+        int index;
+        if (xQueueReceive(free_buffers, &index, pdMS_TO_TICKS(OTA_WRITER_TIMEOUT_MS)) != pdTRUE) {
+            error = "Flash writer stalled!";
+            break;
+        }
+        size_t length = 0;
+        while (length < OTA_BUFFER_SIZE && length < remaining) {
+            size_t wanted = std::min(OTA_BUFFER_SIZE - length, remaining - length);
+            int received = httpd_req_recv(request, buffers[index] + length, wanted);
+            if (received == HTTPD_SOCK_ERR_TIMEOUT && ++retries <= OTA_RECV_RETRIES) {
+                continue;
+            }
+            if (received <= 0) {
+                error = "Connection lost while receiving image!";
+                break;
+            }
+            retries = 0;
+            length += received;
+        }
+        if (error != NULL || write_failed) {
+            error = (error != NULL ? error : "Writing to flash failed!");
+            xQueueSend(free_buffers, &index, 0);
+            break;
+        }
+        mbedtls_sha256_update(&sha, (const unsigned char*)buffers[index], length);
+        ota_block_t block = { index, length };
+        xQueueSend(filled, &block, portMAX_DELAY);
+        remaining -= length;
+    }
+
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    return error;
+}
+
+static const char* install(httpd_req_t* request) {
+
+    uint8_t expected[32];
+    if (!parse_hash(request, expected)) {
+        return "Header '" OTA_HASH_HEADER "' must carry the image SHA-256 in hex!";
+    }
+    const esp_partition_t* partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == NULL) {
+        return "No update partition available!";
+    }
+    if (request->content_len == 0 || request->content_len > partition->size) {
+        return "Image size does not fit the update partition!";
+    }
+
+    // Sequential writes erase sector by sector as the image arrives
+    // instead of erasing the whole partition up front.
+    if (esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &update) != ESP_OK) {
+        return "Could not start update!";
+    }
+    if (!start_writer()) {
+        esp_ota_abort(update);
+        return "Could not start flash writer!";
+    }
+
+    uint8_t digest[32];
+    const char* error = receive(request, digest);
+    stop_writer();
+    if (error == NULL && write_failed) {
+        error = "Writing to flash failed!";
+    }
+    if (error == NULL && memcmp(digest, expected, sizeof(digest)) != 0) {
+        error = "Image hash mismatch!";
+    }
+    if (error != NULL) {
+        esp_ota_abort(update);
+        return error;
+    }
+    if (esp_ota_end(update) != ESP_OK) {
+        return "Image failed validation!";
+    }
+    if (esp_ota_set_boot_partition(partition) != ESP_OK) {
+        return "Could not select new boot partition!";
+    }
+    JOURNAL_LOGI(LOG_TAG, "Installed %u byte image to '%s'.", (unsigned)request->content_len, partition->label);
+    return NULL;
+
+}
+
+esp_err_t Ota::handler(httpd_req_t* request) {
+
+    httpd_resp_set_type(request, "text/plain");
+    if (!OtaToken::authorized(request)) {
+        httpd_resp_set_status(request, "401 Unauthorized");
+        JSON::simple_response(request, false, "Missing or wrong '" OTA_TOKEN_HEADER "' header!");
+        return ESP_OK;
+    }
+    bool expected = false;
+    if (!busy.compare_exchange_strong(expected, true)) {
+        httpd_resp_set_status(request, "409 Conflict");
+        JSON::simple_response(request, false, "Another update is in progress!");
+        return ESP_OK;
+    }
+
+    const char* error = install(request);
+    busy = false;
+    if (error != NULL) {
+        ESP_LOGE(LOG_TAG, "Update failed: %s", error);
+        JSON::simple_response(request, false, error);
+        return ESP_OK;
+    }
+
+    Actions::schedule(ACTION_REBOOT);
+    char message[64];
+    snprintf(message, sizeof(message), "Update installed, rebooting in %u ms...",
+        (unsigned)Actions::default_delay(ACTION_REBOOT));
+    JSON::simple_response(request, true, message);
+    return ESP_OK;
+
+}
+
+bool Ota::init() {
+    return OtaToken::init();
+}
+
+// Called once boot has reached a state worth keeping. An image still on
+// probation is either accepted for good or rolled back right away.
+void Ota::confirm(bool healthy) {
+    esp_ota_img_states_t state;
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK || state != ESP_OTA_IMG_PENDING_VERIFY) {
+        return;
+    }
+    if (healthy) {
+        ESP_LOGW(LOG_TAG, "Self-check passed, keeping updated image.");
+        esp_ota_mark_app_valid_cancel_rollback();
+    } else {
+        ESP_LOGE(LOG_TAG, "Self-check failed, rolling back!");
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef OTA_H
+#define OTA_H
+
+#include "ota_token.hpp"
+
+#include "esp_http_server.h"
+
+#define OTA_BUFFER_SIZE         2048
+#define OTA_RECV_RETRIES        3
+#define OTA_WRITER_STACK_SIZE   3072
+#define OTA_WRITER_PRIORITY     6
+#define OTA_WRITER_TIMEOUT_MS   10000
+#define OTA_HASH_HEADER         "X-Image-SHA256"
+
+// Firmware updates over HTTP. The image is received into one of two
+// alternating buffers while a writer task flashes the other, and hashed
+// as it arrives. The new partition only becomes the boot partition when
+// the hash matches, and stays on probation until the next boot passes
+// its self-check; otherwise the bootloader rolls back.
+class Ota {
+public:
+    static bool init();
+    static void confirm(bool healthy);
+    static esp_err_t handler(httpd_req_t* request);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "ota_token.hpp"
+#include "commands.hpp"
+#include "nvstorage.hpp"
+#include "json.hpp"
+
+#include "esp_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#define LOG_TAG "ota_token.cpp"
+
+static std::string stored_token() {
+    try {
+        NVStorage storage(OTA_NAMESPACE, false);
+        return storage.get_str(OTA_TOKEN_KEY);
+    } catch (int error) {
+        return "";
+    }
+}
+
+static bool tokens_equal(const std::string& expected, const char* given) {
+    size_t length = strlen(given);
+    uint8_t difference = (length != expected.length());
+    for (size_t i = 0; i < expected.length(); i++) {
+        difference |= expected[i] ^ (i < length ? given[i] : 0);
+    }
+    return difference == 0;
+}
+
+bool OtaToken::authorized(httpd_req_t* request) {
+    std::string expected = stored_token();
+    char given[OTA_TOKEN_LENGTH + 1];
+    if (expected.empty() ||
+        httpd_req_get_hdr_value_str(request, OTA_TOKEN_HEADER, given, sizeof(given)) != ESP_OK) {
+        return false;
+    }
+    return tokens_equal(expected, given);
+}
+
+static esp_err_t ota_token_command(httpd_req_t* request, Query& query) {
+    std::string current = stored_token();
+    std::string_view token = query.get("token");
+    char given[OTA_TOKEN_LENGTH + 1] = {};
+    std::string_view previous = query.get("current");
+    memcpy(given, previous.data(), std::min<size_t>(previous.length(), OTA_TOKEN_LENGTH));
+    if (!current.empty() && !tokens_equal(current, given)) {
+        httpd_resp_set_status(request, "401 Unauthorized");
+        JSON::simple_response(request, query, false, "Parameter 'current' does not match the update token!");
+        return ESP_OK;
+    }
+    if (token.length() < OTA_TOKEN_MIN_LENGTH || token.length() > OTA_TOKEN_LENGTH) {
+        JSON::simple_response(request, query, false, "Parameter 'token' must be 16 to 64 characters!");
+        return ESP_OK;
+    }
+    bool success = false;
+    try {
+        NVStorage storage(OTA_NAMESPACE, true);
+        success = storage.set_str(OTA_TOKEN_KEY, std::string(token).c_str());
+    } catch (int error) {
+        ESP_LOGE(LOG_TAG, "Token: Unable to access NVS.");
+    }
+    JSON::simple_response(request, query, success, success ? "Update token set." : "Could not store update token!");
+    return ESP_OK;
+}
+
+static const command_t ota_commands[] = {
+    { "ota_token", ota_token_command, COMMAND_POST, { "token" } },
+};
+
+bool OtaToken::init() {
+    return Commands::add(ota_commands, sizeof(ota_commands) / sizeof(ota_commands[0]));
+}
@@ -0,0 +1,22 @@
+#ifndef OTA_TOKEN_H
+#define OTA_TOKEN_H
+
+#include "esp_http_server.h"
+
+#define OTA_TOKEN_LENGTH        64
+#define OTA_TOKEN_MIN_LENGTH    16
+#define OTA_NAMESPACE           "ota"
+#define OTA_TOKEN_KEY           "token"
+#define OTA_TOKEN_HEADER        "X-OTA-Token"
+
+// Shared secret guarding firmware updates. It lives in its own NVS
+// namespace, which a reset leaves in place. A device without a token
+// accepts any new one of sufficient length through the ota_token
+// command; afterwards the current token is required.
+class OtaToken {
+public:
+    static bool init();
+    static bool authorized(httpd_req_t* request);
+};
+
+#endif
@@ -0,0 +1,252 @@
+#include "provision.hpp"
+#include "cbor.hpp"
+#include "nvstorage.hpp"
+
+#include "esp_log.h"
+
+#include <cstring>
+
+#define LOG_TAG "provision.cpp"
+
+size_t Provision::write(const Config& config, const scheduler_table_t& table, uint8_t* buffer, size_t size) {
+    size_t schedules = 0;
+    for (int id = 0; id < SCHEDULER_MAX; id++) {
+        if (table.entries[id].days != 0) {
+            schedules++;
+        }
+    }
+    CBORWriter writer(buffer, size);
+    writer.begin_map(4)
+        .add_uint(PROVISION_KEY_VERSION).add_uint(PROVISION_VERSION)
+        .add_uint(PROVISION_KEY_NETWORKS).begin_array(config.profile_count());
+    for (size_t i = 0; i < config.profile_count(); i++) {
+        const config_profile_t& profile = config.get_profile(i);
+        writer.begin_array(4)
+            .add_text(profile.ssid)
+            .add_text(profile.psk)
+            .add_uint(profile.security)
+            .add_uint(profile.priority);
+    }
+    writer.add_uint(PROVISION_KEY_SCHEDULES).begin_array(schedules);
+    for (int id = 0; id < SCHEDULER_MAX; id++) {
+        const schedule_t& entry = table.entries[id];
+        if (entry.days == 0) {
+            continue;
+        }
+        writer.begin_array(5)
+            .add_uint(id)
+            .add_uint(entry.action)
+            .add_uint(entry.days)
+            .add_uint(entry.hour)
+            .add_uint(entry.minute);
+    }
+    writer.add_uint(PROVISION_KEY_MACHINE).begin_map(1)
+        .add_uint(PROVISION_MACHINE_AUTO_OFF).add_uint(table.auto_off_minutes);
+    return writer.ok() ? writer.length() : 0;
+}
+
+static bool read_bounded(CBORReader& reader, uint64_t maximum, uint64_t& value) {
+    return reader.read_uint(value) && value <= maximum;
+}
+
+static bool read_field(CBORReader& reader, char* destination, size_t capacity) {
+    std::string_view value;
+    if (!reader.read_text(value) || value.length() > capacity || memchr(value.data(), '\0', value.length()) != nullptr) {
+        return false;
+    }
+    memcpy(destination, value.data(), value.length());
+    destination[value.length()] = '\0';
+    return true;
+}
+
+static bool read_networks(CBORReader& reader, provision_document_t& document) {
+    size_t count;
+    if (!reader.read_array(count) || count == 0 || count > CONFIG_MAX_PROFILES) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        config_profile_t& profile = document.networks[i];
+        size_t fields;
+        uint64_t security;
+        uint64_t priority;
+        if (!reader.read_array(fields) || fields != 4 ||
+            !read_field(reader, profile.ssid, CONFIG_SSID_LENGTH) || profile.ssid[0] == '\0' ||
+            !read_field(reader, profile.psk, CONFIG_PSK_LENGTH) ||
+            !read_bounded(reader, WIFI_AUTH_MAX - 1, security) ||
+            !read_bounded(reader, CONFIG_MAX_PRIORITY, priority)) {
+            return false;
+        }
+        profile.security = static_cast<wifi_auth_mode_t>(security);
+        profile.priority = priority;
+        for (size_t j = 0; j < i; j++) {
+            if (strcmp(document.networks[j].ssid, profile.ssid) == 0) {
+                return false;
+            }
+        }
+    }
+    document.network_count = count;
+    return true;
+}
+
+static bool read_schedules(CBORReader& reader, provision_document_t& document) {
+    size_t count;
+    if (!reader.read_array(count) || count > SCHEDULER_MAX) {
+        return false;
+    }
+    memset(document.table.entries, 0, sizeof(document.table.entries));
+    for (size_t i = 0; i < count; i++) {
+        size_t fields;
+        uint64_t id;
+        uint64_t action;
+        uint64_t days;
+        uint64_t hour;
+        uint64_t minute;
+        if (!reader.read_array(fields) || fields != 5 ||
+            !read_bounded(reader, SCHEDULER_MAX - 1, id) ||
+            !read_bounded(reader, SCHEDULE_ACTION_COUNT - 1, action) ||
+            !read_bounded(reader, SCHEDULE_DAILY, days) || days == 0 ||
+            !read_bounded(reader, 23, hour) ||
+            !read_bounded(reader, 59, minute) ||
+            document.table.entries[id].days != 0) {
+            return false;
+        }
+        document.table.entries[id] = { (uint8_t)action, (uint8_t)days, (uint8_t)hour, (uint8_t)minute };
+    }
+    return true;
+}
+
+static bool read_machine(CBORReader& reader, provision_document_t& document) {
+    size_t count;
+    if (!reader.read_map(count)) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key;
+        uint64_t minutes;
+        if (!reader.read_uint(key)) {
+            return false;
+        }
+        if (key == PROVISION_MACHINE_AUTO_OFF) {
+            if (!read_bounded(reader, SCHEDULER_MAX_AUTO_OFF, minutes)) {
+                return false;
+            }
+            document.table.auto_off_minutes = minutes;
+        } else if (!reader.skip()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The whole document is decoded and validated before anything is
+// returned, so a partly invalid document is rejected as a whole.
+provision_result_t Provision::read(const uint8_t* data, size_t length, provision_document_t& document) {
+    document = {};
+    CBORReader reader(data, length);
+    size_t count;
+    if (!reader.read_map(count)) {
+        return PROVISION_ERR_MALFORMED;
+    }
+    bool versioned = false;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key;
+        if (!reader.read_uint(key)) {
+            return PROVISION_ERR_MALFORMED;
+        }
+        switch (key) {
+            case PROVISION_KEY_VERSION: {
+                uint64_t version;
+                if (!reader.read_uint(version)) {
+                    return PROVISION_ERR_MALFORMED;
+                }
+                if (version == 0 || version > PROVISION_VERSION) {
+                    return PROVISION_ERR_VERSION;
+                }
+                versioned = true;
+                break;
+            }
+            case PROVISION_KEY_NETWORKS:
+                if (!read_networks(reader, document)) {
+                    return reader.ok() ? PROVISION_ERR_NETWORK : PROVISION_ERR_MALFORMED;
+                }
+                document.sections |= PROVISION_NETWORKS;
+                break;
+            case PROVISION_KEY_SCHEDULES:
+                if (!read_schedules(reader, document)) {
+                    return reader.ok() ? PROVISION_ERR_SCHEDULE : PROVISION_ERR_MALFORMED;
+                }
+                document.sections |= PROVISION_SCHEDULES;
+                break;
+            case PROVISION_KEY_MACHINE:
+                if (!read_machine(reader, document)) {
+                    return reader.ok() ? PROVISION_ERR_MACHINE : PROVISION_ERR_MALFORMED;
+                }
+                document.sections |= PROVISION_MACHINE;
+                break;
+            default:
+                if (!reader.skip()) {
+                    return PROVISION_ERR_MALFORMED;
+                }
+        }
+    }
+    if (!reader.at_end()) {
+        return PROVISION_ERR_MALFORMED;
+    }
+    return versioned ? PROVISION_OK : PROVISION_ERR_VERSION;
+}
+
+// Overlays the schedule and machine sections of document onto table.
+void Provision::merge(const provision_document_t& document, scheduler_table_t& table) {
+    if (document.sections & PROVISION_SCHEDULES) {
+        memcpy(table.entries, document.table.entries, sizeof(table.entries));
+    }
+    if (document.sections & PROVISION_MACHINE) {
+        table.auto_off_minutes = document.table.auto_off_minutes;
+    }
+}
+
+const char* Provision::describe(provision_result_t result) {
+    switch (result) {
+        case PROVISION_OK:              return "OK";
+        case PROVISION_ERR_MALFORMED:   return "Malformed configuration document!";
+        case PROVISION_ERR_VERSION:     return "Unsupported configuration version!";
+        case PROVISION_ERR_NETWORK:     return "Invalid network profiles!";
+        case PROVISION_ERR_SCHEDULE:    return "Invalid schedules!";
+        case PROVISION_ERR_MACHINE:     return "Invalid machine settings!";
+    }
+    return "Unknown error!";
+}
+
+bool Provision::stage(const uint8_t* data, size_t length) {
+    try {
+        NVStorage storage(PROVISION_NAMESPACE, true);
+        return storage.set_blob(PROVISION_STAGED_KEY, data, length);
+    } catch (int error) {
+        ESP_LOGE(LOG_TAG, "Stage: Unable to access NVS.");
+        return false;
+    }
+}
+
+bool Provision::staged(provision_document_t& document) {
+    uint8_t data[PROVISION_MAX_LENGTH];
+    size_t length = sizeof(data);
+    try {
+        NVStorage storage(PROVISION_NAMESPACE, false);
+        if (storage.read_blob(PROVISION_STAGED_KEY, data, length) != ESP_OK) {
+            return false;
+        }
+    } catch (int error) {
+        return false;
+    }
+    return Provision::read(data, length, document) == PROVISION_OK;
+}
+
+bool Provision::clear() {
+    try {
+        NVStorage storage(PROVISION_NAMESPACE, true);
+        return storage.erase_key(PROVISION_STAGED_KEY);
+    } catch (int error) {
+        ESP_LOGE(LOG_TAG, "Clear: Unable to access NVS.");
+        return false;
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef PROVISION_H
+#define PROVISION_H
+
+#include "config.hpp"
+#include "scheduler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#define PROVISION_VERSION       1
+#define PROVISION_MAX_LENGTH    768
+#define PROVISION_NAMESPACE     "provision"
+#define PROVISION_STAGED_KEY    "staged"
+
+#define PROVISION_NETWORKS      (1 << 0)
+#define PROVISION_SCHEDULES     (1 << 1)
+#define PROVISION_MACHINE       (1 << 2)
+
+// Keys of the top-level map and of the machine settings map. Keys are
+// small integers so each costs one byte; new keys are only ever added,
+// and readers skip keys they do not know.
+typedef enum {
+    PROVISION_KEY_VERSION = 0,
+    PROVISION_KEY_NETWORKS = 1,
+    PROVISION_KEY_SCHEDULES = 2,
+    PROVISION_KEY_MACHINE = 3,
+} provision_key_t;
+
+typedef enum {
+    PROVISION_MACHINE_AUTO_OFF = 0,
+} provision_machine_key_t;
+
+typedef enum {
+    PROVISION_OK = 0,
+    PROVISION_ERR_MALFORMED,
+    PROVISION_ERR_VERSION,
+    PROVISION_ERR_NETWORK,
+    PROVISION_ERR_SCHEDULE,
+    PROVISION_ERR_MACHINE,
+} provision_result_t;
+
+// Decoded and validated document. Only the sections flagged in sections
+// were present; the others are left as they are on import.
+typedef struct {
+    uint32_t sections;
+    config_profile_t networks[CONFIG_MAX_PROFILES];
+    size_t network_count;
+    scheduler_table_t table;
+} provision_document_t;
+
+// Device configuration as one CBOR document:
+//
+//   { 0: version,
+//     1: [[ssid, psk, security, priority], ...],
+//     2: [[id, action, days, hour, minute], ...],
+//     3: { 0: auto-off minutes } }
+//
+// Encoding and validation are free of platform code; applying a document
+// is left to the caller.
+//
+// Networks and schedules live in different NVS namespaces, so an import
+// is first staged as one blob. Boot reads a staged document once and
+// applies it, which completes an import that was cut short between its
+// writes; it is cleared once every section is stored.
+class Provision {
+public:
+    static size_t write(const Config& config, const scheduler_table_t& table, uint8_t* buffer, size_t size);
+    static provision_result_t read(const uint8_t* data, size_t length, provision_document_t& document);
+    static void merge(const provision_document_t& document, scheduler_table_t& table);
+    static const char* describe(provision_result_t result);
+
+    static bool stage(const uint8_t* data, size_t length);
+    static bool staged(provision_document_t& document);
+    static bool clear();
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "push.hpp"
+#include "json.hpp"
+#include "io.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+
+#include <cstring>
+#include <mutex>
+
+#define LOG_TAG "push.cpp"
+
+typedef struct {
+    int fd;
+    bool full;
+    uint8_t failures;
+} push_client_t;
+
+static httpd_handle_t server = NULL;
+static TaskHandle_t task = NULL;
+static std::mutex clients_mutex;
+static push_client_t attached[PUSH_MAX_CLIENTS];
+static size_t client_count = 0;
+static uint32_t sequence = 0;
+
+static void status_listener(const io_status_t& status, void* context) {
+    if (task != NULL) {
+        xTaskNotifyGive(task);
+    }
+}
+
+static size_t render(char* buffer, const io_status_t& status, const io_status_t* previous) {
+    JSON json(buffer, PUSH_MESSAGE_SIZE, false);
+    json.add_int("seq", sequence);
+    if (previous == NULL || previous->state != status.state) {
+        json.add_string("state", Machine::describe(status.state));
+    }
+    if (previous == NULL || previous->heater != status.heater) {
+        json.add_bool("heater", status.heater);
+    }
+    if (previous == NULL || previous->water != status.water) {
+        json.add_bool("water", status.water);
+    }
+    return json.finalize() ? json.length() : 0;
+}
+
+static bool send(push_client_t& client, char* message, size_t length) {
+    if (httpd_ws_get_fd_info(server, client.fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+        return false;
+    }
+    httpd_ws_frame_t frame = {};
+    frame.type = HTTPD_WS_TYPE_TEXT;
+    frame.payload = (uint8_t*)message;
+    frame.len = length;
+    if (httpd_ws_send_frame_async(server, client.fd, &frame) == ESP_OK) {
+        client.failures = 0;
+        return true;
+    }
+    if (++client.failures < PUSH_MAX_FAILURES) {
+        return true;
+    }
+    ESP_LOGW(LOG_TAG, "Send: Dropping slow client %d.", client.fd);
+    httpd_sess_trigger_close(server, client.fd);
+    return false;
+}
+
+static void push_task(void* parameters) {
+    io_status_t last = IO::status();
+    char delta[PUSH_MESSAGE_SIZE];
+    char full[PUSH_MESSAGE_SIZE];
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(PUSH_COALESCE_MS));
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        io_status_t status = IO::status();
+        bool changed = (status.state != last.state || status.heater != last.heater || status.water != last.water);
+        size_t delta_length = 0;
+        if (changed) {
+            sequence++;
+            delta_length = render(delta, status, &last);
+        }
+        size_t full_length = render(full, status, NULL);
+        last = status;
+
+        // Frames are sent from a copy of the client list, so a slow socket
+        // never holds clients_mutex while attach/detach wait for it on
+        // the httpd task.
+        push_client_t targets[PUSH_MAX_CLIENTS];
+        size_t target_count;
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex);
+            target_count = client_count;
+            memcpy(targets, attached, sizeof(push_client_t) * target_count);
+        }
+        bool alive[PUSH_MAX_CLIENTS];
+        for (size_t i = 0; i < target_count; i++) {
+            alive[i] = true;
+            if (targets[i].full) {
+                alive[i] = send(targets[i], full, full_length);
+            } else if (changed) {
+                alive[i] = send(targets[i], delta, delta_length);
+            }
+        }
+
+        // Clients attached meanwhile are kept as they are, detached ones
+        // are already gone.
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        for (size_t i = 0; i < target_count; i++) {
+            for (size_t j = 0; j < client_count; j++) {
+                if (attached[j].fd != targets[i].fd) {
+                    continue;
+                }
+                if (alive[i]) {
+                    attached[j].failures = targets[i].failures;
+                    attached[j].full = false;
+                } else {
+                    attached[j] = attached[--client_count];
+                }
+                break;
+            }
+        }
+    }
+}
+
+bool Push::init(httpd_handle_t handle) {
+    server = handle;
+    if (task != NULL) {
+        return true;
+    }
+    if (xTaskCreate(push_task, "push", PUSH_TASK_STACK_SIZE, NULL, PUSH_TASK_PRIORITY, &task) != pdPASS) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create push task!");
+        return false;
+    }
+    return IO::subscribe(status_listener, NULL);
+}
+
+bool Push::attach(int fd) {
+    if (task == NULL) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        for (size_t i = 0; i < client_count; i++) {
+            if (attached[i].fd == fd) {
+                return true;
+            }
+        }
+        if (client_count == PUSH_MAX_CLIENTS) {
+            ESP_LOGW(LOG_TAG, "Attach: Client limit reached, rejecting %d.", fd);
+            return false;
+        }
+        attached[client_count++] = { fd, true, 0 };
+    }
+    xTaskNotifyGive(task);
+    return true;
+}
+
+void Push::detach(int fd) {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    for (size_t i = 0; i < client_count; i++) {
+        if (attached[i].fd == fd) {
+            attached[i] = attached[--client_count];
+            return;
+        }
+    }
+}
+
+size_t Push::clients() {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    return client_count;
+}
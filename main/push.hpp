@@ -0,0 +1,25 @@
+#ifndef PUSH_H
+#define PUSH_H
+
+#include "esp_http_server.h"
+
+#define PUSH_MAX_CLIENTS        4
+#define PUSH_COALESCE_MS        50
+#define PUSH_MAX_FAILURES       3
+#define PUSH_MESSAGE_SIZE       128
+#define PUSH_TASK_STACK_SIZE    4096
+#define PUSH_TASK_PRIORITY      5
+
+// Live status over WebSocket. Status changes wake a push task, which
+// waits PUSH_COALESCE_MS to fold bursts into one update and sends every
+// attached client only the fields that changed. Clients whose sends keep
+// failing are disconnected instead of holding up the others.
+class Push {
+public:
+    static bool init(httpd_handle_t server);
+    static bool attach(int fd);
+    static void detach(int fd);
+    static size_t clients();
+};
+
+#endif
@@ -1,52 +1,183 @@
 #include "query.hpp"
+#include "json_reader.hpp"
+
+#include "esp_log.h"
 
 #include <cstring>
 
+#define LOG_TAG "query.cpp"
+
 Query::Query(const char* query) {
-    this->query = std::string(query);
-    this->empty = false;
+    this->count = 0;
+    this->embedding = nullptr;
+    size_t length = (query == nullptr ? 0 : strlen(query));
+    if (length >= QUERY_MAX_LENGTH) {
+        ESP_LOGW(LOG_TAG, "Query: Query of %u bytes exceeds limit, ignoring.", (unsigned)length);
+        return;
+    }
+    memcpy(this->buffer, query, length);
+    this->parse(length);
 }
 
 Query::Query(httpd_req_t* request) {
-    this->empty = true;
-    size_t query_len = httpd_req_get_url_query_len(request) + 1;
-    if (query_len > 1) {
-        char* query_buffer = (char*)calloc(sizeof(char), query_len);
-        if (httpd_req_get_url_query_str(request, query_buffer, query_len) == ESP_OK) {
-            this->query = std::string(query_buffer);
-            this->empty = false;
+    this->count = 0;
+    this->embedding = nullptr;
+    size_t length = httpd_req_get_url_query_len(request);
+    if (length == 0) {
+        return;
+    }
+    if (length >= QUERY_MAX_LENGTH) {
+        ESP_LOGW(LOG_TAG, "Query: Query of %u bytes exceeds limit, ignoring.", (unsigned)length);
+        return;
+    }
+    if (httpd_req_get_url_query_str(request, this->buffer, length + 1) == ESP_OK) {
+        this->parse(length);
+    }
+}
+
+void Query::parse(size_t length) {
+    size_t start = 0;
+    while (start < length && this->count < QUERY_MAX_PARAMS) {
+        char* pair = this->buffer + start;
+        char* end = (char*)memchr(pair, '&', length - start);
+        size_t pair_length = (end == nullptr ? length - start : end - pair);
+        start += pair_length + 1;
+        if (pair_length == 0) {
+            continue;
+        }
+        char* separator = (char*)memchr(pair, '=', pair_length);
+        size_t key_length = (separator == nullptr ? pair_length : separator - pair);
+        char* value = (separator == nullptr ? pair + pair_length : separator + 1);
+        size_t value_length = (separator == nullptr ? 0 : pair_length - key_length - 1);
+        if (!Query::decode(pair, key_length) || !Query::decode(value, value_length)) {
+            ESP_LOGW(LOG_TAG, "Parse: Skipping parameter with malformed escape.");
+            continue;
         }
-        free(query_buffer);
+        this->keys[this->count] = std::string_view(pair, key_length);
+        this->values[this->count] = std::string_view(value, value_length);
+        this->count++;
     }
 }
 
-std::string Query::get(std::string key) {
-    if (!this->empty) {
-        size_t pos = this->query.find(key + "=");
-        if (pos != std::string::npos) {
-            size_t start = pos + key.length() + 1;
-            size_t end = this->query.find("&", start);
-            size_t len = (end == std::string::npos ? std::string::npos : end - start);
-            std::string value = this->query.substr(start, len);
-            return this->decode(value);
+// Adds the scalar members of a JSON object body as parameters, after
+// any from the URL. Numbers and booleans keep their literal text; nulls
+// and nested values are skipped. The views point into body, which has
+// to outlive the query.
+bool Query::parse_json(char* body, size_t length) {
+    JSONReader reader(body, length);
+    return reader.ok() && this->add_json(reader, JSON_READER_ROOT);
+}
+
+// Adds the scalar members of an object token. Values stay views into the
+// reader's buffer, which has to outlive this query.
+bool Query::add_json(const JSONReader& reader, int object) {
+    if (reader.token(object).type != JSON_TOKEN_OBJECT) {
+        return false;
+    }
+    int index = object + 1;
+    for (uint16_t member = 0; member < reader.token(object).size; member++) {
+        const json_token_t& value = reader.token(index + 1);
+        if ((value.type == JSON_TOKEN_STRING || value.type == JSON_TOKEN_NUMBER || value.type == JSON_TOKEN_BOOLEAN) &&
+            this->count < QUERY_MAX_PARAMS) {
+            this->keys[this->count] = reader.view(index);
+            this->values[this->count] = reader.view(index + 1);
+            this->count++;
         }
+        index = value.next;
     }
-    return {};
+    return true;
 }
 
-std::string Query::decode(std::string value) {
-    std::string result;
-    for (int i = 0; i < value.length(); i++) {
+int Query::hex_value(char value) {
+    if (value >= '0' && value <= '9') {
+        return value - '0';
+    }
+    if (value >= 'a' && value <= 'f') {
+        return value - 'a' + 10;
+    }
+    if (value >= 'A' && value <= 'F') {
+        return value - 'A' + 10;
+    }
+    return -1;
+}
+
+bool Query::decode_hex(char high, char low, char& out) {
+    int high_value = Query::hex_value(high);
+    int low_value = Query::hex_value(low);
+    if (high_value < 0 || low_value < 0) {
+        return false;
+    }
+    out = static_cast<char>((high_value << 4) | low_value);
+    return true;
+}
+
+bool Query::decode(char* value, size_t& length) {
+    size_t out = 0;
+    for (size_t i = 0; i < length; i++) {
         if (value[i] == '%') {
-            int current;
-            sscanf(value.substr(i + 1, 2).c_str(), "%x", &current);
-            result += (char)current;
+            if (i + 2 >= length) {
+                return false;
+            }
+            if (!Query::decode_hex(value[i + 1], value[i + 2], value[out])) {
+                return false;
+            }
             i += 2;
         } else if (value[i] == '+') {
-            result += ' ';
+            value[out] = ' ';
         } else {
-            result += value[i];
+            value[out] = value[i];
         }
+        out++;
     }
-    return result;
-}
\ No newline at end of file
+    length = out;
+    return true;
+}
+
+std::string_view Query::get(std::string_view key) {
+    for (size_t i = 0; i < this->count; i++) {
+        if (this->keys[i] == key) {
+            return this->values[i];
+        }
+    }
+    return {};
+}
+
+bool Query::get_uint(std::string_view key, uint32_t& out) {
+    std::string_view value = this->get(key);
+    if (value.empty() || value.length() > 10) {
+        return false;
+    }
+    uint64_t result = 0;
+    for (char current : value) {
+        if (current < '0' || current > '9') {
+            return false;
+        }
+        result = result * 10 + (current - '0');
+    }
+    if (result > UINT32_MAX) {
+        return false;
+    }
+    out = (uint32_t)result;
+    return true;
+}
+
+bool Query::has(std::string_view key) {
+    for (size_t i = 0; i < this->count; i++) {
+        if (this->keys[i] == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t Query::size() {
+    return this->count;
+}
+
+void Query::embed(struct json_embed* enclosing) {
+    this->embedding = enclosing;
+}
+
+struct json_embed* Query::embedded() {
+    return this->embedding;
+}
@@ -3,16 +3,40 @@
 
 #include "esp_http_server.h"
 
-#include <string>
+#include <string_view>
 
+#define QUERY_MAX_LENGTH    512
+#define QUERY_MAX_PARAMS    16
+
+class JSONReader;
+struct json_embed;
+
+// Query string tokenized once on construction. Keys and values are
+// percent-decoded in place and looked up as views into the internal
+// buffer, so repeated lookups neither rescan nor allocate.
 class Query {
-    bool empty;
-    std::string query;
-    std::string decode(std::string value);
+    char buffer[QUERY_MAX_LENGTH];
+    std::string_view keys[QUERY_MAX_PARAMS];
+    std::string_view values[QUERY_MAX_PARAMS];
+    size_t count;
+    struct json_embed* embedding;
+    void parse(size_t length);
+    static bool decode(char* value, size_t& length);
 public:
     Query(const char* query);
     Query(httpd_req_t* request);
-    std::string get(std::string key);
+    bool parse_json(char* body, size_t length);
+    bool add_json(const JSONReader& reader, int object);
+    static int hex_value(char value);
+    static bool decode_hex(char high, char low, char& out);
+    std::string_view get(std::string_view key);
+    bool get_uint(std::string_view key, uint32_t& out);
+    bool has(std::string_view key);
+    size_t size();
+
+    // Response the command's JSON is embedded in, e.g. by a batch.
+    void embed(struct json_embed* enclosing);
+    struct json_embed* embedded();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,62 @@
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free single-producer/single-consumer ring of fixed-size items.
+// push() never blocks: when the ring is full the item is dropped and
+// counted as an overrun. The consumer reads items in place with at() and
+// span() and releases them with pop().
+template <typename T, size_t N>
+class Ring {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Ring capacity must be a power of two");
+
+    T items[N];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> overruns{0};
+
+public:
+    bool push(const T& item) {
+        uint32_t current = this->head.load(std::memory_order_relaxed);
+        if (current - this->tail.load(std::memory_order_acquire) == N) {
+            this->overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        this->items[current & (N - 1)] = item;
+        this->head.store(current + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return this->head.load(std::memory_order_acquire) - this->tail.load(std::memory_order_relaxed);
+    }
+
+    // index-th oldest item; index must be below size().
+    const T& at(size_t index) const {
+        return this->items[(this->tail.load(std::memory_order_relaxed) + index) & (N - 1)];
+    }
+
+    // Number of items starting at index that are contiguous in memory,
+    // at most count.
+    size_t span(size_t index, size_t count) const {
+        size_t offset = (this->tail.load(std::memory_order_relaxed) + index) & (N - 1);
+        return (count < N - offset ? count : N - offset);
+    }
+
+    void pop(size_t count) {
+        this->tail.store(this->tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    uint32_t overrun_count() const {
+        return this->overruns.load(std::memory_order_relaxed);
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+};
+
+#endif
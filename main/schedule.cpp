@@ -0,0 +1,141 @@
+#include "schedule.hpp"
+#include "nvstorage.hpp"
+
+#include "esp_log.h"
+
+#define LOG_TAG "schedule.cpp"
+
+static const char* const day_names[7] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+
+bool Schedule::parse_action(std::string_view text, schedule_action_t& action) {
+    for (int candidate = 0; candidate < SCHEDULE_ACTION_COUNT; candidate++) {
+        if (text == Schedule::describe(static_cast<schedule_action_t>(candidate))) {
+            action = static_cast<schedule_action_t>(candidate);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Accepts "daily", "weekdays", "weekends" or a comma-separated list of
+// three-letter day names.
+bool Schedule::parse_days(std::string_view text, uint8_t& days) {
+    if (text == "daily") {
+        days = SCHEDULE_DAILY;
+        return true;
+    }
+    if (text == "weekdays") {
+        days = SCHEDULE_WEEKDAYS;
+        return true;
+    }
+    if (text == "weekends") {
+        days = SCHEDULE_WEEKENDS;
+        return true;
+    }
+    uint8_t result = 0;
+    while (!text.empty()) {
+        size_t comma = text.find(',');
+        std::string_view name = text.substr(0, comma);
+        int day = 0;
+        while (day < 7 && name != day_names[day]) {
+            day++;
+        }
+        if (day == 7) {
+            return false;
+        }
+        result |= (1 << day);
+        text = (comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1));
+    }
+    if (result == 0) {
+        return false;
+    }
+    days = result;
+    return true;
+}
+
+// Accepts HH:MM in 24-hour format.
+bool Schedule::parse_time(std::string_view text, uint8_t& hour, uint8_t& minute) {
+    if (text.length() != 5 || text[2] != ':') {
+        return false;
+    }
+    for (int i : { 0, 1, 3, 4 }) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+    }
+    int hours = (text[0] - '0') * 10 + (text[1] - '0');
+    int minutes = (text[3] - '0') * 10 + (text[4] - '0');
+    if (hours > 23 || minutes > 59) {
+        return false;
+    }
+    hour = hours;
+    minute = minutes;
+    return true;
+}
+
+// Seconds from now until the next matching day and time, at least one
+// and at most a week. Occurrences within skip seconds of now are passed
+// over, so a timer that fired slightly early does not match the same
+// minute again. Daylight saving changes are not accounted for; recurring
+// schedules are re-armed from the wall clock after every run.
+uint32_t Schedule::seconds_until(const schedule_t& schedule, const struct tm& now, uint32_t skip) {
+    int32_t elapsed = now.tm_hour * 3600 + now.tm_min * 60 + now.tm_sec + skip;
+    int32_t target = schedule.hour * 3600 + schedule.minute * 60;
+    // The skip may carry elapsed past midnight, hence one extra day.
+    for (int offset = 0; offset <= 8; offset++) {
+        int day = (now.tm_wday + offset) % 7;
+        int32_t delta = offset * 86400 + target - elapsed;
+        if ((schedule.days & (1 << day)) && delta > 0) {
+            return delta + skip;
+        }
+    }
+    return 7 * 86400 + skip;
+}
+
+machine_command_t Schedule::command(schedule_action_t action) {
+    switch (action) {
+        case SCHEDULE_BREW_ONE:         return MACHINE_BREW_ONE;
+        case SCHEDULE_BREW_TWO:         return MACHINE_BREW_TWO;
+        case SCHEDULE_POWER_ON:         return MACHINE_POWER_ON;
+        case SCHEDULE_POWER_OFF:
+        case SCHEDULE_ACTION_COUNT:     break;
+    }
+    return MACHINE_POWER_OFF;
+}
+
+const char* Schedule::describe(schedule_action_t action) {
+    switch (action) {
+        case SCHEDULE_BREW_ONE:         return "brew1";
+        case SCHEDULE_BREW_TWO:         return "brew2";
+        case SCHEDULE_POWER_ON:         return "on";
+        case SCHEDULE_POWER_OFF:        return "off";
+        case SCHEDULE_ACTION_COUNT:     break;
+    }
+    return "unknown";
+}
+
+// Reads the stored table. A unit that never saved one has no namespace
+// yet; it starts out empty, as after any failed read.
+bool Schedule::load(scheduler_table_t& table) {
+    try {
+        NVStorage storage(SCHEDULER_NAMESPACE, false);
+        size_t length = sizeof(table);
+        if (storage.get_blob(SCHEDULER_KEY, &table, length) && length == sizeof(table)) {
+            return true;
+        }
+    } catch (int error) {
+        ESP_LOGD(LOG_TAG, "Load: No schedules stored.");
+    }
+    table = {};
+    return false;
+}
+
+bool Schedule::save(const scheduler_table_t& table) {
+    try {
+        NVStorage storage(SCHEDULER_NAMESPACE, true);
+        return storage.set_blob(SCHEDULER_KEY, &table, sizeof(table));
+    } catch (int error) {
+        ESP_LOGE(LOG_TAG, "Save: Unable to access NVS.");
+        return false;
+    }
+}
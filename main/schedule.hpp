@@ -0,0 +1,56 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "machine.hpp"
+
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+
+#define SCHEDULE_DAILY      0x7F
+#define SCHEDULE_WEEKDAYS   0x3E
+#define SCHEDULE_WEEKENDS   0x41
+#define SCHEDULE_REARM_SKIP 60
+
+#define SCHEDULER_MAX       8
+#define SCHEDULER_NAMESPACE "scheduler"
+#define SCHEDULER_KEY       "table"
+
+typedef enum {
+    SCHEDULE_BREW_ONE,
+    SCHEDULE_BREW_TWO,
+    SCHEDULE_POWER_ON,
+    SCHEDULE_POWER_OFF,
+    SCHEDULE_ACTION_COUNT,
+} schedule_action_t;
+
+// Recurring event at a local wall-clock time. Bit n of days is weekday n
+// as in struct tm (0 = Sunday); an entry without days is unused.
+typedef struct __attribute__((packed)) {
+    uint8_t action;
+    uint8_t days;
+    uint8_t hour;
+    uint8_t minute;
+} schedule_t;
+
+// Schedules plus the auto-off delay, persisted as one blob.
+typedef struct __attribute__((packed)) {
+    uint16_t auto_off_minutes;
+    schedule_t entries[SCHEDULER_MAX];
+} scheduler_table_t;
+
+// Parsing, calendar arithmetic and storage for schedules, kept free of
+// any platform code.
+class Schedule {
+public:
+    static bool parse_action(std::string_view text, schedule_action_t& action);
+    static bool parse_days(std::string_view text, uint8_t& days);
+    static bool parse_time(std::string_view text, uint8_t& hour, uint8_t& minute);
+    static uint32_t seconds_until(const schedule_t& schedule, const struct tm& now, uint32_t skip = 0);
+    static machine_command_t command(schedule_action_t action);
+    static const char* describe(schedule_action_t action);
+    static bool load(scheduler_table_t& table);
+    static bool save(const scheduler_table_t& table);
+};
+
+#endif
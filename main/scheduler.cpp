@@ -0,0 +1,363 @@
+#include "scheduler.hpp"
+#include "wheel.hpp"
+#include "io.hpp"
+#include "commands.hpp"
+#include "journal.hpp"
+#include "json.hpp"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_sntp.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+#define LOG_TAG "scheduler.cpp"
+
+#define SCHEDULER_NOTIFY_TIMER      (1 << 0)
+#define SCHEDULER_NOTIFY_STATUS     (1 << 1)
+#define SCHEDULER_NOTIFY_CLOCK      (1 << 2)
+
+// Any wall clock before this has not been set by SNTP yet.
+#define SCHEDULER_CLOCK_VALID       1577836800
+
+#define SCHEDULER_AUTO_OFF          SCHEDULER_MAX
+
+static std::mutex wheel_mutex;
+static TimerWheel<SCHEDULER_WHEEL_LEVELS, SCHEDULER_WHEEL_BITS> wheel;
+static WheelTimer timers[SCHEDULER_MAX + 1];
+static scheduler_table_t schedules = {};
+static scheduler_jitter_t jitters = {};
+static esp_timer_handle_t alarm = NULL;
+static TaskHandle_t task = NULL;
+static machine_state_t machine_state = MACHINE_IDLE;
+static int pending_brew = -1;
+
+static uint32_t current_tick() {
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+// Arms the esp_timer for the next tick that has work. Callers hold
+// wheel_mutex.
+static void rearm() {
+    esp_timer_stop(alarm);
+    uint32_t next = wheel.next_event();
+    if (next == UINT32_MAX) {
+        return;
+    }
+    int64_t delay = (int64_t)next * 1000000 - esp_timer_get_time();
+    esp_timer_start_once(alarm, delay > 0 ? delay : 0);
+}
+
+// Puts schedule id on the wheel at its next wall-clock occurrence more
+// than skip seconds away, if the clock is known. Callers hold wheel_mutex.
+static void arm(int id, uint32_t skip) {
+    const schedule_t& schedule = schedules.entries[id];
+    time_t now = time(NULL);
+    if (schedule.days == 0 || now < SCHEDULER_CLOCK_VALID) {
+        wheel.cancel(&timers[id]);
+        return;
+    }
+    struct tm local;
+    localtime_r(&now, &local);
+    wheel.schedule(&timers[id], current_tick() + Schedule::seconds_until(schedule, local, skip));
+}
+
+// Auto-off runs while the machine sits powered but unused; brewing,
+// descaling or switching off cancels it. Callers hold wheel_mutex.
+static void update_auto_off(machine_state_t state) {
+    WheelTimer* timer = &timers[SCHEDULER_AUTO_OFF];
+    if (schedules.auto_off_minutes > 0 && (state == MACHINE_HEATING || state == MACHINE_READY)) {
+        if (!timer->pending() || state != machine_state) {
+            wheel.schedule(timer, current_tick() + schedules.auto_off_minutes * 60);
+        }
+    } else {
+        wheel.cancel(timer);
+    }
+    machine_state = state;
+}
+
+static bool save() {
+    return Schedule::save(schedules);
+}
+
+
+static void run(machine_command_t command, uint32_t due) {
+    io_command_result_t result = IO::command(command);
+    int64_t late = esp_timer_get_time() - (int64_t)due * 1000000;
+    uint32_t jitter = (uint32_t)(late > 0 ? late : 0);
+    {
+        std::lock_guard<std::mutex> lock(wheel_mutex);
+        jitters.count++;
+        jitters.last_us = jitter;
+        if (jitter > jitters.max_us) {
+            jitters.max_us = jitter;
+        }
+    }
+    JOURNAL_LOGI(LOG_TAG, "Command %d sent %u us after due, %s.", (int)command,
+        (unsigned)jitter, result == IO_COMMAND_ACCEPTED ? "accepted" :
+                          result == IO_COMMAND_PENDING ? "pending" : "rejected");
+}
+
+// Scheduled brews power the machine on first if needed; the brew itself
+// is sent once the machine reports ready.
+static void scheduler_task(void* parameters) {
+    // Every timer plus a pending brew can come due in one wakeup.
+    machine_command_t fired[SCHEDULER_MAX + 2];
+    uint32_t due[SCHEDULER_MAX + 2];
+    while (true) {
+        uint32_t reasons = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &reasons, portMAX_DELAY);
+        size_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock(wheel_mutex);
+            if (reasons & SCHEDULER_NOTIFY_CLOCK) {
+                for (int id = 0; id < SCHEDULER_MAX; id++) {
+                    arm(id, 0);
+                }
+            }
+            if (reasons & SCHEDULER_NOTIFY_STATUS) {
+                machine_state_t state = IO::status().state;
+                if (state == MACHINE_READY && pending_brew >= 0) {
+                    fired[count] = static_cast<machine_command_t>(pending_brew);
+                    due[count++] = current_tick();
+                    pending_brew = -1;
+                } else if (state == MACHINE_IDLE || state == MACHINE_ERROR) {
+                    pending_brew = -1;
+                }
+                update_auto_off(state);
+            }
+            wheel.advance(current_tick(), [&](WheelTimer* timer) {
+                int id = timer - timers;
+                machine_command_t command = MACHINE_POWER_OFF;
+                // Re-arming moves timer->expires; the tick is not aligned
+                // to the wall clock, so the occurrence that just fired may
+                // still lie ahead of time(NULL) and must be skipped.
+                due[count] = timer->expires;
+                if (id != SCHEDULER_AUTO_OFF) {
+                    command = Schedule::command(static_cast<schedule_action_t>(schedules.entries[id].action));
+                    arm(id, SCHEDULE_REARM_SKIP);
+                }
+                bool brew = (command == MACHINE_BREW_ONE || command == MACHINE_BREW_TWO);
+                if (brew && (machine_state == MACHINE_IDLE || machine_state == MACHINE_HEATING)) {
+                    pending_brew = command;
+                    command = MACHINE_POWER_ON;
+                }
+                fired[count++] = command;
+            });
+            rearm();
+        }
+        for (size_t i = 0; i < count; i++) {
+            run(fired[i], due[i]);
+        }
+    }
+}
+
+static void alarm_callback(void* argument) {
+    xTaskNotify(task, SCHEDULER_NOTIFY_TIMER, eSetBits);
+}
+
+static void status_listener(const io_status_t& status, void* context) {
+    xTaskNotify(task, SCHEDULER_NOTIFY_STATUS, eSetBits);
+}
+
+static void clock_synced(struct timeval* tv) {
+    JOURNAL_LOGI(LOG_TAG, "Clock synchronized.");
+    xTaskNotify(task, SCHEDULER_NOTIFY_CLOCK, eSetBits);
+}
+
+static esp_err_t schedule_command(httpd_req_t* request, Query& query) {
+    schedule_t schedule = {};
+    schedule_action_t action;
+    std::string_view days = query.get("days");
+    if (!Schedule::parse_action(query.get("action"), action)) {
+        JSON::simple_response(request, query, false, "Parameter 'action' must be brew1, brew2, on or off!");
+        return ESP_OK;
+    }
+    if (!Schedule::parse_time(query.get("time"), schedule.hour, schedule.minute)) {
+        JSON::simple_response(request, query, false, "Parameter 'time' must be HH:MM!");
+        return ESP_OK;
+    }
+    schedule.days = SCHEDULE_DAILY;
+    if (!days.empty() && !Schedule::parse_days(days, schedule.days)) {
+        JSON::simple_response(request, query, false, "Parameter 'days' must be daily, weekdays, weekends or e.g. mon,wed!");
+        return ESP_OK;
+    }
+    schedule.action = action;
+    int id = Scheduler::add(schedule);
+    if (id < 0) {
+        JSON::simple_response(request, query, false, "Could not add schedule!");
+        return ESP_OK;
+    }
+    JSON(request, query)
+        .add_bool("success", true)
+        .add_string("message", "Schedule added.")
+        .add_int("id", id)
+        .finalize();
+    return ESP_OK;
+}
+
+static esp_err_t unschedule_command(httpd_req_t* request, Query& query) {
+    uint32_t id;
+    bool success = query.get_uint("id", id) && id < SCHEDULER_MAX && Scheduler::remove(id);
+    JSON::simple_response(request, query, success, success ? "Schedule removed." : "No schedule with this 'id'!");
+    return ESP_OK;
+}
+
+static esp_err_t auto_off_command(httpd_req_t* request, Query& query) {
+    uint32_t minutes;
+    if (!query.get_uint("minutes", minutes) || minutes > SCHEDULER_MAX_AUTO_OFF) {
+        JSON::simple_response(request, query, false, "Parameter 'minutes' must be between 0 and 240!");
+        return ESP_OK;
+    }
+    bool success = Scheduler::set_auto_off(minutes);
+    JSON::simple_response(request, query, success, success ? "Auto-off updated." : "Could not update auto-off!");
+    return ESP_OK;
+}
+
+static esp_err_t schedules_command(httpd_req_t* request, Query& query) {
+    scheduler_table_t table = Scheduler::table();
+    scheduler_jitter_t jitter = Scheduler::jitter();
+    JSON json(request, query);
+    json.add_bool("success", true)
+        .add_string("message", "Schedules by id, times are local.")
+        .add_int("auto_off", table.auto_off_minutes)
+        .begin_object("jitter")
+            .add_int("count", jitter.count)
+            .add_int("last_us", jitter.last_us)
+            .add_int("max_us", jitter.max_us)
+        .end_object()
+        .begin_object("schedules");
+    for (int id = 0; id < SCHEDULER_MAX; id++) {
+        const schedule_t& entry = table.entries[id];
+        if (entry.days == 0) {
+            continue;
+        }
+        char key[4];
+        char time[6];
+        snprintf(key, sizeof(key), "%d", id);
+        snprintf(time, sizeof(time), "%02u:%02u", entry.hour, entry.minute);
+        json.begin_object(key)
+                .add_string("action", Schedule::describe(static_cast<schedule_action_t>(entry.action)))
+                .add_string("time", time)
+                .add_int("days", entry.days)
+            .end_object();
+    }
+    json.end_object().finalize();
+    return ESP_OK;
+}
+
+static const command_t scheduler_commands[] = {
+    { "auto_off", auto_off_command, COMMAND_GET | COMMAND_POST, { "minutes" } },
+    { "schedule", schedule_command, COMMAND_GET | COMMAND_POST, { "action", "time" } },
+    { "schedules", schedules_command, COMMAND_GET, {} },
+    { "unschedule", unschedule_command, COMMAND_GET | COMMAND_POST, { "id" } },
+};
+
+bool Scheduler::init() {
+
+    if (task != NULL) {
+        return true;
+    }
+
+    Schedule::load(schedules);
+
+    esp_timer_create_args_t args = {};
+    args.callback = alarm_callback;
+    args.name = "scheduler";
+    if (esp_timer_create(&args, &alarm) != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create alarm timer!");
+        return false;
+    }
+    if (xTaskCreate(scheduler_task, "scheduler", SCHEDULER_TASK_STACK_SIZE, NULL, SCHEDULER_TASK_PRIORITY, &task) != pdPASS) {
+        ESP_LOGE(LOG_TAG, "Init: Could not create scheduler task!");
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(wheel_mutex);
+        wheel.advance(current_tick(), [](WheelTimer* timer) {});
+    }
+
+    setenv("TZ", SCHEDULER_TIMEZONE, 1);
+    tzset();
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, SCHEDULER_NTP_SERVER);
+    sntp_set_time_sync_notification_cb(clock_synced);
+    sntp_init();
+
+    IO::subscribe(status_listener, NULL);
+    Commands::add(scheduler_commands, sizeof(scheduler_commands) / sizeof(scheduler_commands[0]));
+    xTaskNotify(task, SCHEDULER_NOTIFY_CLOCK | SCHEDULER_NOTIFY_STATUS, eSetBits);
+    return true;
+
+}
+
+int Scheduler::add(const schedule_t& schedule) {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    for (int id = 0; id < SCHEDULER_MAX; id++) {
+        if (schedules.entries[id].days == 0) {
+            schedules.entries[id] = schedule;
+            if (!save()) {
+                schedules.entries[id] = {};
+                return -1;
+            }
+            arm(id, 0);
+            rearm();
+            return id;
+        }
+    }
+    return -1;
+}
+
+bool Scheduler::remove(int id) {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    if (id < 0 || id >= SCHEDULER_MAX || schedules.entries[id].days == 0) {
+        return false;
+    }
+    schedules.entries[id] = {};
+    wheel.cancel(&timers[id]);
+    rearm();
+    return save();
+}
+
+bool Scheduler::set_auto_off(uint16_t minutes) {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    schedules.auto_off_minutes = minutes;
+    wheel.cancel(&timers[SCHEDULER_AUTO_OFF]);
+    update_auto_off(machine_state);
+    rearm();
+    return save();
+}
+
+// Replaces every schedule and the auto-off delay with one blob write and
+// re-arms all timers, e.g. after a configuration import.
+bool Scheduler::set_table(const scheduler_table_t& table) {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    scheduler_table_t previous = schedules;
+    schedules = table;
+    if (!save()) {
+        schedules = previous;
+        return false;
+    }
+    for (int id = 0; id < SCHEDULER_MAX; id++) {
+        arm(id, 0);
+    }
+    wheel.cancel(&timers[SCHEDULER_AUTO_OFF]);
+    update_auto_off(machine_state);
+    rearm();
+    return true;
+}
+
+scheduler_table_t Scheduler::table() {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    return schedules;
+}
+
+scheduler_jitter_t Scheduler::jitter() {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    return jitters;
+}
@@ -0,0 +1,40 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "schedule.hpp"
+
+#include <cstdint>
+
+#define SCHEDULER_TIMEZONE          "CET-1CEST,M3.5.0,M10.5.0/3"
+#define SCHEDULER_NTP_SERVER        "pool.ntp.org"
+#define SCHEDULER_TASK_STACK_SIZE   4096
+#define SCHEDULER_TASK_PRIORITY     6
+#define SCHEDULER_WHEEL_LEVELS      4
+#define SCHEDULER_WHEEL_BITS        6
+#define SCHEDULER_MAX_AUTO_OFF      240
+
+// Delay between the tick an event was due and the moment its command
+// reached the machine.
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+} scheduler_jitter_t;
+
+// Timed machine control. Schedules and auto-off are timers in a
+// hierarchical wheel with one-second ticks; a single one-shot esp_timer
+// is armed for the next tick with work, so the scheduler task only
+// wakes when something is due. Wall-clock schedules are armed once SNTP
+// has set the clock.
+class Scheduler {
+public:
+    static bool init();
+    static int add(const schedule_t& schedule);
+    static bool remove(int id);
+    static bool set_auto_off(uint16_t minutes);
+    static bool set_table(const scheduler_table_t& table);
+    static scheduler_table_t table();
+    static scheduler_jitter_t jitter();
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "telemetry.hpp"
+#include "io.hpp"
+
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_system.h"
+#include "esp_log.h"
+
+#include <cstdio>
+#include <cstring>
+
+#define LOG_TAG "telemetry.cpp"
+
+static Ring<telemetry_sample_t, TELEMETRY_CAPACITY> ring;
+static esp_timer_handle_t timer = NULL;
+
+static void sample_timer(void* argument) {
+    Telemetry::sample();
+}
+
+bool Telemetry::init() {
+    if (timer != NULL) {
+        return true;
+    }
+    esp_timer_create_args_t args = {};
+    args.callback = sample_timer;
+    args.name = "telemetry";
+    if (esp_timer_create(&args, &timer) != ESP_OK ||
+        esp_timer_start_periodic(timer, TELEMETRY_PERIOD_MS * 1000) != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Init: Could not start sampling timer!");
+        return false;
+    }
+    return true;
+}
+
+bool Telemetry::sample() {
+    io_status_t status = IO::status();
+    wifi_ap_record_t ap_info;
+    telemetry_sample_t sample = {};
+    sample.timestamp_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    sample.free_heap = esp_get_free_heap_size();
+    sample.rssi = (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK ? ap_info.rssi : 0);
+    sample.state = status.state;
+    sample.flags = (status.heater ? TELEMETRY_FLAG_HEATER : 0) | (status.water ? TELEMETRY_FLAG_WATER : 0);
+    return ring.push(sample);
+}
+
+uint32_t Telemetry::overruns() {
+    return ring.overrun_count();
+}
+
+size_t Telemetry::pending() {
+    return ring.size();
+}
+
+// Streams the samples in [since_ms, until_ms] and releases them from the
+// ring, together with any older samples. Binary output is sent straight
+// from ring memory; CSV rows are formatted into one small chunk buffer.
+bool Telemetry::export_window(httpd_req_t* request, telemetry_format_t format, uint32_t since_ms, uint32_t until_ms) {
+
+    size_t available = ring.size();
+    size_t first = 0;
+    while (first < available && ring.at(first).timestamp_ms < since_ms) {
+        first++;
+    }
+    size_t last = first;
+    while (last < available && ring.at(last).timestamp_ms <= until_ms) {
+        last++;
+    }
+
+    bool success = true;
+    if (format == TELEMETRY_BINARY) {
+        telemetry_header_t header = { TELEMETRY_MAGIC, TELEMETRY_VERSION, sizeof(telemetry_sample_t), ring.overrun_count() };
+        success = httpd_resp_send_chunk(request, (const char*)&header, sizeof(header)) == ESP_OK;
+        size_t index = first;
+        while (success && index < last) {
+            size_t count = ring.span(index, last - index);
+            success = httpd_resp_send_chunk(request, (const char*)&ring.at(index),
+                count * sizeof(telemetry_sample_t)) == ESP_OK;
+            index += count;
+        }
+    } else {
+        char chunk[TELEMETRY_CHUNK_SIZE];
+        int length = snprintf(chunk, sizeof(chunk),
+            "# overruns=%u\ntimestamp_ms,state,heater,water,rssi,free_heap\n", (unsigned)ring.overrun_count());
+        size_t position = length;
+        for (size_t index = first; success && index < last; index++) {
+            const telemetry_sample_t& sample = ring.at(index);
+            char row[64];
+            length = snprintf(row, sizeof(row), "%u,%u,%u,%u,%d,%u\n",
+                (unsigned)sample.timestamp_ms, sample.state,
+                (sample.flags & TELEMETRY_FLAG_HEATER) ? 1 : 0,
+                (sample.flags & TELEMETRY_FLAG_WATER) ? 1 : 0,
+                sample.rssi, (unsigned)sample.free_heap);
+            if (position + length > sizeof(chunk)) {
+                success = httpd_resp_send_chunk(request, chunk, position) == ESP_OK;
+                position = 0;
+            }
+            memcpy(chunk + position, row, length);
+            position += length;
+        }
+        if (success && position > 0) {
+            success = httpd_resp_send_chunk(request, chunk, position) == ESP_OK;
+        }
+    }
+
+    if (success) {
+        ring.pop(last);
+        success = httpd_resp_send_chunk(request, NULL, 0) == ESP_OK;
+    }
+    return success;
+
+}
@@ -0,0 +1,53 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "ring.hpp"
+
+#include "esp_http_server.h"
+
+#include <cstdint>
+
+#define TELEMETRY_PERIOD_MS     1000
+#define TELEMETRY_CAPACITY      1024
+#define TELEMETRY_CHUNK_SIZE    512
+#define TELEMETRY_MAGIC         0x4d4c4554
+#define TELEMETRY_VERSION       1
+
+#define TELEMETRY_FLAG_HEATER   (1 << 0)
+#define TELEMETRY_FLAG_WATER    (1 << 1)
+
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp_ms;
+    uint32_t free_heap;
+    int8_t rssi;
+    uint8_t state;
+    uint8_t flags;
+    uint8_t reserved;
+} telemetry_sample_t;
+
+// Header preceding the samples in the binary export format.
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sample_size;
+    uint32_t overruns;
+} telemetry_header_t;
+
+typedef enum {
+    TELEMETRY_CSV,
+    TELEMETRY_BINARY,
+} telemetry_format_t;
+
+// Fixed-rate machine telemetry. An esp_timer callback is the only
+// producer of the sample ring and the export handler its only consumer,
+// so neither side takes a lock.
+class Telemetry {
+public:
+    static bool init();
+    static bool sample();
+    static uint32_t overruns();
+    static size_t pending();
+    static bool export_window(httpd_req_t* request, telemetry_format_t format, uint32_t since_ms, uint32_t until_ms);
+};
+
+#endif
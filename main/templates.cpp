@@ -0,0 +1,116 @@
+#include "templates.hpp"
+
+#include "esp_log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#define LOG_TAG "templates.cpp"
+
+TemplateWriter::TemplateWriter(httpd_req_t* request) {
+    this->request = request;
+    this->position = 0;
+    this->failed = false;
+}
+
+bool TemplateWriter::flush() {
+    if (this->position == 0 || this->failed) {
+        return !this->failed;
+    }
+    if (httpd_resp_send_chunk(this->request, this->chunk, this->position) != ESP_OK) {
+        this->failed = true;
+    }
+    this->position = 0;
+    return !this->failed;
+}
+
+void TemplateWriter::put(const char* data, size_t length) {
+    while (length > 0 && !this->failed) {
+        if (this->position == sizeof(this->chunk) && !this->flush()) {
+            return;
+        }
+        size_t size = std::min(length, sizeof(this->chunk) - this->position);
+        memcpy(this->chunk + this->position, data, size);
+        this->position += size;
+        data += size;
+        length -= size;
+    }
+}
+
+void TemplateWriter::add_literal(const char* text, size_t length) {
+    if (length <= sizeof(this->chunk) - this->position) {
+        this->put(text, length);
+        return;
+    }
+    if (this->flush() && httpd_resp_send_chunk(this->request, text, length) != ESP_OK) {
+        this->failed = true;
+    }
+}
+
+// Slot values are HTML-escaped, so they are safe in text and in quoted
+// attribute values.
+void TemplateWriter::add_text(std::string_view value) {
+    size_t start = 0;
+    for (size_t i = 0; i < value.length(); i++) {
+        const char* entity;
+        switch (value[i]) {
+            case '&':  entity = "&amp;"; break;
+            case '<':  entity = "&lt;"; break;
+            case '>':  entity = "&gt;"; break;
+            case '"':  entity = "&quot;"; break;
+            case '\'': entity = "&#39;"; break;
+            default:   continue;
+        }
+        this->put(value.data() + start, i - start);
+        this->put(entity, strlen(entity));
+        start = i + 1;
+    }
+    this->put(value.data() + start, value.length() - start);
+}
+
+void TemplateWriter::add_int(int value) {
+    char text[12];
+    int length = snprintf(text, sizeof(text), "%d", value);
+    this->put(text, length);
+}
+
+bool TemplateWriter::finish() {
+    return this->flush() && httpd_resp_send_chunk(this->request, NULL, 0) == ESP_OK;
+}
+
+const template_t* Templates::find(std::string_view path) {
+    size_t low = 0;
+    size_t high = template_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        int order = path.compare(templates[middle].path);
+        if (order == 0) {
+            return &templates[middle];
+        }
+        if (order < 0) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t Templates::render(httpd_req_t* request, const template_t* page, template_fill_t fill, void* context) {
+    httpd_resp_set_type(request, "text/html");
+    httpd_resp_set_hdr(request, "Cache-Control", "no-store");
+    TemplateWriter writer(request);
+    for (size_t i = 0; i < page->count; i++) {
+        const template_segment_t& segment = page->segments[i];
+        writer.add_literal(segment.text, segment.length);
+        if (segment.slot != TEMPLATE_NO_SLOT) {
+            fill(segment.slot, writer, context);
+        }
+    }
+    if (!writer.finish()) {
+        ESP_LOGW(LOG_TAG, "Render: Sending '%s' aborted.", page->path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
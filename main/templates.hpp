@@ -0,0 +1,65 @@
+#ifndef TEMPLATES_H
+#define TEMPLATES_H
+
+#include "esp_http_server.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#define TEMPLATES_CHUNK_SIZE    256
+
+// Placeholder slots available to templates. {{ name }} in a template
+// compiles to TEMPLATE_SLOT_<NAME>.
+typedef enum {
+    TEMPLATE_NO_SLOT = -1,
+    TEMPLATE_SLOT_SSID,
+    TEMPLATE_SLOT_PROFILES,
+    TEMPLATE_SLOT_STATE,
+    TEMPLATE_SLOT_COUNT,
+} template_slot_t;
+
+// Literal text in flash followed by an optional slot.
+typedef struct {
+    const char* text;
+    uint16_t length;
+    template_slot_t slot;
+} template_segment_t;
+
+// HTML template compiled into flash by tools/compile_templates.py.
+typedef struct {
+    const char* path;
+    const template_segment_t* segments;
+    size_t count;
+} template_t;
+
+extern const template_t templates[];
+extern const size_t template_count;
+
+// Chunked output of a template render. Short literals and slot values
+// are coalesced into one fixed buffer; literals that do not fit are sent
+// straight from flash, so memory use does not depend on the page size.
+class TemplateWriter {
+    httpd_req_t* request;
+    char chunk[TEMPLATES_CHUNK_SIZE];
+    size_t position;
+    bool failed;
+    bool flush();
+    void put(const char* data, size_t length);
+public:
+    TemplateWriter(httpd_req_t* request);
+    void add_literal(const char* text, size_t length);
+    void add_text(std::string_view value);
+    void add_int(int value);
+    bool finish();
+};
+
+typedef void (*template_fill_t)(template_slot_t slot, TemplateWriter& writer, void* context);
+
+class Templates {
+public:
+    static const template_t* find(std::string_view path);
+    static esp_err_t render(httpd_req_t* request, const template_t* page, template_fill_t fill, void* context);
+};
+
+#endif
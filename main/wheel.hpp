@@ -0,0 +1,185 @@
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Timer embedded in its owner. expires is an absolute tick.
+struct WheelTimer {
+    WheelTimer* next = nullptr;
+    WheelTimer* prev = nullptr;
+    uint32_t expires = 0;
+    void* context = nullptr;
+
+    bool pending() const {
+        return this->next != nullptr;
+    }
+};
+
+// Hierarchical timer wheel. Level l has 2^BITS slots of 2^(BITS*l) ticks
+// each; timers live in intrusive lists, so scheduling and cancelling are
+// O(1), and a timer is cascaded at most LEVELS - 1 times before it
+// fires. A bitmap of occupied slots per level lets next_event() find the
+// next tick with work in O(LEVELS), so the driver can sleep until then
+// instead of ticking.
+template <size_t LEVELS, size_t BITS>
+class TimerWheel {
+    static_assert(BITS <= 6, "Slot bitmaps are 64 bits wide");
+    static_assert(LEVELS * BITS < 32, "Wheel range must fit in 32-bit ticks");
+
+    static constexpr uint32_t SLOTS = 1u << BITS;
+    static constexpr uint32_t MASK = SLOTS - 1;
+
+    WheelTimer slots[LEVELS][SLOTS];
+    uint64_t occupied[LEVELS] = {};
+    uint32_t current = 0;
+    size_t count = 0;
+
+    static uint32_t span(size_t level) {
+        return 1u << (BITS * level);
+    }
+
+    void insert(WheelTimer* timer) {
+        uint32_t delta = timer->expires - this->current;
+        size_t level = 0;
+        while (level < LEVELS - 1 && delta >= span(level + 1)) {
+            level++;
+        }
+        uint32_t slot = (timer->expires >> (BITS * level)) & MASK;
+        WheelTimer* head = &this->slots[level][slot];
+        timer->next = head;
+        timer->prev = head->prev;
+        head->prev->next = timer;
+        head->prev = timer;
+        this->occupied[level] |= (1ull << slot);
+    }
+
+    void unlink(WheelTimer* timer) {
+        timer->prev->next = timer->next;
+        timer->next->prev = timer->prev;
+        if (timer->next == timer->prev && timer->next >= &this->slots[0][0] &&
+            timer->next < &this->slots[0][0] + LEVELS * SLOTS) {
+            size_t index = timer->next - &this->slots[0][0];
+            this->occupied[index / SLOTS] &= ~(1ull << (index % SLOTS));
+        }
+        timer->next = nullptr;
+        timer->prev = nullptr;
+    }
+
+    // Re-files every timer of a higher-level slot relative to current.
+    void cascade(size_t level, uint32_t slot) {
+        WheelTimer* head = &this->slots[level][slot];
+        WheelTimer* timer = head->next;
+        head->next = head;
+        head->prev = head;
+        this->occupied[level] &= ~(1ull << slot);
+        while (timer != head) {
+            WheelTimer* next = timer->next;
+            this->insert(timer);
+            timer = next;
+        }
+    }
+
+public:
+    TimerWheel() {
+        for (size_t level = 0; level < LEVELS; level++) {
+            for (uint32_t slot = 0; slot < SLOTS; slot++) {
+                this->slots[level][slot].next = &this->slots[level][slot];
+                this->slots[level][slot].prev = &this->slots[level][slot];
+            }
+        }
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    static constexpr uint32_t range() {
+        return (1u << (BITS * LEVELS)) - 1;
+    }
+
+    uint32_t now() const {
+        return this->current;
+    }
+
+    size_t size() const {
+        return this->count;
+    }
+
+    // Expiries in the past fire on the next tick, expiries beyond the
+    // wheel's range are clamped to it.
+    void schedule(WheelTimer* timer, uint32_t expires) {
+        if (timer->pending()) {
+            this->cancel(timer);
+        }
+        if ((int32_t)(expires - this->current) <= 0) {
+            expires = this->current + 1;
+        } else if (expires - this->current > range()) {
+            expires = this->current + range();
+        }
+        timer->expires = expires;
+        this->insert(timer);
+        this->count++;
+    }
+
+    void cancel(WheelTimer* timer) {
+        if (timer->pending()) {
+            this->unlink(timer);
+            this->count--;
+        }
+    }
+
+    // Next tick at which a timer fires or a slot cascades, or UINT32_MAX
+    // when the wheel is empty.
+    uint32_t next_event() const {
+        uint32_t best = UINT32_MAX;
+        for (size_t level = 0; level < LEVELS; level++) {
+            uint64_t mask = this->occupied[level];
+            if (mask == 0) {
+                continue;
+            }
+            uint32_t base = this->current >> (BITS * level);
+            uint32_t index = base & MASK;
+            // Rotate so bit 0 is the slot after the current one.
+            uint32_t shift = (index + 1) & MASK;
+            uint64_t rotated = (shift == 0 ? mask : (mask >> shift) | (mask << (SLOTS - shift)));
+            if (SLOTS < 64) {
+                rotated &= (1ull << SLOTS) - 1;
+            }
+            uint32_t distance = __builtin_ctzll(rotated) + 1;
+            uint32_t tick = (base + distance) << (BITS * level);
+            if (tick < best) {
+                best = tick;
+            }
+        }
+        return best;
+    }
+
+    // Moves the wheel to target, jumping straight between ticks that have
+    // work, and calls fire(timer) for every timer that expires on the
+    // way. fire() may schedule timers again.
+    template <typename F>
+    void advance(uint32_t target, F fire) {
+        while ((int32_t)(target - this->current) > 0) {
+            uint32_t tick = this->next_event();
+            if (tick == UINT32_MAX || (int32_t)(tick - target) > 0) {
+                this->current = target;
+                return;
+            }
+            this->current = tick;
+            for (size_t level = LEVELS - 1; level > 0; level--) {
+                if ((tick & (span(level) - 1)) == 0) {
+                    this->cascade(level, (tick >> (BITS * level)) & MASK);
+                }
+            }
+            WheelTimer* head = &this->slots[0][tick & MASK];
+            while (head->next != head) {
+                WheelTimer* timer = head->next;
+                this->unlink(timer);
+                this->count--;
+                fire(timer);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Compiles HTML templates into constexpr segment tables.
+
+Every file below the input directory becomes an array of segments: a run
+of literal text followed by an optional placeholder slot. Placeholders are
+written as {{ name }} and refer to TEMPLATE_SLOT_<NAME> in templates.hpp,
+so a misspelled placeholder fails the firmware build. The table is sorted
+by URL path so the firmware can look templates up with a binary search.
+
+Usage: compile_templates.py <input directory> <output .cpp>
+"""
+
+import os
+import re
+import sys
+
+PLACEHOLDER = re.compile(r"\{\{\s*([a-z][a-z0-9_]*)\s*\}\}")
+LINE_LENGTH = 96
+
+
+def collect(root):
+    templates = []
+    for directory, _, files in os.walk(root):
+        for name in files:
+            path = os.path.join(directory, name)
+            url = "/" + os.path.relpath(path, root).replace(os.sep, "/")
+            templates.append((url, path))
+    return sorted(templates)
+
+
+def split(path, content):
+    segments = []
+    position = 0
+    for match in PLACEHOLDER.finditer(content):
+        segments.append((content[position:match.start()], "TEMPLATE_SLOT_" + match.group(1).upper()))
+        position = match.end()
+    segments.append((content[position:], "TEMPLATE_NO_SLOT"))
+    for text, _ in segments:
+        if "{{" in text or "}}" in text:
+            sys.exit("%s: malformed placeholder" % path)
+    return segments
+
+
+def literal(text):
+    escaped = []
+    for byte in text.encode("utf-8"):
+        character = chr(byte)
+        if character == "\\":
+            escaped.append("\\\\")
+        elif character == '"':
+            escaped.append('\\"')
+        elif character == "\n":
+            escaped.append("\\n")
+        elif 0x20 <= byte < 0x7F:
+            escaped.append(character)
+        else:
+            # Octal escapes cannot swallow a following hex digit.
+            escaped.append("\\%03o" % byte)
+    lines = []
+    current = ""
+    for piece in escaped:
+        current += piece
+        if piece == "\\n" or len(current) >= LINE_LENGTH:
+            lines.append(current)
+            current = ""
+    if current or not lines:
+        lines.append(current)
+    return "\n        ".join('"%s"' % line for line in lines)
+
+
+def render(templates):
+    lines = [
+        "// Generated by tools/compile_templates.py. Do not edit.",
+        '#include "templates.hpp"',
+        "",
+    ]
+    entries = []
+    for index, (url, path) in enumerate(templates):
+        with open(path, encoding="utf-8") as source:
+            segments = split(path, source.read())
+        lines.append("static constexpr template_segment_t template_%d[] = {" % index)
+        for text, slot in segments:
+            size = len(text.encode("utf-8"))
+            if size > 0xFFFF:
+                sys.exit("%s: segment too long" % path)
+            lines.append("    { %s,\n        %d, %s }," % (literal(text), size, slot))
+        lines.append("};")
+        lines.append("")
+        entries.append('    { "%s", template_%d, sizeof(template_%d) / sizeof(template_%d[0]) },'
+                       % (url, index, index, index))
+    lines.append("constexpr template_t templates[] = {")
+    lines.extend(entries)
+    lines.append("};")
+    lines.append("")
+    lines.append("const size_t template_count = %d;" % len(templates))
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    output = render(collect(sys.argv[1]))
+    if os.path.exists(sys.argv[2]):
+        with open(sys.argv[2]) as existing:
+            if existing.read() == output:
+                return
+    with open(sys.argv[2], "w") as target:
+        target.write(output)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Compresses a directory of web assets into a C++ source file.
+
+Every file below the input directory becomes a gzip-compressed byte array
+with its URL path, content type and a strong ETag derived from the SHA-256
+of the uncompressed content. The table is sorted by path so the firmware
+can look assets up with a binary search.
+
+Usage: embed_assets.py <input directory> <output .cpp>
+"""
+
+import gzip
+import hashlib
+import os
+import sys
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+    ".txt": "text/plain",
+}
+
+
+def collect(root):
+    assets = []
+    for directory, _, files in os.walk(root):
+        for name in files:
+            path = os.path.join(directory, name)
+            url = "/" + os.path.relpath(path, root).replace(os.sep, "/")
+            assets.append((url, path))
+    return sorted(assets)
+
+
+def render(assets):
+    lines = [
+        "// Generated by tools/embed_assets.py. Do not edit.",
+        '#include "assets.hpp"',
+        "",
+    ]
+    entries = []
+    for index, (url, path) in enumerate(assets):
+        with open(path, "rb") as source:
+            content = source.read()
+        compressed = gzip.compress(content, compresslevel=9, mtime=0)
+        etag = hashlib.sha256(content).hexdigest()[:16]
+        extension = os.path.splitext(path)[1].lower()
+        content_type = CONTENT_TYPES.get(extension, "application/octet-stream")
+        lines.append("static const uint8_t asset_%d[] = {" % index)
+        for offset in range(0, len(compressed), 16):
+            row = compressed[offset:offset + 16]
+            lines.append("    " + ", ".join("0x%02x" % byte for byte in row) + ",")
+        lines.append("};")
+        lines.append("")
+        entries.append('    { "%s", "%s", asset_%d, sizeof(asset_%d), "\\"%s\\"" },'
+                       % (url, content_type, index, index, etag))
+    lines.append("const asset_t assets[] = {")
+    lines.extend(entries)
+    lines.append("};")
+    lines.append("")
+    lines.append("const size_t asset_count = %d;" % len(assets))
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    output = render(collect(sys.argv[1]))
+    if os.path.exists(sys.argv[2]):
+        with open(sys.argv[2]) as existing:
+            if existing.read() == output:
+                return
+    with open(sys.argv[2], "w") as target:
+        target.write(output)
+
+
+if __name__ == "__main__":
+    main()